@@ -13,7 +13,9 @@
 #include "wifi_station.h"
 #include "sd_card.h"
 #include "esp32_sd_music.h"
+#include "song_cache.h"
 
+#include <algorithm>
 #include <cstring>
 #include <esp_log.h>
 #include <cJSON.h>
@@ -88,7 +90,6 @@ void Application::CheckAssetsVersion() {
     std::string download_url = settings.GetString("download_url");
 
     if (!download_url.empty()) {
-        settings.EraseKey("download_url");
 
         char message[256];
         snprintf(message, sizeof(message), Lang::Strings::FOUND_NEW_ASSETS, download_url.c_str());
@@ -100,7 +101,7 @@ void Application::CheckAssetsVersion() {
         board.SetPowerSaveMode(false);
         display->SetChatMessage("system", Lang::Strings::PLEASE_WAIT);
 
-        bool success = assets.Download(download_url, [display](int progress, size_t speed) -> void {
+        auto result = assets.Download(download_url, [display](int progress, size_t speed) -> void {
             std::thread([display, progress, speed]() {
                 char buffer[32];
                 snprintf(buffer, sizeof(buffer), "%d%% %uKB/s", progress, speed / 1024);
@@ -111,11 +112,17 @@ void Application::CheckAssetsVersion() {
         board.SetPowerSaveMode(true);
         vTaskDelay(pdMS_TO_TICKS(1000));
 
-        if (!success) {
+        if (result != kResumableDownloadOk) {
+            if (result == kResumableDownloadFailed) {
+                // A bad URL or image fails the same way on every boot
+                settings.EraseKey("download_url");
+            }
+            // 网络错误时保留 download_url，下次启动时从断点继续下载
             Alert(Lang::Strings::ERROR, Lang::Strings::DOWNLOAD_ASSETS_FAILED, "circle_xmark", Lang::Sounds::OGG_EXCLAMATION);
             vTaskDelay(pdMS_TO_TICKS(2000));
             return;
         }
+        settings.EraseKey("download_url");
     }
 
     // Apply assets
@@ -370,6 +377,12 @@ void Application::Start() {
     // codec->SetOutputVolume(10);
     display->SetChatMessage("system", "Audio ready...");
 
+    // Uplink audio has its own task, so a long running scheduled task cannot stall it
+    xTaskCreate([](void* arg) {
+        ((Application*)arg)->AudioSendTask();
+        vTaskDelete(NULL);
+    }, "audio_send", 1024 * 4, this, 4, &audio_send_task_handle_);
+
     AudioServiceCallbacks callbacks;
     callbacks.on_send_queue_available = [this]() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
@@ -413,6 +426,7 @@ void Application::Start() {
             sd_music_ = new Esp32SdMusic();
             sd_music_->Initialize(sd_card);
             sd_music_->loadTrackList();
+            SongCache::GetInstance().Initialize(sd_card->GetMountPoint());
         } else {
             ESP_LOGW(TAG, "Failed to mount SD card");
         }
@@ -482,26 +496,30 @@ void Application::Start() {
         }
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
+        uplink_started_ = false;
         board.SetPowerSaveMode(true);
         Schedule([this]() {
             auto display = Board::GetInstance().GetDisplay();
             display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
-        });
+            audio_service_.uplink_controller().EndSession();
+            // Follow-up questions usually come soon after, get the next session ready
+            if (protocol_) {
+                protocol_->PrewarmAudioChannel();
+            }
+        }, kSchedulePriorityHigh);
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
+    // Frequent messages are handled from their top level fields without building a cJSON tree
+    protocol_->OnIncomingMessage([this, display](const JsonScanner& message) {
+        if (message.StringEquals("type", "tts")) {
+            if (message.StringEquals("state", "start")) {
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
                         SetDeviceState(kDeviceStateSpeaking);
                     }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
+                }, kSchedulePriorityHigh);
+            } else if (message.StringEquals("state", "stop")) {
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
@@ -510,58 +528,68 @@ void Application::Start() {
                             SetDeviceState(kDeviceStateListening);
                         }
                     }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
+                }, kSchedulePriorityHigh);
+            } else if (message.StringEquals("state", "sentence_start")) {
+                std::string text;
+                if (message.GetString("text", text)) {
+                    ESP_LOGI(TAG, "<< %s", text.c_str());
+                    Schedule([this, display, message = std::move(text)]() {
                         display->SetChatMessage("assistant", message.c_str());
-                    });
+                    }, kSchedulePriorityLow, "assistant_message");
                 }
             }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
+        } else if (message.StringEquals("type", "stt")) {
+            std::string text;
+            if (message.GetString("text", text)) {
+                ESP_LOGI(TAG, ">> %s", text.c_str());
+                Schedule([this, display, message = std::move(text)]() {
                     display->SetChatMessage("user", message.c_str());
-                });
+                }, kSchedulePriorityLow, "user_message");
             }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
+        } else if (message.StringEquals("type", "llm")) {
+            std::string emotion;
+            if (message.GetString("emotion", emotion)) {
+                Schedule([this, display, emotion_str = std::move(emotion)]() {
                     display->SetEmotion(emotion_str.c_str());
-                });
+                }, kSchedulePriorityLow, "emotion");
             }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
-                McpServer::GetInstance().ParseMessage(payload);
-            }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
+        } else if (message.StringEquals("type", "system")) {
+            std::string command;
+            if (message.GetString("command", command)) {
+                ESP_LOGI(TAG, "System command: %s", command.c_str());
+                if (command == "reboot") {
                     // Do a reboot if user requests a OTA update
                     Schedule([this]() {
                         Reboot();
                     });
                 } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
+                    ESP_LOGW(TAG, "Unknown system command: %s", command.c_str());
                 }
             }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
+        } else if (message.StringEquals("type", "alert")) {
+            std::string status, text, emotion;
+            if (message.GetString("status", status) && message.GetString("message", text) && message.GetString("emotion", emotion)) {
+                Alert(status.c_str(), text.c_str(), emotion.c_str(), Lang::Sounds::OGG_VIBRATION);
             } else {
                 ESP_LOGW(TAG, "Alert command requires status, message and emotion");
             }
+        } else {
+            return false;
+        }
+        return true;
+    });
+    protocol_->OnIncomingJson([this, display](const cJSON* root) {
+        // Parse JSON data
+        auto type = cJSON_GetObjectItem(root, "type");
+        if (!cJSON_IsString(type)) {
+            ESP_LOGW(TAG, "Message type is invalid");
+            return;
+        }
+        if (strcmp(type->valuestring, "mcp") == 0) {
+            auto payload = cJSON_GetObjectItem(root, "payload");
+            if (cJSON_IsObject(payload)) {
+                McpServer::GetInstance().ParseMessage(payload);
+            }
 #if CONFIG_RECEIVE_CUSTOM_MESSAGE
         } else if (strcmp(type->valuestring, "custom") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
@@ -594,21 +622,124 @@ void Application::Start() {
 }
 
 // Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
+void Application::Schedule(std::function<void()> callback, SchedulePriority priority, const char* coalesce_key) {
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
+        auto& tasks = main_tasks_[priority];
+        if (coalesce_key != nullptr) {
+            for (auto& task : tasks) {
+                if (task.coalesce_key != nullptr && strcmp(task.coalesce_key, coalesce_key) == 0) {
+                    // Keep the queue position and time of the pending task, run the latest callback
+                    task.callback = std::move(callback);
+                    coalesced_tasks_++;
+                    return;
+                }
+            }
+        }
+        tasks.push_back(ScheduledTask{std::move(callback), coalesce_key, esp_timer_get_time()});
     }
     xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
 }
 
+// Drops pending tasks that a state change made stale, so they cannot overwrite what it shows
+void Application::DropScheduledTasks(SchedulePriority priority, std::initializer_list<const char*> coalesce_keys) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& tasks = main_tasks_[priority];
+    for (auto it = tasks.begin(); it != tasks.end();) {
+        bool stale = it->coalesce_key != nullptr && std::any_of(coalesce_keys.begin(), coalesce_keys.end(),
+            [&](const char* key) { return strcmp(it->coalesce_key, key) == 0; });
+        it = stale ? tasks.erase(it) : it + 1;
+    }
+}
+
+// Runs the tasks pending on entry, higher priorities first, so tasks scheduled
+// while running cannot starve the rest of the main loop
+void Application::RunScheduledTasks() {
+    size_t pending = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& tasks : main_tasks_) {
+            pending += tasks.size();
+        }
+    }
+
+    while (pending-- > 0) {
+        ScheduledTask task;
+        int priority = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (priority < kSchedulePriorityCount && main_tasks_[priority].empty()) {
+                priority++;
+            }
+            if (priority == kSchedulePriorityCount) {
+                return;
+            }
+            task = std::move(main_tasks_[priority].front());
+            main_tasks_[priority].pop_front();
+        }
+        schedule_latency_[priority].Record(esp_timer_get_time() - task.queued_us);
+        task.callback();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& tasks : main_tasks_) {
+        if (!tasks.empty()) {
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+            break;
+        }
+    }
+}
+
+cJSON* Application::GetScheduleStats(bool reset) {
+    static const char* const names[kSchedulePriorityCount] = { "high", "normal", "low" };
+    cJSON* json = cJSON_CreateObject();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < kSchedulePriorityCount; i++) {
+        cJSON* latency = schedule_latency_[i].ToJson();
+        cJSON_AddNumberToObject(latency, "pending", main_tasks_[i].size());
+        cJSON_AddItemToObject(json, names[i], latency);
+        if (reset) {
+            schedule_latency_[i].Reset();
+        }
+    }
+    cJSON_AddNumberToObject(json, "coalesced", coalesced_tasks_);
+    if (reset) {
+        coalesced_tasks_ = 0;
+    }
+    return json;
+}
+
+// Drains the send queue into the protocol. Packets that cannot be sent stay queued,
+// and a full send queue holds the encoder back (see AudioService::OpusCodecTask).
+void Application::AudioSendTask() {
+    while (true) {
+        xEventGroupWaitBits(event_group_, MAIN_EVENT_SEND_AUDIO, pdTRUE, pdFALSE, portMAX_DELAY);
+        // Nothing goes out before the wake word and listen start, captured speech waits queued
+        while (uplink_started_ && protocol_) {
+            auto packet = audio_service_.PopPacketFromSendQueue();
+            if (!packet) {
+                break;
+            }
+            auto start_time = esp_timer_get_time();
+            bool sent = protocol_->SendAudio(*packet);
+            // A send racing with the channel close is not a network problem
+            if (sent || uplink_started_) {
+                audio_service_.uplink_controller().OnPacketSent(sent, esp_timer_get_time() - start_time);
+            }
+            if (!sent) {
+                audio_service_.PushPacketToSendQueueFront(std::move(packet));
+                break;
+            }
+        }
+    }
+}
+
 // The Main Event Loop controls the chat state and websocket connection
 // If other tasks need to access the websocket or chat state,
 // they should use Schedule to call this function
 void Application::MainEventLoop() {
     while (true) {
         auto bits = xEventGroupWaitBits(event_group_, MAIN_EVENT_SCHEDULE |
-            MAIN_EVENT_SEND_AUDIO |
             MAIN_EVENT_WAKE_WORD_DETECTED |
             MAIN_EVENT_VAD_CHANGE |
             MAIN_EVENT_CLOCK_TICK |
@@ -619,14 +750,6 @@ void Application::MainEventLoop() {
             Alert(Lang::Strings::ERROR, last_error_message_.c_str(), "circle_xmark", Lang::Sounds::OGG_EXCLAMATION);
         }
 
-        if (bits & MAIN_EVENT_SEND_AUDIO) {
-            while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
-                    break;
-                }
-            }
-        }
-
         if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
             OnWakeWordDetected();
         }
@@ -639,12 +762,7 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SCHEDULE) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
-                task();
-            }
+            RunScheduledTasks();
         }
 
         if (bits & MAIN_EVENT_CLOCK_TICK) {
@@ -696,9 +814,7 @@ void Application::OnWakeWordDetected() {
         audio_service_.EncodeWakeWord();
 
         if (!protocol_->IsAudioChannelOpened()) {
-            SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
-                audio_service_.EnableWakeWordDetection(true);
+            if (!OpenAudioChannelCapturing()) {
                 return;
             }
         }
@@ -708,7 +824,7 @@ void Application::OnWakeWordDetected() {
 #if CONFIG_SEND_WAKE_WORD_DATA
         // Encode and send the wake word data to the server
         while (auto packet = audio_service_.PopWakeWordPacket()) {
-            protocol_->SendAudio(std::move(packet));
+            protocol_->SendAudio(*packet);
         }
         // Set the chat state to wake word detected
         protocol_->SendWakeWordDetected(wake_word);
@@ -725,6 +841,21 @@ void Application::OnWakeWordDetected() {
     }
 }
 
+// Start capturing before connecting, so whatever the user says right after the wake word
+// waits in the send queue instead of being lost while the channel opens
+bool Application::OpenAudioChannelCapturing() {
+    SetDeviceState(kDeviceStateConnecting);
+    audio_service_.EnableWakeWordDetection(false);
+    audio_service_.EnableVoiceProcessing(true);
+    if (!protocol_->OpenAudioChannel()) {
+        audio_service_.EnableVoiceProcessing(false);
+        audio_service_.ClearSendQueue();
+        audio_service_.EnableWakeWordDetection(true);
+        return false;
+    }
+    return true;
+}
+
 void Application::AbortSpeaking(AbortReason reason) {
     ESP_LOGI(TAG, "Abort speaking");
     aborted_ = true;
@@ -788,6 +919,8 @@ void Application::SetDeviceState(DeviceState state) {
     switch (state) {
         case kDeviceStateUnknown:
         case kDeviceStateIdle:
+            uplink_started_ = false;
+            DropScheduledTasks(kSchedulePriorityLow, {"assistant_message", "user_message", "emotion"});
             display->SetStatus(Lang::Strings::STANDBY);
             display->SetEmotion("neutral");
             // Clear chat message when returning to idle (conversation ended)
@@ -802,11 +935,14 @@ void Application::SetDeviceState(DeviceState state) {
             }
             break;
         case kDeviceStateConnecting:
+            uplink_started_ = false;
+            DropScheduledTasks(kSchedulePriorityLow, {"assistant_message", "user_message", "emotion"});
             display->SetStatus(Lang::Strings::CONNECTING);
             display->SetEmotion("neutral");
             display->SetChatMessage("system", "");
             break;
         case kDeviceStateListening:
+            DropScheduledTasks(kSchedulePriorityLow, {"emotion"});
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
 
@@ -816,7 +952,14 @@ void Application::SetDeviceState(DeviceState state) {
                 protocol_->SendStartListening(listening_mode_);
                 audio_service_.EnableVoiceProcessing(true);
                 audio_service_.EnableWakeWordDetection(false);
+            } else if (previous_state == kDeviceStateConnecting) {
+                // Audio captured while connecting is already queued, send it after the listen start
+                protocol_->SendStartListening(listening_mode_);
             }
+            // Let the send task drain the queue now that the server expects audio
+            audio_service_.uplink_controller().OnUplinkStarted();
+            uplink_started_ = true;
+            xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
             break;
         case kDeviceStateSpeaking:
             display->SetStatus(Lang::Strings::SPEAKING);
@@ -909,9 +1052,7 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
         audio_service_.EncodeWakeWord();
 
         if (!protocol_->IsAudioChannelOpened()) {
-            SetDeviceState(kDeviceStateConnecting);
-            if (!protocol_->OpenAudioChannel()) {
-                audio_service_.EnableWakeWordDetection(true);
+            if (!OpenAudioChannelCapturing()) {
                 return;
             }
         }
@@ -920,7 +1061,7 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
 #if CONFIG_USE_AFE_WAKE_WORD || CONFIG_USE_CUSTOM_WAKE_WORD
         // Encode and send the wake word data to the server
         while (auto packet = audio_service_.PopWakeWordPacket()) {
-            protocol_->SendAudio(std::move(packet));
+            protocol_->SendAudio(*packet);
         }
         // Set the chat state to wake word detected
         protocol_->SendWakeWordDetected(wake_word);
@@ -1004,7 +1145,7 @@ void Application::SetAecMode(AecMode mode) {
 
 
 // New: Receive external audio data (such as music playback)
-void Application::AddAudioData(AudioStreamPacket&& packet) {
+bool Application::AddAudioData(AudioStreamPacket&& packet) {
     auto codec = Board::GetInstance().GetAudioCodec();
     if (device_state_ == kDeviceStateIdle && codec->output_enabled()) {
         // packet.payload contains raw PCM data (int16_t)
@@ -1022,7 +1163,7 @@ void Application::AddAudioData(AudioStreamPacket&& packet) {
                 if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
                     ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
                             packet.sample_rate, codec->output_sample_rate());
-                    return;
+                    return false;
                 }
                 
                 std::vector<int16_t> resampled;
@@ -1081,8 +1222,10 @@ void Application::AddAudioData(AudioStreamPacket&& packet) {
             codec->OutputData(pcm_data);
             
             audio_service_.UpdateOutputTimestamp();
+            return true;
         }
     }
+    return false;
 }
 
 void Application::PlaySound(const std::string_view& sound) {
@@ -10,6 +10,8 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
+#include <initializer_list>
 
 #include "protocol.h"
 #include "ota.h"
@@ -18,6 +20,7 @@
 #include "esp32_sd_music.h"
 #include "esp32_music.h"
 #include "esp32_radio.h"
+#include "lvgl_perf.h"
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
 #define MAIN_EVENT_SEND_AUDIO (1 << 1)
@@ -28,6 +31,19 @@
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
 
 
+enum SchedulePriority {
+    kSchedulePriorityHigh = 0,  // Device state and audio channel changes
+    kSchedulePriorityNormal,
+    kSchedulePriorityLow,       // Display updates, run after everything else is done
+    kSchedulePriorityCount,
+};
+
+struct ScheduledTask {
+    std::function<void()> callback;
+    const char* coalesce_key;
+    int64_t queued_us;
+};
+
 enum AecMode {
     kAecOff,
     kAecOnDeviceSide,
@@ -46,9 +62,14 @@ public:
 
     void Start();
     void MainEventLoop();
+    void AudioSendTask();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    // A pending task with the same coalesce key is replaced, only the latest one runs
+    void Schedule(std::function<void()> callback, SchedulePriority priority = kSchedulePriorityNormal,
+        const char* coalesce_key = nullptr);
+    // Queue latency histograms of each priority, in microseconds
+    cJSON* GetScheduleStats(bool reset = false);
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -64,7 +85,8 @@ public:
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     // 新增：接收外部音频数据（如音乐播放）
-    void AddAudioData(AudioStreamPacket&& packet);
+    // Returns false when the PCM was dropped (device not idle)
+    bool AddAudioData(AudioStreamPacket&& packet);
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
 	Esp32Music* GetMusic() { return music_; }
@@ -76,7 +98,9 @@ private:
     ~Application();
 
     std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    std::deque<ScheduledTask> main_tasks_[kSchedulePriorityCount];
+    PerfHistogram schedule_latency_[kSchedulePriorityCount];
+    uint32_t coalesced_tasks_ = 0;
     std::unique_ptr<Protocol> protocol_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
@@ -94,7 +118,13 @@ private:
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
+    TaskHandle_t audio_send_task_handle_ = nullptr;
+    // Set once listen start was sent in this session, cleared when the channel closes
+    std::atomic<bool> uplink_started_ = false;
 
+    bool OpenAudioChannelCapturing();
+    void RunScheduledTasks();
+    void DropScheduledTasks(SchedulePriority priority, std::initializer_list<const char*> coalesce_keys);
     void OnWakeWordDetected();
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
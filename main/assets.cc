@@ -4,11 +4,20 @@
 #include "application.h"
 #include "lvgl_theme.h"
 #include "emote_display.h"
+#include "resumable_download.h"
+#include "lz4_block.h"
+#ifdef HAVE_LVGL
+#include "gif/lvgl_gif_atlas.h"
+#endif
 
 #include <esp_log.h>
+#include <esp_heap_caps.h>
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
+#include <esp_rom_crc.h>
 #include <cbin_font.h>
+#include <algorithm>
+#include <cstring>
 
 
 #define TAG "Assets"
@@ -21,16 +30,92 @@ struct mmap_assets_table {
     uint16_t asset_height;        /*!< Height of the asset */
 };
 
+// Format v2 starts with this magic, followed by the file count, the CRC32 of the entry
+// table, the payload length and 52 byte entries. Each entry has its own CRC32, so only
+// the table is checked at boot and payloads are verified when they are first used.
+#define ASSETS_V2_MAGIC 0x32415a58 // "XZA2"
+
+struct mmap_assets_table_v2 {
+    char asset_name[32];          /*!< Name of the asset */
+    uint32_t asset_size;          /*!< Stored size of the asset */
+    uint32_t asset_offset;        /*!< Offset of the asset */
+    uint32_t asset_raw_size;      /*!< Size after decompression */
+    uint32_t asset_crc32;         /*!< CRC32 of the stored bytes */
+    uint8_t compression;          /*!< AssetCompression */
+    uint8_t reserved[3];
+};
 
 Assets::Assets() {
+    scan_event_group_ = xEventGroupCreate();
+    xEventGroupSetBits(scan_event_group_, ASSETS_SCAN_IDLE_EVENT);
+
     // Initialize the partition
     InitializePartition();
 }
 
 Assets::~Assets() {
+    StopIntegrityScan();
+    ClearDecompressCache();
     if (mmap_handle_ != 0) {
         esp_partition_munmap(mmap_handle_);
     }
+    vEventGroupDelete(scan_event_group_);
+}
+
+void Assets::ClearDecompressCache() {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    for (auto buffer : decompressed_) {
+        heap_caps_free(buffer);
+    }
+    decompressed_.clear();
+    decompressed_bytes_ = 0;
+}
+
+const char* Assets::GetEntryName(uint32_t index) const {
+    // asset_name is the first field of both table layouts
+    return table_ + index * entry_size_;
+}
+
+Asset Assets::GetEntry(uint32_t index) const {
+    if (v2_) {
+        auto item = (const mmap_assets_table_v2*)(table_ + index * entry_size_);
+        return Asset{
+            .size = static_cast<size_t>(item->asset_size),
+            .offset = data_offset_ + item->asset_offset,
+            .raw_size = static_cast<size_t>(item->asset_raw_size),
+            .compression = static_cast<AssetCompression>(item->compression),
+            .crc32 = item->asset_crc32
+        };
+    }
+    auto item = (const mmap_assets_table*)(table_ + index * entry_size_);
+    return Asset{
+        .size = static_cast<size_t>(item->asset_size),
+        .offset = data_offset_ + item->asset_offset,
+        .raw_size = static_cast<size_t>(item->asset_size),
+        .compression = kAssetCompressionNone,
+        .crc32 = 0
+    };
+}
+
+int Assets::FindEntry(const std::string& name) const {
+    if (name.size() > 32) {
+        return -1;
+    }
+    int low = 0;
+    int high = (int)file_count_ - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        uint32_t index = sorted_index_.empty() ? mid : sorted_index_[mid];
+        int cmp = strncmp(GetEntryName(index), name.c_str(), 32);
+        if (cmp == 0) {
+            return index;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return -1;
 }
 
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
@@ -42,9 +127,13 @@ uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
 }
 
 bool Assets::InitializePartition() {
+    StopIntegrityScan();
     partition_valid_ = false;
     checksum_valid_ = false;
-    assets_.clear();
+    ClearDecompressCache();
+    file_count_ = 0;
+    sorted_index_.clear();
+    states_.clear();
 
     partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
     if (partition_ == nullptr) {
@@ -69,34 +158,82 @@ bool Assets::InitializePartition() {
 
     partition_valid_ = true;
 
-    uint32_t stored_files = *(uint32_t*)(mmap_root_ + 0);
-    uint32_t stored_chksum = *(uint32_t*)(mmap_root_ + 4);
-    uint32_t stored_len = *(uint32_t*)(mmap_root_ + 8);
+    // v2 images are prefixed by a magic, the rest of the header is shared with v1
+    bool v2 = *(const uint32_t*)mmap_root_ == ASSETS_V2_MAGIC;
+    const char* root = v2 ? mmap_root_ + 4 : mmap_root_;
+    uint32_t stored_files = *(uint32_t*)(root + 0);
+    uint32_t stored_chksum = *(uint32_t*)(root + 4);
+    uint32_t stored_len = *(uint32_t*)(root + 8);
 
-    if (stored_len > partition_->size - 12) {
+    if (stored_len > partition_->size - 12 - (root - mmap_root_)) {
         ESP_LOGD(TAG, "The stored_len (0x%lx) is greater than the partition size (0x%lx) - 12", stored_len, partition_->size);
         return false;
     }
 
+    size_t entry_size = v2 ? sizeof(mmap_assets_table_v2) : sizeof(mmap_assets_table);
+    if ((uint64_t)stored_files * entry_size > stored_len || stored_files > UINT16_MAX) {
+        ESP_LOGE(TAG, "The file count %lu does not fit in %lu bytes", stored_files, stored_len);
+        return false;
+    }
+
     auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
+    if (v2) {
+        // Only the entry table is checked at boot, payloads are checked lazily
+        uint32_t calculated_crc = esp_rom_crc32_le(0, (const uint8_t*)root + 12, stored_files * sizeof(mmap_assets_table_v2));
+        if (calculated_crc != stored_chksum) {
+            ESP_LOGE(TAG, "The index CRC32 (0x%08lx) does not match the stored CRC32 (0x%08lx)", calculated_crc, stored_chksum);
+            return false;
+        }
+    } else {
+        uint32_t calculated_checksum = CalculateChecksum(root + 12, stored_len);
+        if (calculated_checksum != stored_chksum) {
+            ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+            return false;
+        }
+    }
     auto end_time = esp_timer_get_time();
     ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
 
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
-        return false;
-    }
-
     checksum_valid_ = true;
 
-    for (uint32_t i = 0; i < stored_files; i++) {
-        auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
-        auto asset = Asset{
-            .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
-        };
-        assets_[item->asset_name] = asset;
+    table_ = root + 12;
+    file_count_ = stored_files;
+    entry_size_ = v2 ? sizeof(mmap_assets_table_v2) : sizeof(mmap_assets_table);
+    data_offset_ = (root - mmap_root_) + 12 + entry_size_ * stored_files;
+    v2_ = v2;
+    // One state per entry; v1 payloads were covered by the whole image checksum above
+    states_.assign(file_count_, v2 ? kAssetStateUnverified : kAssetStateVerified);
+
+    // The entry table is used in place; only an unsorted (v1) table needs an index
+    bool sorted = true;
+    for (uint32_t i = 1; i < file_count_ && sorted; i++) {
+        sorted = strncmp(GetEntryName(i - 1), GetEntryName(i), 32) < 0;
+    }
+    if (!sorted) {
+        sorted_index_.resize(file_count_);
+        for (uint32_t i = 0; i < file_count_; i++) {
+            sorted_index_[i] = i;
+        }
+        std::sort(sorted_index_.begin(), sorted_index_.end(), [this](uint16_t a, uint16_t b) {
+            return strncmp(GetEntryName(a), GetEntryName(b), 32) < 0;
+        });
+    }
+
+    size_t compressed_count = 0;
+    for (uint32_t i = 0; i < file_count_; i++) {
+        auto asset = GetEntry(i);
+        if (asset.offset + 2 + asset.size > (size_t)(root - mmap_root_) + 12 + stored_len) {
+            ESP_LOGE(TAG, "The asset %.32s is out of bounds", GetEntryName(i));
+            states_[i] = kAssetStateCorrupted;
+        }
+        if (asset.compression != kAssetCompressionNone) {
+            compressed_count++;
+        }
+    }
+    ESP_LOGI(TAG, "Assets format v%d, %lu files (%s table), %u compressed", v2 ? 2 : 1, file_count_,
+        sorted ? "sorted" : "indexed", compressed_count);
+    if (v2) {
+        StartIntegrityScan();
     }
     return checksum_valid_;
 }
@@ -172,6 +309,12 @@ bool Assets::Apply() {
     if (cJSON_IsArray(emoji_collection)) {
         auto custom_emoji_collection = std::make_shared<EmojiCollection>();
         int emoji_count = cJSON_GetArraySize(emoji_collection);
+
+        // Decode short GIF emoji ahead of time, never using more than a quarter of the free PSRAM
+        size_t prerender_budget = CONFIG_EMOJI_PRERENDER_CACHE_SIZE_KB * 1024;
+        prerender_budget = std::min(prerender_budget, heap_caps_get_free_size(MALLOC_CAP_SPIRAM) / 4);
+        size_t prerender_used = 0;
+        int prerender_count = 0;
         for (int i = 0; i < emoji_count; i++) {
             cJSON* emoji = cJSON_GetArrayItem(emoji_collection, i);
             if (cJSON_IsObject(emoji)) {
@@ -183,10 +326,26 @@ bool Assets::Apply() {
                         ESP_LOGE(TAG, "Emoji %s image file %s is not found", name->valuestring, file->valuestring);
                         continue;
                     }
-                    custom_emoji_collection->AddEmoji(name->valuestring, new LvglRawImage(ptr, size));
+                    LvglImage* image = new LvglRawImage(ptr, size);
+                    if (image->IsGif() && prerender_used < prerender_budget) {
+                        std::shared_ptr<LvglGifAtlas> atlas = LvglGifAtlas::Create(image->image_dsc(), prerender_budget - prerender_used);
+                        if (atlas) {
+                            ESP_LOGI(TAG, "Pre-rendered emoji %s: %ux%u, %u frames, %u KB, %u us/frame", name->valuestring,
+                                atlas->width(), atlas->height(), atlas->frame_count(), atlas->bytes() / 1024,
+                                atlas->decode_time_us() / atlas->frame_count());
+                            prerender_used += atlas->bytes();
+                            prerender_count++;
+                            delete image;
+                            image = new LvglPrerenderedGif(ptr, size, atlas);
+                        }
+                    }
+                    custom_emoji_collection->AddEmoji(name->valuestring, image);
                 }
             }
         }
+        if (prerender_count > 0) {
+            ESP_LOGI(TAG, "Pre-rendered %d emoji using %u KB of PSRAM", prerender_count, prerender_used / 1024);
+        }
         if (light_theme != nullptr) {
             light_theme->set_emoji_collection(custom_emoji_collection);
         }
@@ -367,151 +526,210 @@ bool Assets::Apply() {
     return true;
 }
 
-bool Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
+ResumableDownloadResult Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
     ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
     
     // 取消当前资源分区的内存映射
+    StopIntegrityScan();
     if (mmap_handle_ != 0) {
         esp_partition_munmap(mmap_handle_);
         mmap_handle_ = 0;
         mmap_root_ = nullptr;
     }
     checksum_valid_ = false;
-    assets_.clear();
-
-    // 下载新的资源文件
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    
-    if (!http->Open("GET", url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
-    }
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
-        return false;
-    }
-
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return false;
-    }
-
-    if (content_length > partition_->size) {
-        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
-        return false;
-    }
+    ClearDecompressCache();
+    file_count_ = 0;
+    sorted_index_.clear();
+    states_.clear();
 
     // 定义扇区大小为4KB（ESP32的标准扇区大小）
     const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    
-    // 计算需要擦除的扇区数量
-    size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE; // 向上取整
-    size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
-    
-    ESP_LOGI(TAG, "Sector size: %u, content length: %u, sectors to erase: %u, total erase size: %u", 
-             SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
-    
-    // 写入新的资源文件到分区，一边erase一边写入
-    char buffer[512];
-    size_t total_written = 0;
-    size_t recent_written = 0;
-    size_t current_sector = 0;
-    auto last_calc_time = esp_timer_get_time();
-    
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
-        }
 
-        if (ret == 0) {
-            break;
+    // 下载新的资源文件，断线后从 NVS 记录的位置用 Range 请求续传
+    ResumableDownload download(url, "assets_download", partition_);
+
+    // 下载与擦写并行：写入线程按整块擦除扇区后写入，网络读取不再被擦除阻塞
+    size_t erased_end = 0;
+    size_t next_offset = SIZE_MAX;
+    auto result = download.Run([&](const uint8_t* data, size_t size, size_t offset) {
+        // 首次写入或重试回退时，从当前位置重新开始擦除
+        if (offset != next_offset) {
+            erased_end = offset / SECTOR_SIZE * SECTOR_SIZE;
         }
+        next_offset = offset + size;
 
-        // 检查是否需要擦除新的扇区
-        size_t write_end_offset = total_written + ret;
-        size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-        
-        // 擦除需要的新扇区
-        while (current_sector < needed_sectors) {
-            size_t sector_start = current_sector * SECTOR_SIZE;
-            size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
-            
+        size_t write_end_offset = offset + size;
+        size_t erase_end = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE * SECTOR_SIZE;
+        if (erase_end > erased_end) {
             // 确保擦除范围不超过分区大小
-            if (sector_end > partition_->size) {
-                ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
+            if (erase_end > partition_->size) {
+                ESP_LOGE(TAG, "Erase end (%u) exceeds partition size (%lu)", erase_end, partition_->size);
                 return false;
             }
-            
-            ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
-            esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
+            esp_err_t err = esp_partition_erase_range(partition_, erased_end, erase_end - erased_end);
             if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
+                ESP_LOGE(TAG, "Failed to erase range at offset %u: %s", erased_end, esp_err_to_name(err));
                 return false;
             }
-            
-            current_sector++;
+            erased_end = erase_end;
         }
 
-        // 写入数据到分区
-        esp_err_t err = esp_partition_write(partition_, total_written, buffer, ret);
+        esp_err_t err = esp_partition_write(partition_, offset, data, size);
         if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
+            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", offset, esp_err_to_name(err));
             return false;
         }
+        return true;
+    }, progress_callback);
 
-        total_written += ret;
-        recent_written += ret;
-
-        // 计算进度和速度
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_written == content_length || ret == 0) {
-            size_t progress = total_written * 100 / content_length;
-            size_t speed = recent_written; // 每秒的字节数
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", 
-                     progress, total_written, content_length, speed, current_sector);
-            if (progress_callback) {
-                progress_callback(progress, speed);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0; // 重置最近写入的字节数
-        }
+    if (result != kResumableDownloadOk) {
+        ESP_LOGE(TAG, "Failed to download assets");
+        return result;
     }
-    
-    http->Close();
 
-    if (total_written != content_length) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_written, content_length);
-        return false;
-    }
-
-    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u", 
-             total_written, current_sector);
+    size_t total_written = download.content_length();
+    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u",
+             total_written, erased_end / SECTOR_SIZE);
 
     // 重新初始化资源分区
     if (!InitializePartition()) {
         ESP_LOGE(TAG, "Failed to re-initialize assets partition");
-        return false;
+        return kResumableDownloadFailed;
     }
 
-    return true;
+    return kResumableDownloadOk;
 }
 
 bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+    int index = FindEntry(name);
+    if (index < 0) {
+        return false;
+    }
+    auto asset = GetEntry(index);
+    if (!VerifyAsset(index, asset)) {
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
+    auto data = (const char*)(mmap_root_ + asset.offset);
     if (data[0] != 'Z' || data[1] != 'Z') {
         ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
         return false;
     }
 
+    if (asset.compression != kAssetCompressionNone) {
+        if (!Decompress(index, asset, data + 2, ptr)) {
+            return false;
+        }
+        size = asset.raw_size;
+        return true;
+    }
+
     ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
+    size = asset.size;
+    return true;
+}
+
+bool Assets::VerifyAsset(uint32_t index, const Asset& asset) {
+    {
+        std::lock_guard<std::mutex> lock(data_mutex_);
+        if (states_[index] != kAssetStateUnverified) {
+            return states_[index] == kAssetStateVerified;
+        }
+    }
+
+    // The CRC of a large asset takes a while, other lookups and decompression go on meanwhile.
+    // Two callers may check the same entry at once, they store the same result.
+    auto data = (const uint8_t*)mmap_root_ + asset.offset + 2;
+    uint32_t crc = esp_rom_crc32_le(0, data, asset.size);
+    if (crc != asset.crc32) {
+        ESP_LOGE(TAG, "The asset %.32s is corrupted, CRC32 0x%08lx expected 0x%08lx", GetEntryName(index), crc, asset.crc32);
+    }
+
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    states_[index] = crc == asset.crc32 ? kAssetStateVerified : kAssetStateCorrupted;
+    return states_[index] == kAssetStateVerified;
+}
+
+void Assets::StartIntegrityScan() {
+    scan_abort_ = false;
+    xEventGroupClearBits(scan_event_group_, ASSETS_SCAN_IDLE_EVENT);
+    if (xTaskCreate([](void* arg) {
+        auto assets = static_cast<Assets*>(arg);
+        assets->IntegrityScanTask();
+        xEventGroupSetBits(assets->scan_event_group_, ASSETS_SCAN_IDLE_EVENT);
+        vTaskDelete(NULL);
+    }, "assets_scan", 3072, this, 1, nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create integrity scan task");
+        xEventGroupSetBits(scan_event_group_, ASSETS_SCAN_IDLE_EVENT);
+    }
+}
+
+void Assets::StopIntegrityScan() {
+    scan_abort_ = true;
+    xEventGroupWaitBits(scan_event_group_, ASSETS_SCAN_IDLE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+}
+
+void Assets::IntegrityScanTask() {
+    // Low priority walk over every entry so corruption is found even in assets never used
+    auto start_time = esp_timer_get_time();
+    size_t bytes = 0;
+    int corrupted = 0;
+    for (uint32_t i = 0; i < file_count_; i++) {
+        if (scan_abort_) {
+            return;
+        }
+        auto asset = GetEntry(i);
+        if (!VerifyAsset(i, asset)) {
+            corrupted++;
+        }
+        bytes += asset.size;
+        vTaskDelay(1);
+    }
+    ESP_LOGI(TAG, "Integrity scan checked %lu files (%u KB) in %d ms, %d corrupted", file_count_, bytes / 1024,
+        int((esp_timer_get_time() - start_time) / 1000), corrupted);
+}
+
+bool Assets::Decompress(uint32_t index, const Asset& asset, const char* data, void*& ptr) {
+    std::lock_guard<std::mutex> lock(data_mutex_);
+    if (decompressed_.empty()) {
+        decompressed_.resize(file_count_, nullptr);
+    }
+    if (decompressed_[index] != nullptr) {
+        ptr = decompressed_[index];
+        return true;
+    }
+    const char* name = GetEntryName(index);
+
+    if (asset.compression != kAssetCompressionLz4) {
+        ESP_LOGE(TAG, "The asset %.32s uses unsupported compression %u", name, asset.compression);
+        return false;
+    }
+    if (decompressed_bytes_ + asset.raw_size > CONFIG_ASSETS_DECOMPRESS_CACHE_SIZE_KB * 1024) {
+        ESP_LOGE(TAG, "No room to decompress %.32s (%u bytes), cache holds %u of %u KB", name,
+            asset.raw_size, decompressed_bytes_ / 1024, CONFIG_ASSETS_DECOMPRESS_CACHE_SIZE_KB);
+        return false;
+    }
+
+    auto buffer = (uint8_t*)heap_caps_malloc(asset.raw_size, MALLOC_CAP_SPIRAM);
+    if (buffer == nullptr) {
+        buffer = (uint8_t*)heap_caps_malloc(asset.raw_size, MALLOC_CAP_8BIT);
+    }
+    if (buffer == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for %.32s", asset.raw_size, name);
+        return false;
+    }
+
+    auto start_time = esp_timer_get_time();
+    int ret = Lz4DecompressBlock((const uint8_t*)data, asset.size, buffer, asset.raw_size);
+    if (ret != (int)asset.raw_size) {
+        ESP_LOGE(TAG, "Failed to decompress %.32s: %d/%u", name, ret, asset.raw_size);
+        heap_caps_free(buffer);
+        return false;
+    }
+    auto elapsed_us = esp_timer_get_time() - start_time;
+    ESP_LOGD(TAG, "Decompressed %.32s: %u -> %u bytes in %lld us", name, asset.size, asset.raw_size, elapsed_us);
+
+    decompressed_[index] = buffer;
+    decompressed_bytes_ += asset.raw_size;
+    ptr = buffer;
     return true;
 }
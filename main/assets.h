@@ -1,18 +1,40 @@
 #ifndef ASSETS_H
 #define ASSETS_H
 
-#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
 #include <string>
 #include <functional>
 
+#include "resumable_download.h"
+
 #include <cJSON.h>
 #include <esp_partition.h>
 #include <model_path.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+#define ASSETS_SCAN_IDLE_EVENT (1 << 0)
+
+enum AssetCompression : uint8_t {
+    kAssetCompressionNone = 0,
+    kAssetCompressionLz4 = 1,
+};
 
+enum AssetState : uint8_t {
+    kAssetStateUnverified = 0,
+    kAssetStateVerified,
+    kAssetStateCorrupted,
+};
 
 struct Asset {
-    size_t size;
+    size_t size;        // Stored size in the partition
     size_t offset;
+    size_t raw_size;    // Size after decompression
+    AssetCompression compression;
+    uint32_t crc32;
 };
 
 class Assets {
@@ -23,7 +45,7 @@ public:
     }
     ~Assets();
 
-    bool Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
+    ResumableDownloadResult Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
     bool Apply();
     bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
 
@@ -38,6 +60,15 @@ private:
 
     bool InitializePartition();
     uint32_t CalculateChecksum(const char* data, uint32_t length);
+    const char* GetEntryName(uint32_t index) const;
+    Asset GetEntry(uint32_t index) const;
+    int FindEntry(const std::string& name) const;
+    bool Decompress(uint32_t index, const Asset& asset, const char* data, void*& ptr);
+    void ClearDecompressCache();
+    bool VerifyAsset(uint32_t index, const Asset& asset);
+    void StartIntegrityScan();
+    void StopIntegrityScan();
+    void IntegrityScanTask();
 
     const esp_partition_t* partition_ = nullptr;
     esp_partition_mmap_handle_t mmap_handle_ = 0;
@@ -46,7 +77,26 @@ private:
     bool checksum_valid_ = false;
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
-    std::map<std::string, Asset> assets_;
+
+    // Lookups binary search the entry table in the mmapped partition. v2 tables are sorted
+    // by the packer; v1 tables get a sorted index of entry numbers built once at boot.
+    const char* table_ = nullptr;
+    uint32_t file_count_ = 0;
+    size_t entry_size_ = 0;
+    size_t data_offset_ = 0;
+    bool v2_ = false;
+    std::vector<uint16_t> sorted_index_;
+    std::vector<AssetState> states_;
+
+    // Compressed entries are inflated into PSRAM on first use. Callers keep the returned
+    // pointers for the lifetime of the theme, so entries are only dropped with the partition.
+    std::mutex data_mutex_;
+    std::vector<uint8_t*> decompressed_;
+    size_t decompressed_bytes_ = 0;
+
+    // v2 entries carry a CRC32 that is checked on first access and by a background scan
+    EventGroupHandle_t scan_event_group_ = nullptr;
+    std::atomic<bool> scan_abort_{false};
 };
 
 #endif
@@ -204,7 +204,7 @@ void AudioService::AudioInputTask() {
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / encoder_frame_duration_) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
                 continue;
@@ -297,7 +297,7 @@ void AudioService::OpusCodecTask() {
         std::unique_lock<std::mutex> lock(audio_queue_mutex_);
         audio_queue_cv_.wait(lock, [this]() {
             return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+                !audio_encode_queue_.empty() ||
                 (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
         });
         if (service_stopped_) {
@@ -316,6 +316,7 @@ void AudioService::OpusCodecTask() {
             task->timestamp = packet->timestamp;
 
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+            // An empty payload marks a lost packet, the decoder conceals it (PLC)
             if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
                 // Resample if the sample rate is different
                 if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
@@ -335,33 +336,60 @@ void AudioService::OpusCodecTask() {
             debug_statistics_.decode_count++;
         }
         
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+        /* Encode the audio to send queue, never waiting for the sender so the input task is not blocked */
+        if (!audio_encode_queue_.empty()) {
             auto task = std::move(audio_encode_queue_.front());
             audio_encode_queue_.pop_front();
             audio_queue_cv_.notify_all();
             lock.unlock();
 
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
+            // The frame duration only changes between sessions, see UplinkController
+            int frame_duration = uplink_controller_.frame_duration_ms();
+            if (frame_duration != encoder_frame_duration_) {
+                ESP_LOGI(TAG, "Uplink frame duration %d -> %d ms", encoder_frame_duration_, frame_duration);
+                opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, frame_duration);
+                opus_encoder_->SetComplexity(0);
+                encoder_frame_duration_ = frame_duration;
             }
 
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
+            // Shorter frames produce several packets per processor chunk
+            bool queued = false;
+            opus_encoder_->Encode(std::move(task->pcm), [this, &task, &queued](std::vector<uint8_t>&& opus) {
+                auto packet = std::make_unique<AudioStreamPacket>();
+                packet->frame_duration = encoder_frame_duration_;
+                packet->sample_rate = 16000;
+                packet->timestamp = task->timestamp;
+                packet->payload = std::move(opus);
+
+                if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+                    uint32_t queue_ms;
+                    int dropped = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+                        send_queue_ms_ += packet->frame_duration;
+                        audio_send_queue_.push_back(std::move(packet));
+                        // A ring of the latest audio: while connecting or congested the oldest goes first
+                        while (send_queue_ms_ > MAX_SEND_QUEUE_MS && audio_send_queue_.size() > 1) {
+                            send_queue_ms_ -= audio_send_queue_.front()->frame_duration;
+                            audio_send_queue_.pop_front();
+                            dropped++;
+                        }
+                        queue_ms = send_queue_ms_;
+                    }
+                    // Log once per overflow, not for every packet of a slow connect
+                    if (dropped > 0 && !send_queue_dropping_) {
+                        ESP_LOGW(TAG, "Send queue full (%lu ms), dropping the oldest audio", queue_ms);
+                    }
+                    send_queue_dropping_ = dropped > 0;
+                    uplink_controller_.OnPacketQueued(queue_ms);
+                    queued = true;
+                } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
                     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
+                    audio_testing_queue_.push_back(std::move(packet));
                 }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+            });
+            if (queued && callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
             }
             debug_statistics_.encode_count++;
             lock.lock();
@@ -430,13 +458,27 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
     }
     auto packet = std::move(audio_send_queue_.front());
     audio_send_queue_.pop_front();
+    send_queue_ms_ -= packet->frame_duration;
     audio_queue_cv_.notify_all();
     return packet;
 }
 
+void AudioService::PushPacketToSendQueueFront(std::unique_ptr<AudioStreamPacket> packet) {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    send_queue_ms_ += packet->frame_duration;
+    audio_send_queue_.push_front(std::move(packet));
+}
+
+void AudioService::ClearSendQueue() {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+    audio_send_queue_.clear();
+    send_queue_ms_ = 0;
+    audio_queue_cv_.notify_all();
+}
+
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
-        wake_word_->EncodeWakeWordData();
+        wake_word_->EncodeWakeWordData(uplink_controller_.frame_duration_ms());
     }
 }
 
@@ -446,6 +488,8 @@ const std::string& AudioService::GetLastWakeWord() const {
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
     auto packet = std::make_unique<AudioStreamPacket>();
+    packet->sample_rate = 16000;
+    packet->frame_duration = uplink_controller_.frame_duration_ms();
     if (wake_word_->GetWakeWordOpus(packet->payload)) {
         return packet;
     }
@@ -22,6 +22,7 @@
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "uplink_controller.h"
 
 
 /*
@@ -39,7 +40,9 @@
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+// Bounded by audio duration, the packet count depends on the uplink frame duration. Audio
+// captured while the channel is connecting is capped by this too, the oldest is dropped.
+#define MAX_SEND_QUEUE_MS 2400
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
 
@@ -105,11 +108,15 @@ public:
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    // Puts back a packet that could not be sent, it goes out first next time
+    void PushPacketToSendQueueFront(std::unique_ptr<AudioStreamPacket> packet);
+    void ClearSendQueue();
     void PlaySound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void UpdateOutputTimestamp();
     void SetModelsList(srmodel_list_t* models_list);
+    UplinkController& uplink_controller() { return uplink_controller_; }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -123,6 +130,8 @@ private:
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
     DebugStatistics debug_statistics_;
+    UplinkController uplink_controller_;
+    int encoder_frame_duration_ = OPUS_FRAME_DURATION_MS;
     srmodel_list_t* models_list_ = nullptr;
 
     EventGroupHandle_t event_group_;
@@ -135,6 +144,8 @@ private:
     std::condition_variable audio_queue_cv_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
+    uint32_t send_queue_ms_ = 0;    // Sum of the frame durations in audio_send_queue_
+    bool send_queue_dropping_ = false;
     std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
     std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
@@ -0,0 +1,96 @@
+#include "uplink_controller.h"
+#include "audio_service.h"
+
+#include <esp_log.h>
+
+#define TAG "UplinkController"
+
+// Send queue backlog that counts as congestion
+#define UPLINK_CONGESTED_QUEUE_MS 600
+
+static const int kFrameDurations[] = { 20, 40, 60 };
+static const int kLevelCount = sizeof(kFrameDurations) / sizeof(kFrameDurations[0]);
+
+UplinkController::UplinkController() {
+    // Start from the fixed frame duration used before adaptation existed
+    level_ = kLevelCount - 1;
+    for (int i = 0; i < kLevelCount; i++) {
+        if (kFrameDurations[i] == OPUS_FRAME_DURATION_MS) {
+            level_ = i;
+        }
+    }
+}
+
+void UplinkController::OnUplinkStarted() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    started_ = true;
+}
+
+void UplinkController::OnPacketQueued(uint32_t queue_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Audio captured while connecting is flushed in a burst, judge the queue once it was sent
+    if (!drained_) {
+        drained_ = started_ && queue_ms < UPLINK_CONGESTED_QUEUE_MS;
+        return;
+    }
+    if (queue_ms > max_queue_ms_) {
+        max_queue_ms_ = queue_ms;
+    }
+    if (queue_ms >= UPLINK_CONGESTED_QUEUE_MS) {
+        congested_packets_++;
+    }
+}
+
+void UplinkController::OnPacketSent(bool success, uint32_t duration_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!started_) {
+        return;
+    }
+    packets_++;
+    if (!success) {
+        failed_sends_++;
+    }
+    // Exponential moving average with 1/8 weight
+    avg_send_us_ = packets_ == 1 ? duration_us : avg_send_us_ - avg_send_us_ / 8 + duration_us / 8;
+}
+
+void UplinkController::EndSession() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    started_ = false;
+    drained_ = false;
+    if (packets_ == 0) {
+        return;
+    }
+
+    int previous_level = level_;
+    uint32_t frame_us = kFrameDurations[level_] * 1000;
+    if (congested_packets_ > 0 || failed_sends_ > 0 || avg_send_us_ > frame_us) {
+        if (level_ < kLevelCount - 1) {
+            level_++;
+        }
+    } else if (max_queue_ms_ <= (uint32_t)kFrameDurations[level_] * 2 && avg_send_us_ < frame_us / 4) {
+        // Backlog never exceeded two frames and sends used under a quarter of the frame time
+        if (level_ > 0) {
+            level_--;
+        }
+    }
+
+    ESP_LOGI(TAG, "Session: %lu packets, %lu failed, %lu congested, max queue %lu ms, avg send %lu us, frame %d -> %d ms",
+        packets_, failed_sends_, congested_packets_, max_queue_ms_, avg_send_us_,
+        kFrameDurations[previous_level], kFrameDurations[level_]);
+
+    packets_ = 0;
+    failed_sends_ = 0;
+    congested_packets_ = 0;
+    max_queue_ms_ = 0;
+    avg_send_us_ = 0;
+}
+
+int UplinkController::frame_duration_ms() const {
+#if CONFIG_USE_ADAPTIVE_UPLINK
+    std::lock_guard<std::mutex> lock(mutex_);
+    return kFrameDurations[level_];
+#else
+    return OPUS_FRAME_DURATION_MS;
+#endif
+}
@@ -0,0 +1,52 @@
+#ifndef UPLINK_CONTROLLER_H
+#define UPLINK_CONTROLLER_H
+
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Adapts the Opus uplink frame duration (20 / 40 / 60 ms) to the network.
+ *
+ * Every queued and sent packet is observed: a send queue backlog above
+ * UPLINK_CONGESTED_QUEUE_MS or sends slower than real time mark the session as congested.
+ * When a session ends, congested sessions move to longer frames (fewer packets, less
+ * per-packet overhead) and clean sessions try shorter frames (lower latency).
+ * The duration only changes between sessions, so the value announced in the next hello
+ * always matches what the encoder produces.
+ *
+ * Nothing is judged before the channel is open and listening started: speech captured
+ * while connecting waits in the send queue by design and is neither a backlog nor a
+ * failed send.
+ */
+class UplinkController {
+public:
+    UplinkController();
+
+    // Called by the encoder after a packet was queued, queue_ms includes that packet
+    void OnPacketQueued(uint32_t queue_ms);
+    // Called once listen start was sent and the queued audio may go out
+    void OnUplinkStarted();
+    // Called by the sender for every packet handed to the protocol
+    void OnPacketSent(bool success, uint32_t duration_us);
+    // Evaluate the finished session and pick the frame duration for the next one
+    void EndSession();
+
+    int frame_duration_ms() const;
+
+private:
+    mutable std::mutex mutex_;
+    int level_;
+
+    bool started_ = false;
+    bool drained_ = false;      // The backlog from connecting was sent
+
+    // Statistics of the current session
+    uint32_t packets_ = 0;
+    uint32_t failed_sends_ = 0;
+    uint32_t congested_packets_ = 0;
+    uint32_t max_queue_ms_ = 0;
+    uint32_t avg_send_us_ = 0;
+};
+
+#endif // UPLINK_CONTROLLER_H
@@ -0,0 +1,248 @@
+#include "delta_patch.h"
+#include "lz4_block.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "DeltaPatch"
+
+#define DELTA_PATCH_CHUNK_SIZE 4096
+
+DeltaPatch::DeltaPatch(const esp_partition_t* source, Writer writer)
+    : source_(source), writer_(writer) {
+    output_.reserve(DELTA_PATCH_CHUNK_SIZE);
+    source_buffer_.resize(DELTA_PATCH_CHUNK_SIZE);
+}
+
+static uint32_t ReadLe32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool DeltaPatch::ParseHeader() {
+    // Version 1 patches are version 2 without compressed ops
+    if (memcmp(header_, DELTA_PATCH_MAGIC, 4) != 0 || header_[4] < 1 || header_[4] > DELTA_PATCH_VERSION) {
+        ESP_LOGE(TAG, "Invalid patch header");
+        return false;
+    }
+    source_size_ = ReadLe32(header_ + 8);
+    target_size_ = ReadLe32(header_ + 12);
+    if (source_size_ > source_->size) {
+        ESP_LOGE(TAG, "Patch source size %u exceeds partition %s", source_size_, source_->label);
+        return false;
+    }
+    ESP_LOGI(TAG, "Applying patch: source %u bytes, target %u bytes", source_size_, target_size_);
+    return true;
+}
+
+bool DeltaPatch::BeginOp() {
+    uint32_t value = ReadLe32(arg_);
+    switch (op_) {
+    case kOpSeek: {
+        int64_t pos = (int64_t)source_pos_ + (int32_t)value;
+        if (pos < 0 || pos > (int64_t)source_size_) {
+            ESP_LOGE(TAG, "Seek out of source range: %lld", pos);
+            return false;
+        }
+        source_pos_ = pos;
+        state_ = kStateOpType;
+        return true;
+    }
+    case kOpCopy:
+        state_ = kStateOpType;
+        return CopySource(value);
+    case kOpAdd:
+        if (source_pos_ + value > source_size_) {
+            ESP_LOGE(TAG, "Add out of source range");
+            return false;
+        }
+        // fall through
+    case kOpInsert:
+        remaining_ = value;
+        state_ = value > 0 ? kStateOpData : kStateOpType;
+        return true;
+    case kOpInsertLz4:
+    case kOpAddLz4:
+        // Worst case LZ4 expansion is 1/255 plus a few bytes
+        if (value <= 4 || value > 4 + DELTA_PATCH_LZ4_MAX_RAW + DELTA_PATCH_LZ4_MAX_RAW / 255 + 16) {
+            ESP_LOGE(TAG, "Invalid compressed op size %lu", value);
+            return false;
+        }
+        packed_.clear();
+        packed_.reserve(value);
+        remaining_ = value;
+        state_ = kStateOpData;
+        return true;
+    default:
+        ESP_LOGE(TAG, "Unknown patch op %u", op_);
+        return false;
+    }
+}
+
+bool DeltaPatch::Feed(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        switch (state_) {
+        case kStateHeader: {
+            size_t n = std::min(size, sizeof(header_) - filled_);
+            memcpy(header_ + filled_, data, n);
+            filled_ += n;
+            data += n;
+            size -= n;
+            if (filled_ == sizeof(header_)) {
+                if (!ParseHeader()) {
+                    state_ = kStateError;
+                    return false;
+                }
+                state_ = kStateOpType;
+            }
+            break;
+        }
+        case kStateOpType:
+            op_ = *data++;
+            size--;
+            filled_ = 0;
+            state_ = kStateOpArg;
+            break;
+        case kStateOpArg: {
+            size_t n = std::min(size, sizeof(arg_) - filled_);
+            memcpy(arg_ + filled_, data, n);
+            filled_ += n;
+            data += n;
+            size -= n;
+            if (filled_ == sizeof(arg_) && !BeginOp()) {
+                state_ = kStateError;
+                return false;
+            }
+            break;
+        }
+        case kStateOpData: {
+            size_t n = std::min<size_t>(size, remaining_);
+            bool ok;
+            if (op_ == kOpInsertLz4 || op_ == kOpAddLz4) {
+                packed_.insert(packed_.end(), data, data + n);
+                ok = remaining_ > n || UnpackOp();
+            } else {
+                ok = op_ == kOpAdd ? AddSource(data, n) : Emit(data, n);
+            }
+            if (!ok) {
+                state_ = kStateError;
+                return false;
+            }
+            data += n;
+            size -= n;
+            remaining_ -= n;
+            if (remaining_ == 0) {
+                state_ = kStateOpType;
+            }
+            break;
+        }
+        case kStateError:
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatch::Emit(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t n = std::min(size, DELTA_PATCH_CHUNK_SIZE - output_.size());
+        if (target_written_ + output_.size() + n > target_size_) {
+            ESP_LOGE(TAG, "Patch produces more than %u bytes", target_size_);
+            return false;
+        }
+        output_.insert(output_.end(), data, data + n);
+        data += n;
+        size -= n;
+        if (output_.size() == DELTA_PATCH_CHUNK_SIZE && !Flush()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatch::CopySource(size_t size) {
+    if (source_pos_ + size > source_size_) {
+        ESP_LOGE(TAG, "Copy out of source range");
+        return false;
+    }
+    while (size > 0) {
+        size_t n = std::min(size, source_buffer_.size());
+        if (esp_partition_read(source_, source_pos_, source_buffer_.data(), n) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read source at %u", source_pos_);
+            return false;
+        }
+        if (!Emit(source_buffer_.data(), n)) {
+            return false;
+        }
+        source_pos_ += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool DeltaPatch::AddSource(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        size_t n = std::min(size, source_buffer_.size());
+        if (esp_partition_read(source_, source_pos_, source_buffer_.data(), n) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read source at %u", source_pos_);
+            return false;
+        }
+        for (size_t i = 0; i < n; i++) {
+            source_buffer_[i] += data[i];
+        }
+        if (!Emit(source_buffer_.data(), n)) {
+            return false;
+        }
+        source_pos_ += n;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool DeltaPatch::UnpackOp() {
+    uint32_t raw_size = ReadLe32(packed_.data());
+    if (raw_size > DELTA_PATCH_LZ4_MAX_RAW) {
+        ESP_LOGE(TAG, "Compressed op of %lu bytes exceeds the limit", raw_size);
+        return false;
+    }
+    unpacked_.resize(raw_size);
+    int ret = Lz4DecompressBlock(packed_.data() + 4, packed_.size() - 4, unpacked_.data(), raw_size);
+    if (ret != (int)raw_size) {
+        ESP_LOGE(TAG, "Failed to decompress patch op");
+        return false;
+    }
+    if (op_ == kOpInsertLz4) {
+        return Emit(unpacked_.data(), raw_size);
+    }
+    if (source_pos_ + raw_size > source_size_) {
+        ESP_LOGE(TAG, "Add out of source range");
+        return false;
+    }
+    return AddSource(unpacked_.data(), raw_size);
+}
+
+bool DeltaPatch::Flush() {
+    if (output_.empty()) {
+        return true;
+    }
+    if (!writer_(output_.data(), output_.size())) {
+        return false;
+    }
+    target_written_ += output_.size();
+    output_.clear();
+    return true;
+}
+
+bool DeltaPatch::Finish() {
+    if (state_ != kStateOpType || !Flush()) {
+        ESP_LOGE(TAG, "Patch is truncated or invalid");
+        return false;
+    }
+    if (target_written_ != target_size_) {
+        ESP_LOGE(TAG, "Patch produced %u bytes, expected %u", target_written_, target_size_);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <esp_partition.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define DELTA_PATCH_MAGIC "XZDP"
+#define DELTA_PATCH_VERSION 2
+// Raw size limit of one compressed insert/add op, bounds the decode buffers
+#define DELTA_PATCH_LZ4_MAX_RAW 8192
+#define DELTA_PATCH_HEADER_SIZE 16
+
+/*
+ * Streaming applier for delta patches produced by scripts/delta_patch.py
+ *
+ * Patch layout (little endian):
+ *   header: "XZDP", u8 version, u8 reserved[3], u32 source_size, u32 target_size
+ *   ops:    u8 type followed by
+ *     kOpCopy:   u32 len              copy len bytes at the source cursor
+ *     kOpAdd:    u32 len, len bytes   add bytes to the source bytes (bsdiff style)
+ *     kOpInsert: u32 len, len bytes   literal bytes, source cursor does not move
+ *     kOpSeek:   i32 delta            move the source cursor
+ *     kOpInsertLz4, kOpAddLz4: u32 len, len bytes holding u32 raw_len and an LZ4 block
+ *                                  that decodes to the insert/add data (version 2)
+ *
+ * The patch is fed in arbitrary pieces as it is downloaded, the source is read from
+ * flash on demand and the target is handed to the writer in sequential chunks, so RAM
+ * use is bounded by one chunk (plus one compressed op) regardless of image size.
+ */
+class DeltaPatch {
+public:
+    using Writer = std::function<bool(const uint8_t* data, size_t size)>;
+
+    DeltaPatch(const esp_partition_t* source, Writer writer);
+
+    bool Feed(const uint8_t* data, size_t size);
+    // Flushes buffered output, returns true when the full target was produced
+    bool Finish();
+
+    size_t target_size() const { return target_size_; }
+    size_t target_written() const { return target_written_; }
+
+private:
+    enum Op : uint8_t {
+        kOpCopy = 1,
+        kOpAdd = 2,
+        kOpInsert = 3,
+        kOpSeek = 4,
+        kOpInsertLz4 = 5,
+        kOpAddLz4 = 6,
+    };
+    enum State {
+        kStateHeader,
+        kStateOpType,
+        kStateOpArg,
+        kStateOpData,
+        kStateError,
+    };
+
+    const esp_partition_t* source_;
+    Writer writer_;
+    State state_ = kStateHeader;
+    uint8_t header_[DELTA_PATCH_HEADER_SIZE];
+    uint8_t arg_[4];
+    size_t filled_ = 0;
+    uint8_t op_ = 0;
+    uint32_t remaining_ = 0;
+
+    size_t source_size_ = 0;
+    size_t target_size_ = 0;
+    size_t source_pos_ = 0;
+    size_t target_written_ = 0;
+    std::vector<uint8_t> output_;
+    std::vector<uint8_t> source_buffer_;
+    std::vector<uint8_t> packed_;       // Compressed op being received
+    std::vector<uint8_t> unpacked_;
+
+    bool ParseHeader();
+    bool BeginOp();
+    bool Emit(const uint8_t* data, size_t size);
+    bool CopySource(size_t size);
+    bool AddSource(const uint8_t* data, size_t size);
+    bool UnpackOp();
+    bool Flush();
+};
+
+#endif // DELTA_PATCH_H
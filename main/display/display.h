@@ -69,15 +69,18 @@ protected:
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
+    virtual void OnLockWait(uint32_t wait_us) {}
 };
 
 
 class DisplayLockGuard {
 public:
     DisplayLockGuard(Display *display) : display_(display) {
+        int64_t start_time = esp_timer_get_time();
         if (!display_->Lock(30000)) {
             ESP_LOGE("Display", "Failed to lock display");
         }
+        display_->OnLockWait(esp_timer_get_time() - start_time);
     }
     ~DisplayLockGuard() {
         display_->Unlock();
@@ -479,6 +479,8 @@ void LcdDisplay::Unlock() {
 
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
 void LcdDisplay::SetupUI() {
+    // Every LCD display builds its UI here, including board displays with their own constructor
+    InitializePerfMonitor();
     DisplayLockGuard lock(this);
 
     auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
@@ -611,6 +613,7 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     if (content_ == nullptr) {
         return;
     }
+    PerfScope perf_scope(perf_, LvglPerfMonitor::kSectionChatMessage);
     
     // Check if the number of messages exceeds the limit
     uint32_t child_count = lv_obj_get_child_cnt(content_);
@@ -674,8 +677,8 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
 
     // Create the message text
+    // The text is set last: every width, long mode or style change re-runs the label's line breaking
     lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
     
     // Calculate the actual text width
     lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
@@ -756,6 +759,8 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
         lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
     }
     
+    lv_label_set_text(msg_text, content);
+
     // Create a full-width container for user messages to ensure right alignment
     if (strcmp(role, "user") == 0) {
         // Create a full-width container
@@ -893,6 +898,8 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
 }
 #else
 void LcdDisplay::SetupUI() {
+    // Every LCD display builds its UI here, including board displays with their own constructor
+    InitializePerfMonitor();
     DisplayLockGuard lock(this);
     LvglTheme* lvgl_theme = static_cast<LvglTheme*>(current_theme_);
     auto text_font = lvgl_theme->text_font()->font();
@@ -1062,6 +1069,11 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
         return;
     }
     
+    PerfScope perf_scope(perf_, LvglPerfMonitor::kSectionChatMessage);
+    // Setting the same text again would redo the line breaking and redraw the whole label
+    if (strcmp(lv_label_get_text(chat_message_label_), content) == 0) {
+        return;
+    }
     lv_label_set_text(chat_message_label_, content);
 }
 #endif
@@ -1093,13 +1105,19 @@ void LcdDisplay::SetEmotion(const char* emotion) {
 
     DisplayLockGuard lock(this);
     if (image->IsGif()) {
-        // Create new GIF controller
-        gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
+        // Create new GIF controller, playing pre-rendered frames when the assets provided them
+        auto prerendered = dynamic_cast<const LvglPrerenderedGif*>(image);
+        if (prerendered != nullptr) {
+            gif_controller_ = std::make_unique<LvglGif>(prerendered->atlas());
+        } else {
+            gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
+        }
         
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
             gif_controller_->SetFrameCallback([this]() {
-                lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
+                perf_.RecordSection(LvglPerfMonitor::kSectionGifFrame, gif_controller_->last_frame_time_us());
+                gif_controller_->InvalidateDirtyArea(emoji_image_);
             });
             
             // Set initial frame and start animation
@@ -1818,6 +1836,7 @@ void LcdDisplay::periodicUpdateTask() {
                 DisplayLockGuard lock(this);
                 if (fft_task_should_stop) break;  // Check again after acquiring lock
                 if (canvas_ && lv_obj_is_valid(canvas_)) {  // Double check after lock
+                    PerfScope perf_scope(perf_, LvglPerfMonitor::kSectionSpectrum);
                     drawSpectrumIfReady();
                     lv_area_t refresh_area;
                     refresh_area.x1 = 0;
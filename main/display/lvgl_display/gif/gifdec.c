@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <limits.h>
 #include <esp_log.h>
 
 #define TAG "GIF"
@@ -22,7 +23,7 @@ typedef struct Table {
     Entry * entries;
 } Table;
 
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_CACHE_LZW_TABLE
 #define LZW_MAXBITS                 12
 #define LZW_TABLE_SIZE              (1 << LZW_MAXBITS)
 #define LZW_CACHE_SIZE              (LZW_TABLE_SIZE * 4)
@@ -36,6 +37,8 @@ static void f_gif_close(gd_GIF * gif);
 
 #if LV_USE_DRAW_SW_ASM == LV_DRAW_SW_ASM_HELIUM
     #include "gifdec_mve.h"
+#else
+    #include "gifdec_generic.h"
 #endif
 
 static uint16_t
@@ -116,7 +119,7 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         ESP_LOGW(TAG, "Zero size image");
         goto fail;
     }
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_CACHE_LZW_TABLE
     if(0 == (INT_MAX - sizeof(gd_GIF) - LZW_CACHE_SIZE) / width / height / 5){
         ESP_LOGW(TAG, "Image dimensions are too large");
         goto fail;
@@ -145,12 +148,12 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         memset(gif->frame, gif->bgindex, gif->width * gif->height);
     }
     bgcolor = &gif->palette->colors[gif->bgindex * 3];
-    #if LV_GIF_CACHE_DECODE_DATA
+    #if GIFDEC_CACHE_LZW_TABLE
     gif->lzw_cache = gif->frame + width * height;
     #endif
 
 #ifdef GIFDEC_FILL_BG
-    GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
+    GIFDEC_FILL_BG(gif->canvas, gif->width, gif->height, gif->width, bgcolor, 0x00);
 #else
     for(int i = 0; i < gif->width * gif->height; i++) {
         gif->canvas[i * 4 + 0] = *(bgcolor + 2);
@@ -328,7 +331,7 @@ get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *by
     return key;
 }
 
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_CACHE_LZW_TABLE
 /* Decompress image pixels.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
 static int
@@ -716,18 +719,46 @@ dispose(gd_GIF * gif)
         case 3: /* Restore to previous, i.e., don't update canvas.*/
             break;
         default:
-            /* Add frame non-transparent pixels to canvas. */
-            render_frame_rect(gif, gif->canvas);
+            /* Add frame non-transparent pixels to canvas, unless the caller
+             * already rendered this frame straight into it. */
+            if(!gif->frame_on_canvas) {
+                render_frame_rect(gif, gif->canvas);
+            }
     }
 }
 
+static void
+dirty_union(gd_GIF * gif, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    if(w == 0 || h == 0) return;
+    if(gif->dw == 0 || gif->dh == 0) {
+        gif->dx = x;
+        gif->dy = y;
+        gif->dw = w;
+        gif->dh = h;
+        return;
+    }
+    uint16_t x2 = MAX(gif->dx + gif->dw, x + w);
+    uint16_t y2 = MAX(gif->dy + gif->dh, y + h);
+    gif->dx = MIN(gif->dx, x);
+    gif->dy = MIN(gif->dy, y);
+    gif->dw = x2 - gif->dx;
+    gif->dh = y2 - gif->dy;
+}
+
 /* Return 1 if got a frame; 0 if got GIF trailer; -1 if error. */
 int
 gd_get_frame(gd_GIF * gif)
 {
     char sep;
 
+    /* Restoring to background touches the previous frame rectangle */
+    gif->dw = gif->dh = 0;
+    if(gif->gce.disposal == 2) {
+        dirty_union(gif, gif->fx, gif->fy, gif->fw, gif->fh);
+    }
     dispose(gif);
+    gif->frame_on_canvas = 0;
     f_gif_read(gif, &sep, 1);
     while(sep != ',') {
         if(sep == ';') {
@@ -746,6 +777,7 @@ gd_get_frame(gd_GIF * gif)
     }
     if(read_image(gif) == -1)
         return -1;
+    dirty_union(gif, gif->fx, gif->fy, gif->fw, gif->fh);
     return 1;
 }
 
@@ -753,6 +785,9 @@ void
 gd_render_frame(gd_GIF * gif, uint8_t * buffer)
 {
     render_frame_rect(gif, buffer);
+    if(buffer == gif->canvas) {
+        gif->frame_on_canvas = 1;
+    }
 }
 
 void
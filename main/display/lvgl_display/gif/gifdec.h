@@ -9,6 +9,12 @@ extern "C" {
 
 #include <stdint.h>
 
+/* Keep the LZW code table allocated together with the decoder instead of
+ * building a new table for every frame. */
+#ifndef GIFDEC_CACHE_LZW_TABLE
+#define GIFDEC_CACHE_LZW_TABLE 1
+#endif
+
 typedef struct _gd_Palette {
     int size;
     uint8_t colors[0x100 * 3];
@@ -44,9 +50,13 @@ typedef struct _gd_GIF {
     void (*comment)(struct _gd_GIF * gif);
     void (*application)(struct _gd_GIF * gif, char id[8], char auth[3]);
     uint16_t fx, fy, fw, fh;
+    /* Canvas area changed by the last gd_get_frame() + gd_render_frame() */
+    uint16_t dx, dy, dw, dh;
     uint8_t bgindex;
+    /* Set when the current frame has already been rendered into the canvas */
+    uint8_t frame_on_canvas;
     uint8_t * canvas, * frame;
-#if LV_GIF_CACHE_DECODE_DATA
+#if GIFDEC_CACHE_LZW_TABLE
     uint8_t *lzw_cache;
 #endif
 } gd_GIF;
@@ -0,0 +1,116 @@
+/**
+ * @file gifdec_generic.h
+ *
+ * Portable palette expansion for targets without Helium (Xtensa, RISC-V, host).
+ * The palette is expanded once per frame into a 32-bit lookup table so every
+ * pixel becomes a single table load and a single aligned 32-bit store, with the
+ * inner loop unrolled by four. Assumes a little-endian target, which holds for
+ * every ESP32 variant.
+ */
+
+#ifndef GIFDEC_GENERIC_H
+#define GIFDEC_GENERIC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************
+ *      INCLUDES
+ *********************/
+#include <stdint.h>
+
+/*********************
+ *      DEFINES
+ *********************/
+
+#define GIFDEC_FILL_BG(dst, w, h, stride, color, opa) \
+    _gifdec_fill_bg_generic(dst, w, h, stride, color, opa)
+
+#define GIFDEC_RENDER_FRAME(dst, w, h, stride, frame, pattern, tindex) \
+    _gifdec_render_frame_generic(dst, w, h, stride, frame, pattern, tindex)
+
+/**********************
+ * GLOBAL PROTOTYPES
+ **********************/
+
+/* Canvas pixels are stored as B, G, R, A bytes, i.e. 0xAARRGGBB in a little-endian word */
+static inline uint32_t _gifdec_make_argb(const uint8_t * rgb, uint8_t opa)
+{
+    return ((uint32_t)opa << 24) | ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+}
+
+static inline void _gifdec_fill_bg_generic(uint8_t * dst, uint16_t w, uint16_t h, uint16_t stride, uint8_t * color,
+                                           uint8_t opa)
+{
+    uint32_t c = _gifdec_make_argb(color, opa);
+
+    for(uint16_t y = 0; y < h; y++) {
+        uint32_t * row = (uint32_t *)dst;
+        uint16_t x = 0;
+        for(; x + 4 <= w; x += 4) {
+            row[x + 0] = c;
+            row[x + 1] = c;
+            row[x + 2] = c;
+            row[x + 3] = c;
+        }
+        for(; x < w; x++) {
+            row[x] = c;
+        }
+        dst += stride * 4;
+    }
+}
+
+static inline void _gifdec_render_frame_generic(uint8_t * dst, uint16_t w, uint16_t h, uint16_t stride,
+                                                uint8_t * frame, uint8_t * pattern, uint16_t tindex)
+{
+    uint32_t lut[0x100];
+
+    if(w == 0 || h == 0) {
+        return;
+    }
+
+    for(int i = 0; i < 0x100; i++) {
+        lut[i] = _gifdec_make_argb(&pattern[i * 3], 0xFF);
+    }
+
+    if(tindex > 0xFF) {
+        /* No transparency: straight table expansion */
+        for(uint16_t y = 0; y < h; y++) {
+            uint32_t * row = (uint32_t *)dst;
+            const uint8_t * src = frame;
+            uint16_t x = 0;
+            for(; x + 4 <= w; x += 4) {
+                row[x + 0] = lut[src[x + 0]];
+                row[x + 1] = lut[src[x + 1]];
+                row[x + 2] = lut[src[x + 2]];
+                row[x + 3] = lut[src[x + 3]];
+            }
+            for(; x < w; x++) {
+                row[x] = lut[src[x]];
+            }
+            dst += stride * 4;
+            frame += stride;
+        }
+        return;
+    }
+
+    for(uint16_t y = 0; y < h; y++) {
+        uint32_t * row = (uint32_t *)dst;
+        const uint8_t * src = frame;
+        for(uint16_t x = 0; x < w; x++) {
+            uint8_t index = src[x];
+            if(index != tindex) {
+                row[x] = lut[index];
+            }
+        }
+        dst += stride * 4;
+        frame += stride;
+    }
+}
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*GIFDEC_GENERIC_H*/
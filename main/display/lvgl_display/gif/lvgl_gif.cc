@@ -1,5 +1,6 @@
 #include "lvgl_gif.h"
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <cstring>
 
 #define TAG "LvglGif"
@@ -37,6 +38,27 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d", gif_->width, gif_->height);
 }
 
+LvglGif::LvglGif(std::shared_ptr<const LvglGifAtlas> atlas)
+    : gif_(nullptr), atlas_(std::move(atlas)), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
+    if (!atlas_ || atlas_->frame_count() == 0) {
+        ESP_LOGE(TAG, "Invalid GIF atlas");
+        return;
+    }
+
+    memset(&img_dsc_, 0, sizeof(img_dsc_));
+    img_dsc_.header.magic = LV_IMAGE_HEADER_MAGIC;
+    img_dsc_.header.cf = atlas_->color_format();
+    img_dsc_.header.w = atlas_->width();
+    img_dsc_.header.h = atlas_->height();
+    img_dsc_.header.stride = atlas_->width() * 2;
+    img_dsc_.data_size = atlas_->frame_size();
+    loop_count_ = atlas_->loop_count();
+    ShowAtlasFrame(0);
+
+    loaded_ = true;
+    ESP_LOGD(TAG, "GIF loaded from atlas: %dx%d, %u frames", atlas_->width(), atlas_->height(), atlas_->frame_count());
+}
+
 // Destructor
 LvglGif::~LvglGif() {
     Cleanup();
@@ -52,7 +74,7 @@ const lv_img_dsc_t* LvglGif::image_dsc() const {
 
 // Animation control methods
 void LvglGif::Start() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot start");
         return;
     }
@@ -86,7 +108,7 @@ void LvglGif::Pause() {
 }
 
 void LvglGif::Resume() {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot resume");
         return;
     }
@@ -104,7 +126,10 @@ void LvglGif::Stop() {
         lv_timer_pause(timer_);
     }
 
-    if (gif_) {
+    if (atlas_) {
+        loop_count_ = atlas_->loop_count();
+        ShowAtlasFrame(0);
+    } else if (gif_) {
         gd_rewind(gif_);
         NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
@@ -120,32 +145,63 @@ bool LvglGif::IsLoaded() const {
 }
 
 int32_t LvglGif::GetLoopCount() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return -1;
     }
-    return gif_->loop_count;
+    return atlas_ ? loop_count_ : gif_->loop_count;
 }
 
 void LvglGif::SetLoopCount(int32_t count) {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         ESP_LOGW(TAG, "GIF not loaded, cannot set loop count");
         return;
     }
-    gif_->loop_count = count;
+    if (atlas_) {
+        loop_count_ = count;
+    } else {
+        gif_->loop_count = count;
+    }
 }
 
 uint16_t LvglGif::width() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->width;
+    return img_dsc_.header.w;
 }
 
 uint16_t LvglGif::height() const {
-    if (!loaded_ || !gif_) {
+    if (!loaded_) {
         return 0;
     }
-    return gif_->height;
+    return img_dsc_.header.h;
+}
+
+void LvglGif::InvalidateDirtyArea(lv_obj_t* image_obj) {
+    if (!loaded_ || image_obj == nullptr) {
+        return;
+    }
+
+    // The canvas is modified in place, drop any cached decode of it
+    lv_image_cache_drop(&img_dsc_);
+
+    lv_area_t coords;
+    lv_obj_get_content_coords(image_obj, &coords);
+    bool unscaled = lv_image_get_scale(image_obj) == LV_SCALE_NONE && lv_image_get_rotation(image_obj) == 0;
+    if (!unscaled || lv_area_get_width(&coords) != width() || lv_area_get_height(&coords) != height()) {
+        lv_obj_invalidate(image_obj);
+        return;
+    }
+    if (dirty_w_ == 0 || dirty_h_ == 0) {
+        return;
+    }
+
+    lv_area_t dirty;
+    dirty.x1 = coords.x1 + dirty_x_;
+    dirty.y1 = coords.y1 + dirty_y_;
+    dirty.x2 = dirty.x1 + dirty_w_ - 1;
+    dirty.y2 = dirty.y1 + dirty_h_ - 1;
+    lv_obj_invalidate_area(image_obj, &dirty);
 }
 
 void LvglGif::SetFrameCallback(std::function<void()> callback) {
@@ -153,7 +209,11 @@ void LvglGif::SetFrameCallback(std::function<void()> callback) {
 }
 
 void LvglGif::NextFrame() {
-    if (!loaded_ || !gif_ || !playing_) {
+    if (!loaded_ || !playing_) {
+        return;
+    }
+    if (atlas_) {
+        NextAtlasFrame();
         return;
     }
 
@@ -164,6 +224,7 @@ void LvglGif::NextFrame() {
     }
 
     last_call_ = lv_tick_get();
+    int64_t start_time = esp_timer_get_time();
 
     // Get next frame
     int has_next = gd_get_frame(gif_);
@@ -179,6 +240,11 @@ void LvglGif::NextFrame() {
     // Render current frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
+        last_frame_time_us_ = esp_timer_get_time() - start_time;
+        dirty_x_ = gif_->dx;
+        dirty_y_ = gif_->dy;
+        dirty_w_ = gif_->dw;
+        dirty_h_ = gif_->dh;
         
         // Call frame callback if set
         if (frame_callback_) {
@@ -187,6 +253,48 @@ void LvglGif::NextFrame() {
     }
 }
 
+void LvglGif::NextAtlasFrame() {
+    uint32_t elapsed = lv_tick_elaps(last_call_);
+    if (elapsed < atlas_->frame(frame_index_).delay_ms) {
+        return;
+    }
+    last_call_ = lv_tick_get();
+    int64_t start_time = esp_timer_get_time();
+
+    // Same loop semantics as gd_get_frame(): stop at the trailer when the count reaches 1
+    size_t next = frame_index_ + 1;
+    if (next >= atlas_->frame_count()) {
+        if (loop_count_ == 1 || loop_count_ < 0) {
+            playing_ = false;
+            if (timer_) {
+                lv_timer_pause(timer_);
+            }
+            ESP_LOGD(TAG, "GIF animation completed");
+            return;
+        }
+        if (loop_count_ > 1) {
+            loop_count_--;
+        }
+        next = 0;
+    }
+
+    ShowAtlasFrame(next);
+    last_frame_time_us_ = esp_timer_get_time() - start_time;
+    if (frame_callback_) {
+        frame_callback_();
+    }
+}
+
+void LvglGif::ShowAtlasFrame(size_t index) {
+    const auto& frame = atlas_->frame(index);
+    frame_index_ = index;
+    img_dsc_.data = atlas_->frame_data(index);
+    dirty_x_ = frame.dx;
+    dirty_y_ = frame.dy;
+    dirty_w_ = frame.dw;
+    dirty_h_ = frame.dh;
+}
+
 void LvglGif::Cleanup() {
     // Stop and delete timer
     if (timer_) {
@@ -199,6 +307,7 @@ void LvglGif::Cleanup() {
         gd_close_gif(gif_);
         gif_ = nullptr;
     }
+    atlas_.reset();
 
     playing_ = false;
     loaded_ = false;
@@ -2,6 +2,7 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#include "lvgl_gif_atlas.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
@@ -13,6 +14,11 @@
 class LvglGif {
 public:
     explicit LvglGif(const lv_img_dsc_t* img_dsc);
+
+    /**
+     * Play frames that were decoded ahead of time instead of running the decoder
+     */
+    explicit LvglGif(std::shared_ptr<const LvglGifAtlas> atlas);
     virtual ~LvglGif();
 
     // LvglImage interface implementation
@@ -64,14 +70,28 @@ public:
     uint16_t width() const;
     uint16_t height() const;
 
+    /**
+     * Get decode + render time of the last frame in microseconds
+     */
+    uint32_t last_frame_time_us() const { return last_frame_time_us_; }
+
+    /**
+     * Redraw the part of an image widget showing this GIF that changed in the last frame.
+     * Falls back to redrawing the whole widget when the image is scaled or rotated.
+     */
+    void InvalidateDirtyArea(lv_obj_t* image_obj);
+
     /**
      * Set frame update callback
      */
     void SetFrameCallback(std::function<void()> callback);
 
 private:
-    // GIF decoder instance
+    // GIF decoder instance, or pre-rendered frames when atlas_ is set
     gd_GIF* gif_;
+    std::shared_ptr<const LvglGifAtlas> atlas_;
+    size_t frame_index_ = 0;
+    int32_t loop_count_ = -1;
     
     // LVGL image descriptor
     lv_img_dsc_t img_dsc_;
@@ -81,6 +101,12 @@ private:
     
     // Last frame update time
     uint32_t last_call_;
+
+    // Time spent decoding and rendering the last frame
+    uint32_t last_frame_time_us_ = 0;
+
+    // Area of the image changed by the last frame
+    uint16_t dirty_x_ = 0, dirty_y_ = 0, dirty_w_ = 0, dirty_h_ = 0;
     
     // Animation state
     bool playing_;
@@ -93,6 +119,8 @@ private:
      * Update to next frame
      */
     void NextFrame();
+    void NextAtlasFrame();
+    void ShowAtlasFrame(size_t index);
     
     /**
      * Cleanup resources
@@ -0,0 +1,138 @@
+#include "lvgl_gif_atlas.h"
+#include "gifdec.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+
+#define TAG "LvglGifAtlas"
+
+static bool HasTransparency(const uint8_t* canvas, size_t pixels) {
+    for (size_t i = 0; i < pixels; i++) {
+        if (canvas[i * 4 + 3] != 0xFF) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Canvas pixels are B, G, R, A bytes; RGB565A8 keeps the alpha plane after the color plane
+static void ConvertFrame(const uint8_t* canvas, uint8_t* dst, size_t pixels, bool with_alpha) {
+    uint16_t* rgb = reinterpret_cast<uint16_t*>(dst);
+    uint8_t* alpha = dst + pixels * 2;
+    for (size_t i = 0; i < pixels; i++) {
+        const uint8_t* p = &canvas[i * 4];
+        rgb[i] = ((p[2] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[0] >> 3);
+        if (with_alpha) {
+            alpha[i] = p[3];
+        }
+    }
+}
+
+std::unique_ptr<LvglGifAtlas> LvglGifAtlas::Create(const lv_img_dsc_t* gif_dsc, size_t max_bytes) {
+    if (gif_dsc == nullptr || gif_dsc->data == nullptr) {
+        return nullptr;
+    }
+
+    // First pass: count frames and check for transparency without keeping any output
+    gd_GIF* gif = gd_open_gif_data(gif_dsc->data);
+    if (gif == nullptr) {
+        return nullptr;
+    }
+    size_t pixels = gif->width * gif->height;
+    size_t frame_count = 0;
+    bool with_alpha = false;
+    int32_t loop_count = -1;
+    while (true) {
+        int ret = gd_get_frame(gif);
+        if (ret < 0) {
+            gd_close_gif(gif);
+            return nullptr;
+        }
+        if (ret == 0) {
+            break;
+        }
+        if (frame_count == 0) {
+            // The loop extension precedes the first image; stop at the first trailer from now on
+            loop_count = gif->loop_count;
+            gif->loop_count = 1;
+        }
+        gd_render_frame(gif, gif->canvas);
+        with_alpha = with_alpha || HasTransparency(gif->canvas, pixels);
+        frame_count++;
+        if (frame_count * pixels * 2 > max_bytes) {
+            gd_close_gif(gif);
+            return nullptr;
+        }
+    }
+    gd_close_gif(gif);
+
+    uint32_t frame_size = pixels * (with_alpha ? 3 : 2);
+    if (frame_count == 0 || frame_count * frame_size > max_bytes) {
+        return nullptr;
+    }
+
+    auto data = static_cast<uint8_t*>(heap_caps_malloc(frame_count * frame_size, MALLOC_CAP_SPIRAM));
+    if (data == nullptr) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes for GIF atlas", frame_count * frame_size);
+        return nullptr;
+    }
+
+    std::unique_ptr<LvglGifAtlas> atlas(new LvglGifAtlas());
+    atlas->data_ = data;
+    atlas->frame_size_ = frame_size;
+    atlas->color_format_ = with_alpha ? LV_COLOR_FORMAT_RGB565A8 : LV_COLOR_FORMAT_RGB565;
+    atlas->loop_count_ = loop_count;
+    atlas->frames_.reserve(frame_count);
+
+    // Second pass: decode again and convert every frame into the atlas
+    auto start_time = esp_timer_get_time();
+    gif = gd_open_gif_data(gif_dsc->data);
+    if (gif == nullptr) {
+        return nullptr;
+    }
+    atlas->width_ = gif->width;
+    atlas->height_ = gif->height;
+    while (atlas->frames_.size() < frame_count) {
+        int ret = gd_get_frame(gif);
+        if (ret <= 0) {
+            break;
+        }
+        if (atlas->frames_.empty()) {
+            gif->loop_count = 1;
+        }
+        gd_render_frame(gif, gif->canvas);
+
+        Frame frame;
+        frame.offset = atlas->frames_.size() * frame_size;
+        frame.delay_ms = gif->gce.delay * 10;
+        if (atlas->frames_.empty()) {
+            // Looping back to the first frame may change any pixel
+            frame.dx = frame.dy = 0;
+            frame.dw = gif->width;
+            frame.dh = gif->height;
+        } else {
+            frame.dx = gif->dx;
+            frame.dy = gif->dy;
+            frame.dw = gif->dw;
+            frame.dh = gif->dh;
+        }
+        ConvertFrame(gif->canvas, data + frame.offset, pixels, with_alpha);
+        atlas->frames_.push_back(frame);
+    }
+    gd_close_gif(gif);
+    atlas->decode_time_us_ = esp_timer_get_time() - start_time;
+
+    if (atlas->frames_.size() != frame_count) {
+        ESP_LOGW(TAG, "GIF frame count changed between passes (%u != %u)", atlas->frames_.size(), frame_count);
+        return nullptr;
+    }
+    return atlas;
+}
+
+LvglGifAtlas::~LvglGifAtlas() {
+    if (data_ != nullptr) {
+        heap_caps_free(data_);
+        data_ = nullptr;
+    }
+}
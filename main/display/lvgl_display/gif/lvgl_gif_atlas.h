@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../lvgl_image.h"
+#include <lvgl.h>
+#include <memory>
+#include <vector>
+
+/**
+ * All frames of a GIF decoded once into a contiguous PSRAM buffer.
+ * Frames are stored as RGB565, or RGB565A8 when the animation uses transparency,
+ * so playback only swaps a data pointer instead of running the LZW decoder.
+ */
+class LvglGifAtlas {
+public:
+    struct Frame {
+        uint32_t offset;
+        uint16_t delay_ms;
+        // Area changed compared to the previous frame
+        uint16_t dx, dy, dw, dh;
+    };
+
+    /**
+     * Decode a GIF into an atlas.
+     * Returns nullptr if the GIF cannot be decoded or the atlas would exceed max_bytes.
+     */
+    static std::unique_ptr<LvglGifAtlas> Create(const lv_img_dsc_t* gif_dsc, size_t max_bytes);
+
+    ~LvglGifAtlas();
+
+    inline uint16_t width() const { return width_; }
+    inline uint16_t height() const { return height_; }
+    inline lv_color_format_t color_format() const { return color_format_; }
+    inline uint32_t frame_size() const { return frame_size_; }
+    inline size_t frame_count() const { return frames_.size(); }
+    inline const Frame& frame(size_t index) const { return frames_[index]; }
+    inline const uint8_t* frame_data(size_t index) const { return data_ + frames_[index].offset; }
+    inline size_t bytes() const { return frame_size_ * frames_.size(); }
+    inline int32_t loop_count() const { return loop_count_; }
+    inline uint32_t decode_time_us() const { return decode_time_us_; }
+
+private:
+    LvglGifAtlas() = default;
+
+    uint8_t* data_ = nullptr;
+    uint16_t width_ = 0;
+    uint16_t height_ = 0;
+    lv_color_format_t color_format_ = LV_COLOR_FORMAT_RGB565;
+    uint32_t frame_size_ = 0;
+    int32_t loop_count_ = -1;
+    uint32_t decode_time_us_ = 0;
+    std::vector<Frame> frames_;
+};
+
+/**
+ * GIF image from the assets partition that also carries its pre-rendered frames
+ */
+class LvglPrerenderedGif : public LvglRawImage {
+public:
+    LvglPrerenderedGif(void* data, size_t size, std::shared_ptr<const LvglGifAtlas> atlas)
+        : LvglRawImage(data, size), atlas_(std::move(atlas)) {}
+
+    inline std::shared_ptr<const LvglGifAtlas> atlas() const { return atlas_; }
+
+private:
+    std::shared_ptr<const LvglGifAtlas> atlas_;
+};
@@ -2,6 +2,7 @@
 #include <esp_heap_caps.h>
 #include <esp_log.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "esp_jpeg_common.h"
@@ -32,6 +33,24 @@ static __always_inline uint8_t expand_6_to_8(uint8_t v) {
     return (uint8_t)((v << 2) | (v >> 4));
 }
 
+// RGB565 小端 -> RGB888
+static void rgb565_to_rgb888(const uint8_t* src, uint8_t* dst, int pixels) {
+    for (int i = 0; i < pixels; i++) {
+        uint8_t lo = src[0];  // 低字节（LSB）
+        uint8_t hi = src[1];  // 高字节（MSB）
+        src += 2;
+
+        uint8_t r5 = (hi >> 3) & 0x1F;
+        uint8_t g6 = ((hi & 0x07) << 3) | ((lo & 0xE0) >> 5);
+        uint8_t b5 = lo & 0x1F;
+
+        dst[0] = expand_5_to_8(r5);
+        dst[1] = expand_6_to_8(g6);
+        dst[2] = expand_5_to_8(b5);
+        dst += 3;
+    }
+}
+
 static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
                                              jpeg_pixel_format_t* out_fmt, int* out_size) {
     // 直接支持的格式：GRAY、RGB888、YCbYCr(YUYV)
@@ -130,23 +149,7 @@ static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width,
         memcpy(rgb, src, rgb_size);
     } else if (format == V4L2_PIX_FMT_RGB565) {
         // RGB565 小端，需要转换为 RGB888
-        const uint8_t* p = src;
-        uint8_t* d = rgb;
-        int pixels = (int)width * (int)height;
-        for (int i = 0; i < pixels; i++) {
-            uint8_t lo = p[0];  // 低字节（LSB）
-            uint8_t hi = p[1];  // 高字节（MSB）
-            p += 2;
-
-            uint8_t r5 = (hi >> 3) & 0x1F;
-            uint8_t g6 = ((hi & 0x07) << 3) | ((lo & 0xE0) >> 5);
-            uint8_t b5 = lo & 0x1F;
-
-            d[0] = expand_5_to_8(r5);
-            d[1] = expand_6_to_8(g6);
-            d[2] = expand_5_to_8(b5);
-            d += 3;
-        }
+        rgb565_to_rgb888(src, rgb, (int)width * (int)height);
     } else {
         // 其他未覆盖格式，清零
         memset(rgb, 0, rgb_size);
@@ -412,3 +415,127 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #endif
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
+
+struct jpeg_stream_encoder {
+    jpeg_enc_handle_t handle;
+    uint16_t width;
+    uint16_t height;
+    uint16_t lines;       // 每个编码块的行数（一个 MCU 行）
+    uint16_t next_line;
+    int block_size;
+    uint8_t* block;       // RGB888 编码块
+    uint8_t* out;
+    int out_cap;
+    size_t out_index;
+    jpg_out_cb cb;
+    void* arg;
+};
+
+jpeg_stream_encoder_t* jpeg_stream_encoder_open(uint16_t width, uint16_t height, uint8_t quality, jpg_out_cb cb,
+                                                void* arg) {
+    if (width == 0 || height == 0 || cb == NULL) {
+        return NULL;
+    }
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = JPEG_PIXEL_FORMAT_RGB888;
+    cfg.subsampling = JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_stream_encoder_t* enc = (jpeg_stream_encoder_t*)calloc(1, sizeof(jpeg_stream_encoder_t));
+    if (!enc) {
+        return NULL;
+    }
+    enc->width = width;
+    enc->height = height;
+    enc->cb = cb;
+    enc->arg = arg;
+
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &enc->handle);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        free(enc);
+        return NULL;
+    }
+
+    enc->block_size = jpeg_enc_get_block_size(enc->handle);
+    enc->lines = enc->block_size > 0 ? enc->block_size / ((int)width * 3) : 0;
+    if (enc->lines == 0) {
+        ESP_LOGE(TAG, "Invalid block size: %d", enc->block_size);
+        jpeg_stream_encoder_close(enc);
+        return NULL;
+    }
+
+    // 一个块的压缩数据不会超过其 RGB888 原始大小，额外的空间留给文件头
+    enc->out_cap = enc->block_size + 1024;
+    enc->block = (uint8_t*)jpeg_calloc_align(enc->block_size, 16);
+    enc->out = (uint8_t*)malloc_psram(enc->out_cap);
+    if (!enc->block || !enc->out) {
+        ESP_LOGE(TAG, "alloc stream buffers failed");
+        jpeg_stream_encoder_close(enc);
+        return NULL;
+    }
+    return enc;
+}
+
+uint16_t jpeg_stream_encoder_lines(const jpeg_stream_encoder_t* enc) {
+    return enc->lines;
+}
+
+bool jpeg_stream_encoder_write_rgb565(jpeg_stream_encoder_t* enc, const uint8_t* src, uint16_t lines, size_t stride) {
+    if (lines == 0 || lines > enc->lines || enc->next_line + lines > enc->height) {
+        ESP_LOGE(TAG, "Invalid stripe: %u lines at %u", lines, enc->next_line);
+        return false;
+    }
+
+    size_t row_size = (size_t)enc->width * 3;
+    for (uint16_t y = 0; y < lines; y++) {
+        rgb565_to_rgb888(src + y * stride, enc->block + y * row_size, enc->width);
+    }
+    // 最后一个条带不足一个块时，重复最后一行补齐
+    for (uint16_t y = lines; y < enc->lines; y++) {
+        memcpy(enc->block + y * row_size, enc->block + (lines - 1) * row_size, row_size);
+    }
+
+    int out_len = 0;
+    jpeg_error_t ret = jpeg_enc_process_with_block(enc->handle, enc->block, enc->block_size, enc->out, enc->out_cap,
+                                                   &out_len);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+        return false;
+    }
+    if (out_len > 0) {
+        if (enc->cb(enc->arg, enc->out_index, enc->out, (size_t)out_len) != (size_t)out_len) {
+            return false;
+        }
+        enc->out_index += out_len;
+    }
+
+    enc->next_line += lines;
+    if (enc->next_line == enc->height) {
+        enc->cb(enc->arg, enc->out_index, NULL, 0);  // 结束信号
+    }
+    return true;
+}
+
+void jpeg_stream_encoder_close(jpeg_stream_encoder_t* enc) {
+    if (!enc) {
+        return;
+    }
+    if (enc->handle) {
+        jpeg_enc_close(enc->handle);
+    }
+    if (enc->block) {
+        jpeg_free_align(enc->block);
+    }
+    free(enc->out);
+    free(enc);
+}
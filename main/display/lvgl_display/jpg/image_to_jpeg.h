@@ -63,6 +63,51 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
 bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, 
                       v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+/**
+ * @brief 条带式流式 JPEG 编码器
+ *
+ * 按 MCU 行逐条输入 RGB565 图像并立即输出 JPEG 数据，内存占用只与图像宽度有关：
+ * - 无需整幅图像的源缓冲区和输出缓冲区
+ * - 每次写入 jpeg_stream_encoder_lines() 行（最后一个条带可以更少）
+ * - 每个块编码完成后通过回调输出，全部行写入后回调一次 (NULL, 0) 作为结束信号
+ */
+typedef struct jpeg_stream_encoder jpeg_stream_encoder_t;
+
+/**
+ * @brief 创建流式编码器
+ *
+ * @param width     图像宽度
+ * @param height    图像高度
+ * @param quality   JPEG质量 (1-100)
+ * @param cb        输出回调函数，返回值小于 len 时编码中止
+ * @param arg       传递给回调函数的用户参数
+ *
+ * @return 编码器句柄，失败返回 NULL
+ */
+jpeg_stream_encoder_t* jpeg_stream_encoder_open(uint16_t width, uint16_t height, uint8_t quality,
+                                                jpg_out_cb cb, void *arg);
+
+/**
+ * @brief 每次写入的条带行数
+ */
+uint16_t jpeg_stream_encoder_lines(const jpeg_stream_encoder_t* enc);
+
+/**
+ * @brief 编码一个 RGB565（小端）条带
+ *
+ * @param src       条带数据
+ * @param lines     条带行数，除最后一个条带外必须等于 jpeg_stream_encoder_lines()
+ * @param stride    每行字节数
+ *
+ * @return true 成功, false 失败
+ */
+bool jpeg_stream_encoder_write_rgb565(jpeg_stream_encoder_t* enc, const uint8_t *src, uint16_t lines, size_t stride);
+
+/**
+ * @brief 释放流式编码器
+ */
+void jpeg_stream_encoder_close(jpeg_stream_encoder_t* enc);
+
 #ifdef __cplusplus
 }
 #endif
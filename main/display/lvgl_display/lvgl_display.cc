@@ -3,6 +3,7 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <font_awesome.h>
 
 #include "lvgl_display.h"
@@ -69,6 +70,11 @@ LvglDisplay::~LvglDisplay() {
     }
 }
 
+void LvglDisplay::InitializePerfMonitor() {
+    DisplayLockGuard lock(this);
+    perf_.Attach(display_);
+}
+
 void LvglDisplay::SetStatus(const char* status) {
     DisplayLockGuard lock(this);
     if (status_label_ == nullptr) {
@@ -216,40 +222,131 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
 }
 
 bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
+    jpeg_data.clear();
+    return SnapshotToJpeg([&jpeg_data](const char* data, size_t len) {
+        jpeg_data.append(data, len);
+        return true;
+    }, quality);
+}
+
 #if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
+// RenderArea() sets up the layer the way lv_snapshot_take_to_draw_buf() does, which needs
+// LVGL internals. It is only built for the LVGL release it was checked against, other
+// versions encode one full-screen snapshot instead.
+#if LVGL_VERSION_MAJOR == 9 && LVGL_VERSION_MINOR == 3
+#define SNAPSHOT_RENDER_STRIPES 1
+#include <lvgl_private.h>
 
-    lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
-    if (draw_buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
-        return false;
-    }
+// Same as lv_snapshot_take_to_draw_buf(), but only renders the part of the object inside area
+static void RenderArea(lv_obj_t* obj, lv_draw_buf_t* draw_buf, const lv_area_t& area) {
+    lv_layer_t layer;
+    lv_layer_init(&layer);
+    layer.draw_buf = draw_buf;
+    layer.buf_area = area;
+    layer.color_format = draw_buf->header.cf;
+    layer._clip_area = area;
+    layer.phy_clip_area = area;
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
+    lv_display_t* disp_old = lv_refr_get_disp_refreshing();
+    lv_display_t* disp = lv_obj_get_display(obj);
+    lv_layer_t* layer_old = disp->layer_head;
+    disp->layer_head = &layer;
+    lv_refr_set_disp_refreshing(disp);
+
+    lv_obj_redraw(&layer, obj);
+    while (layer.draw_task_head) {
+        lv_draw_dispatch_wait_for_request();
+        lv_draw_dispatch();
     }
 
-    // 清空输出字符串并使用回调版本，避免预分配大内存块
-    jpeg_data.clear();
+    disp->layer_head = layer_old;
+    lv_refr_set_disp_refreshing(disp_old);
+}
+#endif
+#endif
 
-    // 🚀 使用回调版本的JPEG编码器，进一步节省内存
-    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
+// The display is only locked while LVGL renders, on_data may block on the network
+bool LvglDisplay::SnapshotToJpeg(std::function<bool(const char* data, size_t len)> on_data, int quality) {
+#if CONFIG_LV_USE_SNAPSHOT
+    lv_area_t coords;
+    {
+        DisplayLockGuard lock(this);
+        lv_obj_t* screen = lv_screen_active();
+        lv_obj_update_layout(screen);
+        lv_obj_get_coords(screen, &coords);
+    }
+    int32_t width = lv_area_get_width(&coords);
+    int32_t height = lv_area_get_height(&coords);
+
+    // 按 MCU 行渲染并编码，只需要几个条带大小的缓冲区，而不是整屏的 RGB565 快照
+    auto encoder = jpeg_stream_encoder_open(width, height, quality,
         [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
-        if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
+        auto on_data = static_cast<std::function<bool(const char*, size_t)>*>(arg);
+        if (data && len > 0 && !(*on_data)(static_cast<const char*>(data), len)) {
+            return 0;
         }
         return len;
-    }, &jpeg_data);
+    }, &on_data);
+    if (encoder == nullptr) {
+        ESP_LOGE(TAG, "Failed to create JPEG encoder");
+        return false;
+    }
+
+    int32_t lines = jpeg_stream_encoder_lines(encoder);
+    bool ret = true;
+#if SNAPSHOT_RENDER_STRIPES
+    lv_draw_buf_t* stripe;
+    {
+        DisplayLockGuard lock(this);
+        stripe = lv_draw_buf_create(width, lines, LV_COLOR_FORMAT_RGB565, LV_STRIDE_AUTO);
+    }
+    if (stripe == nullptr) {
+        ESP_LOGE(TAG, "Failed to create snapshot stripe %ldx%ld", width, lines);
+        jpeg_stream_encoder_close(encoder);
+        return false;
+    }
+
+    for (int32_t y = 0; y < height && ret; y += lines) {
+        lv_area_t area = coords;
+        area.y1 = coords.y1 + y;
+        area.y2 = std::min(area.y1 + lines - 1, coords.y2);
+        {
+            DisplayLockGuard lock(this);
+            lv_draw_buf_clear(stripe, nullptr);
+            RenderArea(lv_screen_active(), stripe, area);
+        }
+        ret = jpeg_stream_encoder_write_rgb565(encoder, stripe->data, lv_area_get_height(&area), stripe->header.stride);
+    }
+#else
+    lv_draw_buf_t* snapshot;
+    {
+        DisplayLockGuard lock(this);
+        snapshot = lv_snapshot_take(lv_screen_active(), LV_COLOR_FORMAT_RGB565);
+    }
+    if (snapshot == nullptr) {
+        ESP_LOGE(TAG, "Failed to take snapshot");
+        jpeg_stream_encoder_close(encoder);
+        return false;
+    }
+
+    for (int32_t y = 0; y < height && ret; y += lines) {
+        int32_t n = std::min(lines, height - y);
+        ret = jpeg_stream_encoder_write_rgb565(encoder, snapshot->data + y * snapshot->header.stride, n, snapshot->header.stride);
+    }
+#endif
     if (!ret) {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
     }
 
-    lv_draw_buf_destroy(draw_buffer);
+    {
+        DisplayLockGuard lock(this);
+#if SNAPSHOT_RENDER_STRIPES
+        lv_draw_buf_destroy(stripe);
+#else
+        lv_draw_buf_destroy(snapshot);
+#endif
+    }
+    jpeg_stream_encoder_close(encoder);
     return ret;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
@@ -3,6 +3,7 @@
 
 #include "display.h"
 #include "lvgl_image.h"
+#include "lvgl_perf.h"
 
 #include <lvgl.h>
 #include <esp_timer.h>
@@ -11,6 +12,7 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
 
 class LvglDisplay : public Display {
 public:
@@ -24,6 +26,10 @@ public:
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Render and encode the screen stripe by stripe, on_data returns false to abort
+    virtual bool SnapshotToJpeg(std::function<bool(const char* data, size_t len)> on_data, int quality = 80);
+
+    inline LvglPerfMonitor& perf() { return perf_; }
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
@@ -43,10 +49,14 @@ protected:
 
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
+    LvglPerfMonitor perf_;
+
+    void InitializePerfMonitor();
 
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
+    virtual void OnLockWait(uint32_t wait_us) override { perf_.RecordLockWait(wait_us); }
 };
 
 
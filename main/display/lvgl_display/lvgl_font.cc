@@ -1,13 +1,136 @@
 #include "lvgl_font.h"
 #include <cbin_font.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <cstring>
+#include <iterator>
+
+#define TAG "LvglFont"
 
 
 LvglCBinFont::LvglCBinFont(void* data) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+    if (font_ != nullptr && font_->get_glyph_bitmap != nullptr && LvglGlyphCache::GetInstance().capacity() > 0) {
+        cached_font_.font = *font_;
+        cached_font_.font.get_glyph_bitmap = GetCachedGlyphBitmap;
+        cached_font_.source = font_;
+        cache_enabled_ = true;
+    }
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    if (cache_enabled_) {
+        LvglGlyphCache::GetInstance().Purge(&cached_font_.font);
+    }
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+const lv_font_t* LvglCBinFont::font() const {
+    return cache_enabled_ ? &cached_font_.font : font_;
+}
+
+const void* LvglCBinFont::GetCachedGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    auto font = g_dsc->resolved_font;
+    auto cached_font = reinterpret_cast<const CachedFont*>(font);
+    auto& cache = LvglGlyphCache::GetInstance();
+    if (draw_buf != nullptr && cache.Load(font, g_dsc, draw_buf)) {
+        return draw_buf;
+    }
+
+    const void* bitmap = cached_font->source->get_glyph_bitmap(g_dsc, draw_buf);
+    // Only glyphs rendered into the draw buffer are cached, pointers into font data are cheap already
+    if (bitmap != nullptr && bitmap == draw_buf) {
+        cache.Store(font, g_dsc, draw_buf);
+    }
+    return bitmap;
+}
+
+static inline uint64_t GlyphKey(const lv_font_t* font, uint32_t index) {
+    return (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(font)) << 32) | index;
+}
+
+LvglGlyphCache::LvglGlyphCache() : capacity_(CONFIG_TEXT_GLYPH_CACHE_SIZE_KB * 1024) {
+}
+
+bool LvglGlyphCache::Load(const lv_font_t* font, const lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = index_.find(GlyphKey(font, g_dsc->gid.index));
+    if (found == index_.end()) {
+        misses_++;
+        return false;
+    }
+    auto it = found->second;
+    // The caller prepares draw_buf for the glyph box, a different layout means the glyph changed
+    if (it->stride != draw_buf->header.stride || it->height != g_dsc->box_h || it->size > draw_buf->data_size) {
+        Evict(it);
+        misses_++;
+        return false;
+    }
+    memcpy(draw_buf->data, it->data, it->size);
+    lru_.splice(lru_.begin(), lru_, it);
+    hits_++;
+    return true;
+}
+
+void LvglGlyphCache::Store(const lv_font_t* font, const lv_font_glyph_dsc_t* g_dsc, const lv_draw_buf_t* draw_buf) {
+    size_t size = draw_buf->header.stride * g_dsc->box_h;
+    if (size == 0 || size > draw_buf->data_size || size > capacity_ / 8) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t key = GlyphKey(font, g_dsc->gid.index);
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        Evict(found->second);
+    }
+    while (!lru_.empty() && bytes_ + size > capacity_) {
+        Evict(std::prev(lru_.end()));
+        evictions_++;
+    }
+
+    auto data = static_cast<uint8_t*>(heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    if (data == nullptr) {
+        data = static_cast<uint8_t*>(heap_caps_malloc(size, MALLOC_CAP_8BIT));
+        if (data == nullptr) {
+            return;
+        }
+    }
+    memcpy(data, draw_buf->data, size);
+    lru_.push_front({key, draw_buf->header.stride, static_cast<uint16_t>(g_dsc->box_h), data, size});
+    index_[key] = lru_.begin();
+    bytes_ += size;
+}
+
+void LvglGlyphCache::Purge(const lv_font_t* font) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t prefix = GlyphKey(font, 0);
+    for (auto it = lru_.begin(); it != lru_.end();) {
+        auto next = std::next(it);
+        if ((it->key & 0xFFFFFFFF00000000ULL) == prefix) {
+            Evict(it);
+        }
+        it = next;
+    }
+}
+
+void LvglGlyphCache::Evict(std::list<Entry>::iterator it) {
+    bytes_ -= it->size;
+    heap_caps_free(it->data);
+    index_.erase(it->key);
+    lru_.erase(it);
+}
+
+cJSON* LvglGlyphCache::ToJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "capacity", capacity_);
+    cJSON_AddNumberToObject(json, "bytes", bytes_);
+    cJSON_AddNumberToObject(json, "glyphs", lru_.size());
+    cJSON_AddNumberToObject(json, "hits", hits_);
+    cJSON_AddNumberToObject(json, "misses", misses_);
+    cJSON_AddNumberToObject(json, "evictions", evictions_);
+    return json;
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <lvgl.h>
+#include <cJSON.h>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 
 class LvglFont {
@@ -24,8 +29,61 @@ class LvglCBinFont : public LvglFont {
 public:
     LvglCBinFont(void* data);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override;
 
 private:
+    // Copy of font_ whose get_glyph_bitmap goes through LvglGlyphCache
+    struct CachedFont {
+        lv_font_t font;     // Must stay the first member, the callback casts resolved_font back
+        const lv_font_t* source;
+    };
+
     lv_font_t* font_;
+    CachedFont cached_font_;
+    bool cache_enabled_ = false;
+
+    static const void* GetCachedGlyphBitmap(lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+};
+
+/**
+ * LRU cache of rasterized glyph bitmaps keyed by (font, glyph index).
+ * A font object already fixes the size, so the pair identifies one bitmap.
+ */
+class LvglGlyphCache {
+public:
+    static LvglGlyphCache& GetInstance() {
+        static LvglGlyphCache instance;
+        return instance;
+    }
+
+    // Copy a cached bitmap into draw_buf, returns false on a miss
+    bool Load(const lv_font_t* font, const lv_font_glyph_dsc_t* g_dsc, lv_draw_buf_t* draw_buf);
+    void Store(const lv_font_t* font, const lv_font_glyph_dsc_t* g_dsc, const lv_draw_buf_t* draw_buf);
+    // Drop every glyph of a font that is about to be deleted
+    void Purge(const lv_font_t* font);
+    cJSON* ToJson();
+
+    inline size_t capacity() const { return capacity_; }
+
+private:
+    LvglGlyphCache();
+
+    struct Entry {
+        uint64_t key;
+        uint32_t stride;
+        uint16_t height;
+        uint8_t* data;
+        size_t size;
+    };
+
+    void Evict(std::list<Entry>::iterator it);
+
+    std::mutex mutex_;
+    std::list<Entry> lru_;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index_;
+    size_t capacity_;
+    size_t bytes_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
 };
@@ -0,0 +1,192 @@
+#include "lvgl_perf.h"
+
+#include <esp_timer.h>
+#include <esp_log.h>
+
+#define TAG "LvglPerf"
+
+static int BucketIndex(uint32_t value) {
+    int index = 0;
+    uint32_t bound = PerfHistogram::kBucketBase;
+    while (index < PerfHistogram::kBucketCount - 1 && value >= bound) {
+        bound <<= 1;
+        index++;
+    }
+    return index;
+}
+
+void PerfHistogram::Record(uint32_t value) {
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    uint32_t prev = max_.load(std::memory_order_relaxed);
+    while (value > prev && !max_.compare_exchange_weak(prev, value, std::memory_order_relaxed)) {
+    }
+}
+
+void PerfHistogram::Reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+}
+
+uint32_t PerfHistogram::Percentile(int percent) const {
+    uint32_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    uint32_t target = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            // The open-ended bucket reports the observed maximum instead of a bound
+            return i == kBucketCount - 1 ? max_.load(std::memory_order_relaxed) : (kBucketBase << i);
+        }
+    }
+    return max_.load(std::memory_order_relaxed);
+}
+
+cJSON* PerfHistogram::ToJson() const {
+    uint32_t total = count();
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "count", total);
+    cJSON_AddNumberToObject(json, "avg", total > 0 ? (double)sum_.load(std::memory_order_relaxed) / total : 0);
+    cJSON_AddNumberToObject(json, "max", max_.load(std::memory_order_relaxed));
+    cJSON_AddNumberToObject(json, "p50", Percentile(50));
+    cJSON_AddNumberToObject(json, "p90", Percentile(90));
+    cJSON_AddNumberToObject(json, "p99", Percentile(99));
+    cJSON* buckets = cJSON_AddArrayToObject(json, "buckets");
+    for (int i = 0; i < kBucketCount; i++) {
+        cJSON_AddItemToArray(buckets, cJSON_CreateNumber(buckets_[i].load(std::memory_order_relaxed)));
+    }
+    return json;
+}
+
+void LvglPerfMonitor::Attach(lv_display_t* display) {
+    if (display == nullptr || display == display_) {
+        return;
+    }
+    display_ = display;
+    lv_display_add_event_cb(display, OnDisplayEvent, LV_EVENT_ALL, this);
+    ESP_LOGI(TAG, "Performance monitor attached, frame budget %d ms", LV_DEF_REFR_PERIOD);
+}
+
+void LvglPerfMonitor::OnDisplayEvent(lv_event_t* e) {
+    auto monitor = static_cast<LvglPerfMonitor*>(lv_event_get_user_data(e));
+    monitor->HandleDisplayEvent(lv_event_get_code(e), lv_event_get_param(e));
+}
+
+void LvglPerfMonitor::HandleDisplayEvent(lv_event_code_t code, void* param) {
+    int64_t now = esp_timer_get_time();
+    switch (code) {
+    case LV_EVENT_INVALIDATE_AREA:
+        if (param != nullptr) {
+            pending_area_ += lv_area_get_size(static_cast<const lv_area_t*>(param));
+        }
+        break;
+    case LV_EVENT_REFR_START:
+        refr_start_us_ = now;
+        rendering_ = false;
+        break;
+    case LV_EVENT_RENDER_START:
+        render_start_us_ = now;
+        frame_flush_us_ = 0;
+        frame_area_ = pending_area_;
+        pending_area_ = 0;
+        rendering_ = true;
+        break;
+    case LV_EVENT_FLUSH_START:
+        flush_start_us_ = now;
+        break;
+    case LV_EVENT_FLUSH_FINISH:
+        frame_flush_us_ += now - flush_start_us_;
+        break;
+    case LV_EVENT_FLUSH_WAIT_START:
+        flush_wait_start_us_ = now;
+        break;
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        frame_flush_us_ += now - flush_wait_start_us_;
+        break;
+    case LV_EVENT_RENDER_READY:
+        if (rendering_) {
+            uint32_t total = now - render_start_us_;
+            render_time_.Record(total > frame_flush_us_ ? total - frame_flush_us_ : 0);
+            flush_time_.Record(frame_flush_us_);
+            invalidated_area_.Record(frame_area_);
+        }
+        break;
+    case LV_EVENT_REFR_READY:
+        // Refresh cycles without invalidated areas are not frames
+        if (rendering_) {
+            uint32_t frame_us = now - refr_start_us_;
+            frame_time_.Record(frame_us);
+            uint32_t budget_us = LV_DEF_REFR_PERIOD * 1000;
+            if (frame_us > budget_us) {
+                frames_dropped_.fetch_add(frame_us / budget_us, std::memory_order_relaxed);
+            }
+            rendering_ = false;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void LvglPerfMonitor::RecordLockWait(uint32_t wait_us) {
+    lock_wait_.Record(wait_us);
+}
+
+void LvglPerfMonitor::RecordSection(Section section, uint32_t duration_us) {
+    if (section < 0 || section >= kSectionCount) {
+        return;
+    }
+    sections_[section].Record(duration_us);
+}
+
+void LvglPerfMonitor::Reset() {
+    frame_time_.Reset();
+    render_time_.Reset();
+    flush_time_.Reset();
+    invalidated_area_.Reset();
+    lock_wait_.Reset();
+    for (auto& section : sections_) {
+        section.Reset();
+    }
+    frames_dropped_.store(0, std::memory_order_relaxed);
+}
+
+cJSON* LvglPerfMonitor::ToJson() const {
+    static const char* const section_names[kSectionCount] = {
+        "gif_frame_us",
+        "spectrum_us",
+        "chat_message_us",
+    };
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "frame_budget_ms", LV_DEF_REFR_PERIOD);
+    cJSON_AddNumberToObject(json, "bucket_base", PerfHistogram::kBucketBase);
+    cJSON_AddNumberToObject(json, "frames", frame_time_.count());
+    cJSON_AddNumberToObject(json, "frames_dropped", frames_dropped_.load(std::memory_order_relaxed));
+    cJSON_AddItemToObject(json, "frame_us", frame_time_.ToJson());
+    cJSON_AddItemToObject(json, "render_us", render_time_.ToJson());
+    cJSON_AddItemToObject(json, "flush_us", flush_time_.ToJson());
+    cJSON_AddItemToObject(json, "invalidated_px", invalidated_area_.ToJson());
+    cJSON_AddItemToObject(json, "lock_wait_us", lock_wait_.ToJson());
+    cJSON* sections = cJSON_AddObjectToObject(json, "sections");
+    for (int i = 0; i < kSectionCount; i++) {
+        cJSON_AddItemToObject(sections, section_names[i], sections_[i].ToJson());
+    }
+    return json;
+}
+
+PerfScope::PerfScope(LvglPerfMonitor& monitor, LvglPerfMonitor::Section section)
+    : monitor_(monitor), section_(section), start_us_(esp_timer_get_time()) {
+}
+
+PerfScope::~PerfScope() {
+    monitor_.RecordSection(section_, esp_timer_get_time() - start_us_);
+}
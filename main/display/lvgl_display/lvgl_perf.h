@@ -0,0 +1,87 @@
+#pragma once
+
+#include <lvgl.h>
+#include <cJSON.h>
+
+#include <atomic>
+#include <cstdint>
+
+
+// Fixed-size log2 histogram, safe to record from any task.
+// Bucket i counts values below (kBucketBase << i); the last bucket is open-ended.
+class PerfHistogram {
+public:
+    static constexpr int kBucketCount = 16;
+    static constexpr uint32_t kBucketBase = 128;
+
+    void Record(uint32_t value);
+    void Reset();
+    uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+
+    // Returns an object with count, avg, max, p50/p90/p99 (bucket upper bounds) and raw buckets
+    cJSON* ToJson() const;
+
+private:
+    std::atomic<uint32_t> buckets_[kBucketCount] = {};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> max_{0};
+    std::atomic<uint64_t> sum_{0};
+
+    uint32_t Percentile(int percent) const;
+};
+
+
+// Collects LVGL render/flush timings through display events, plus display lock
+// waits and named UI sections, so UI stalls can be attributed to a component.
+class LvglPerfMonitor {
+public:
+    enum Section {
+        kSectionGifFrame = 0,
+        kSectionSpectrum,
+        kSectionChatMessage,
+        kSectionCount,
+    };
+
+    // Attaching the same display again is a no-op
+    void Attach(lv_display_t* display);
+    void RecordLockWait(uint32_t wait_us);
+    void RecordSection(Section section, uint32_t duration_us);
+    void Reset();
+    cJSON* ToJson() const;
+
+private:
+    static void OnDisplayEvent(lv_event_t* e);
+    void HandleDisplayEvent(lv_event_code_t code, void* param);
+
+    lv_display_t* display_ = nullptr;
+    // Only touched from LVGL event callbacks, which run under the LVGL lock
+    int64_t refr_start_us_ = 0;
+    int64_t render_start_us_ = 0;
+    int64_t flush_start_us_ = 0;
+    int64_t flush_wait_start_us_ = 0;
+    uint32_t frame_flush_us_ = 0;
+    uint32_t pending_area_ = 0;
+    uint32_t frame_area_ = 0;
+    bool rendering_ = false;
+
+    PerfHistogram frame_time_;
+    PerfHistogram render_time_;
+    PerfHistogram flush_time_;
+    PerfHistogram invalidated_area_;
+    PerfHistogram lock_wait_;
+    PerfHistogram sections_[kSectionCount];
+    std::atomic<uint32_t> frames_dropped_{0};
+};
+
+
+// Records the lifetime of the scope into a monitor section
+class PerfScope {
+public:
+    PerfScope(LvglPerfMonitor& monitor, LvglPerfMonitor::Section section);
+    ~PerfScope();
+
+private:
+    LvglPerfMonitor& monitor_;
+    LvglPerfMonitor::Section section_;
+    int64_t start_us_;
+};
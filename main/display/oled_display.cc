@@ -171,8 +171,9 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
         ESP_LOGE(TAG, "Failed to allocate frame_audio_data");
     }
     ESP_LOGI(TAG,"Initialize fft_input, audio_data_, frame_audio_data, spectrum_data");
-    
 
+
+    InitializePerfMonitor();
     if (height_ == 64) {
         SetupUI_128x64();
     } else {
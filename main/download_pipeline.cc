@@ -0,0 +1,142 @@
+#include "download_pipeline.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+
+#define TAG "DownloadPipeline"
+
+#define WRITER_DONE_EVENT (1 << 0)
+
+DownloadPipeline::DownloadPipeline() {
+    // Large blocks in PSRAM when available, otherwise one flash sector per block
+    block_size_ = DOWNLOAD_PIPELINE_PSRAM_BLOCK_SIZE;
+    uint32_t caps = MALLOC_CAP_SPIRAM;
+    if (heap_caps_get_free_size(MALLOC_CAP_SPIRAM) < DOWNLOAD_PIPELINE_PSRAM_BLOCK_SIZE * DOWNLOAD_PIPELINE_BLOCK_COUNT * 2) {
+        block_size_ = DOWNLOAD_PIPELINE_SRAM_BLOCK_SIZE;
+        caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    }
+
+    free_queue_ = xQueueCreate(DOWNLOAD_PIPELINE_BLOCK_COUNT, sizeof(Block*));
+    full_queue_ = xQueueCreate(DOWNLOAD_PIPELINE_BLOCK_COUNT + 1, sizeof(Block*));
+    event_group_ = xEventGroupCreate();
+    for (auto& block : blocks_) {
+        block.data = (uint8_t*)heap_caps_malloc(block_size_, caps);
+        if (block.data != nullptr) {
+            Block* ptr = &block;
+            xQueueSend(free_queue_, &ptr, 0);
+        }
+    }
+}
+
+DownloadPipeline::~DownloadPipeline() {
+    for (auto& block : blocks_) {
+        heap_caps_free(block.data);
+    }
+    vQueueDelete(free_queue_);
+    vQueueDelete(full_queue_);
+    vEventGroupDelete(event_group_);
+}
+
+void DownloadPipeline::WriterTask() {
+    while (true) {
+        Block* block;
+        xQueueReceive(full_queue_, &block, portMAX_DELAY);
+        // A null block marks the end of the body
+        if (block == nullptr) {
+            break;
+        }
+        if (!failed_ && !sink_(block->data, block->size, block->offset)) {
+            failed_ = true;
+        }
+        if (!failed_) {
+            total_written_ += block->size;
+        }
+        xQueueSend(free_queue_, &block, portMAX_DELAY);
+    }
+    xEventGroupSetBits(event_group_, WRITER_DONE_EVENT);
+}
+
+bool DownloadPipeline::Run(Http* http, size_t content_length, Sink sink, ProgressCallback progress_callback, size_t start_offset) {
+    if (uxQueueMessagesWaiting(free_queue_) < 2) {
+        ESP_LOGE(TAG, "Failed to allocate download blocks");
+        return false;
+    }
+    sink_ = sink;
+    total_written_ = 0;
+    failed_ = false;
+    xEventGroupClearBits(event_group_, WRITER_DONE_EVENT);
+
+    if (xTaskCreate([](void* arg) {
+        static_cast<DownloadPipeline*>(arg)->WriterTask();
+        vTaskDelete(NULL);
+    }, "flash_writer", 6144, this, 5, nullptr) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create flash writer task");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Downloading %u bytes from offset %u with %u blocks of %u bytes", content_length, start_offset,
+        (unsigned)uxQueueMessagesWaiting(free_queue_), block_size_);
+
+    bool read_error = false;
+    size_t total_read = 0;
+    size_t last_written = start_offset;
+    auto start_time = esp_timer_get_time();
+    auto last_calc_time = start_time;
+    bool eof = false;
+    while (!eof && !failed_) {
+        Block* block;
+        xQueueReceive(free_queue_, &block, portMAX_DELAY);
+        block->size = 0;
+        block->offset = start_offset + total_read;
+        // Fill the whole block so the writer always gets sector multiples except at the end
+        while (block->size < block_size_) {
+            int ret = http->Read((char*)block->data + block->size, block_size_ - block->size);
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %d", ret);
+                read_error = true;
+                eof = true;
+                break;
+            }
+            if (ret == 0) {
+                eof = true;
+                break;
+            }
+            block->size += ret;
+        }
+        total_read += block->size;
+        if (block->size > 0 && !read_error) {
+            xQueueSend(full_queue_, &block, portMAX_DELAY);
+        } else {
+            xQueueSend(free_queue_, &block, portMAX_DELAY);
+        }
+
+        auto now = esp_timer_get_time();
+        if (now - last_calc_time >= 1000000 || eof) {
+            size_t written = start_offset + total_written_;
+            size_t speed = (written - last_written) * 1000000ULL / std::max<int64_t>(now - last_calc_time, 1);
+            int progress = content_length > 0 ? std::min<size_t>(written * 100 / content_length, 100) : 0;
+            ESP_LOGI(TAG, "Progress: %d%% (%u/%u), received %u, speed: %u B/s", progress, written, content_length, total_read, speed);
+            if (progress_callback) {
+                progress_callback(progress, speed);
+            }
+            last_calc_time = now;
+            last_written = written;
+        }
+    }
+
+    Block* end = nullptr;
+    xQueueSend(full_queue_, &end, portMAX_DELAY);
+    xEventGroupWaitBits(event_group_, WRITER_DONE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+
+    auto elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+    ESP_LOGI(TAG, "Wrote %u bytes in %lld ms (%lld B/s)", (size_t)total_written_, elapsed_ms,
+        elapsed_ms > 0 ? (int64_t)total_written_ * 1000 / elapsed_ms : 0);
+    if (progress_callback && content_length > 0) {
+        progress_callback(std::min<size_t>((start_offset + total_written_) * 100 / content_length, 100), 0);
+    }
+    return !read_error && !failed_;
+}
@@ -0,0 +1,62 @@
+#ifndef DOWNLOAD_PIPELINE_H
+#define DOWNLOAD_PIPELINE_H
+
+#include <http.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/event_groups.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#define DOWNLOAD_PIPELINE_BLOCK_COUNT 4
+#define DOWNLOAD_PIPELINE_PSRAM_BLOCK_SIZE (32 * 1024)
+#define DOWNLOAD_PIPELINE_SRAM_BLOCK_SIZE (4 * 1024)
+
+/*
+ * Overlaps network receive with flash erase/program for firmware and assets updates.
+ *
+ * The calling task fills a ring of large blocks from the HTTP body while a writer task
+ * hands every full block to the sink, so a slow sector erase no longer stalls the socket.
+ * Blocks are sector multiples, which lets sinks erase whole blocks at once.
+ */
+class DownloadPipeline {
+public:
+    // Writes size bytes at offset in the image, returns false to abort the download
+    using Sink = std::function<bool(const uint8_t* data, size_t size, size_t offset)>;
+    using ProgressCallback = std::function<void(int progress, size_t speed)>;
+
+    DownloadPipeline();
+    ~DownloadPipeline();
+
+    // Streams the body of an opened request into the sink until EOF,
+    // start_offset is where the body begins in the image (for Range resumes)
+    bool Run(Http* http, size_t content_length, Sink sink, ProgressCallback progress_callback, size_t start_offset = 0);
+
+    // Bytes written by the last Run, relative to start_offset
+    size_t total_written() const { return total_written_; }
+    // True when the last Run stopped because the sink rejected a block
+    bool sink_failed() const { return failed_; }
+    size_t block_size() const { return block_size_; }
+
+private:
+    struct Block {
+        uint8_t* data;
+        size_t size;
+        size_t offset;
+    };
+
+    Block blocks_[DOWNLOAD_PIPELINE_BLOCK_COUNT] = {};
+    size_t block_size_ = 0;
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    EventGroupHandle_t event_group_ = nullptr;
+    Sink sink_;
+    std::atomic<size_t> total_written_{0};
+    std::atomic<bool> failed_{false};
+
+    void WriterTask();
+};
+
+#endif // DOWNLOAD_PIPELINE_H
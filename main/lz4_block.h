@@ -0,0 +1,11 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Decodes one LZ4 block (no frame header), returns the output size or -1 on malformed input.
+// Used by the compressed assets entries and the compressed delta patch ops.
+int Lz4DecompressBlock(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
+
+#endif // LZ4_BLOCK_H
@@ -199,9 +199,10 @@ void McpServer::AddCommonTools() {
                 if (!camera->Capture()) {
                     throw std::runtime_error("Failed to capture photo");
                 }
+                McpServer::GetInstance().ReportProgress(1, 2);
                 auto question = properties["question"].value<std::string>();
                 return camera->Explain(question);
-            });
+            }, kMcpToolExecutionWorker);
     }
 #endif
 
@@ -242,6 +243,10 @@ void McpServer::AddCommonTools() {
                          return "{\"success\": false, \"message\": \"Để phát nhạc từ thẻ nhớ, vui lòng dùng tool self.sdmusic.playback với action=play. Nhạc trong thẻ SD đã được hỗ trợ!\"}";
                      }
 
+                     // The lookup runs here, Download() schedules the player start on the main loop.
+                     // One lookup at a time, it fills the player's song details
+                     static std::mutex download_mutex;
+                     std::lock_guard<std::mutex> lock(download_mutex);
                      if (!music->Download(song_name, artist_name))
                      {
                          return "{\"success\": false, \"message\": \"Failed to get music resource\"}";
@@ -249,7 +254,7 @@ void McpServer::AddCommonTools() {
                      auto download_result = music->GetDownloadResult();
                      ESP_LOGI(TAG, "Music details result: %s", download_result.c_str());
                      return "{\"success\": true, \"message\": \"Music started playing\"}";
-                 });
+                 }, kMcpToolExecutionWorker);
 
          AddTool("self.music.set_display_mode",
                  "Set the display mode for music playback. You can choose to display spectrum or lyrics, for example when user says 'show spectrum' or 'display spectrum', 'show lyrics' or 'display lyrics', set the corresponding display mode.\n"
@@ -657,9 +662,13 @@ void McpServer::AddCommonTools() {
 				if (action == "play") {
 					std::string dir = props["directory"].value<std::string>();
 
-					if (!sd_music->playDirectory(dir)) {
+					// Scan the directory here, only start the player from the main loop
+					if (!sd_music->setDirectory(dir) || sd_music->getTotalTracks() == 0) {
 						return "{\"success\": false, \"message\": \"Cannot play directory or directory has no MP3\"}";
 					}
+					Application::GetInstance().Schedule([sd_music]() {
+						sd_music->setTrack(0);
+					});
 					return "{\"success\": true, \"message\": \"Playing directory\"}";
 				}
 
@@ -673,7 +682,8 @@ void McpServer::AddCommonTools() {
 				}
 
 				return "{\"success\": false, \"message\": \"Unknown directory action\"}";
-			}
+			},
+			kMcpToolExecutionWorker
 		);
 
 		// ================== 5) TÌM KIẾM / PLAY THEO TÊN ==================
@@ -741,14 +751,18 @@ void McpServer::AddCommonTools() {
 						return "{\"success\": false, \"message\": \"Keyword cannot be empty\"}";
 
 					ensure_playlist();
-					bool ok = sd_music->playByName(keyword);
-					return ok
-						? "{\"success\": true, \"message\": \"Playing song by name\"}"
-						: "{\"success\": false, \"message\": \"Song not found\"}";
+					if (sd_music->findTrackIndexByKeyword(keyword) < 0) {
+						return "{\"success\": false, \"message\": \"Song not found\"}";
+					}
+					Application::GetInstance().Schedule([sd_music, keyword]() {
+						sd_music->playByName(keyword);
+					});
+					return "{\"success\": true, \"message\": \"Playing song by name\"}";
 				}
 
 				return "{\"success\": false, \"message\": \"Unknown search action\"}";
-			}
+			},
+			kMcpToolExecutionWorker
 		);
 
 		// ================== 6) PROGRESS ==================
@@ -866,6 +880,8 @@ void McpServer::AddCommonTools() {
 	
     // Restore the original tools list to the end of the tools list
     tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    std::lock_guard<std::mutex> lock(tools_list_mutex_);
+    tools_list_cache_.clear();
 }
 
 void McpServer::AddUserOnlyTools() {
@@ -931,6 +947,22 @@ void McpServer::AddUserOnlyTools() {
                 return json;
             });
 
+        AddUserOnlyTool("self.screen.get_perf", "Get LVGL rendering statistics: frame, render and flush time, invalidated area, display lock wait per-section (GIF, spectrum, chat message) time histograms, text glyph cache hit rate and main loop schedule latency per priority.",
+            PropertyList({
+                Property("reset", kPropertyTypeBoolean, false)
+            }),
+            [display](const PropertyList& properties) -> ReturnValue {
+                auto& perf = display->perf();
+                cJSON *json = perf.ToJson();
+                cJSON_AddItemToObject(json, "glyph_cache", LvglGlyphCache::GetInstance().ToJson());
+                bool reset = properties["reset"].value<bool>();
+                cJSON_AddItemToObject(json, "schedule", Application::GetInstance().GetScheduleStats(reset));
+                if (reset) {
+                    perf.Reset();
+                }
+                return json;
+            }, kMcpToolExecutionInline);
+
 #if CONFIG_LV_USE_SNAPSHOT
         AddUserOnlyTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
             PropertyList({
@@ -941,13 +973,6 @@ void McpServer::AddUserOnlyTools() {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
-                }
-
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
                 // 构造multipart/form-data请求体
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
                 
@@ -966,8 +991,17 @@ void McpServer::AddUserOnlyTools() {
                     http->Write(file_header.c_str(), file_header.size());
                 }
 
-                // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                // JPEG数据边编码边以 chunked 方式上传，不在内存中保留整张图片
+                size_t jpeg_size = 0;
+                bool ok = display->SnapshotToJpeg([&http, &jpeg_size](const char* data, size_t len) {
+                    jpeg_size += len;
+                    return http->Write(data, len) >= 0;
+                }, quality);
+                if (!ok) {
+                    http->Close();
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ESP_LOGI(TAG, "Uploaded snapshot %u bytes to %s", jpeg_size, url.c_str());
 
                 {
                     // multipart尾部
@@ -984,7 +1018,7 @@ void McpServer::AddUserOnlyTools() {
                 http->Close();
                 ESP_LOGI(TAG, "Snapshot screen result: %s", result.c_str());
                 return true;
-            });
+            }, kMcpToolExecutionWorker);
         
         AddUserOnlyTool("self.screen.preview_image", "Preview an image on the screen",
             PropertyList({
@@ -1054,15 +1088,22 @@ void McpServer::AddTool(McpTool* tool) {
 
     ESP_LOGI(TAG, "Add tool: %s%s", tool->name().c_str(), tool->user_only() ? " [user]" : "");
     tools_.push_back(tool);
+    std::lock_guard<std::mutex> lock(tools_list_mutex_);
+    tools_list_cache_.clear();
 }
 
-void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
-    AddTool(new McpTool(name, description, properties, callback));
+void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback,
+    McpToolExecution execution) {
+    auto tool = new McpTool(name, description, properties, callback);
+    tool->set_execution(execution);
+    AddTool(tool);
 }
 
-void McpServer::AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
+void McpServer::AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback,
+    McpToolExecution execution) {
     auto tool = new McpTool(name, description, properties, callback);
     tool->set_user_only(true);
+    tool->set_execution(execution);
     AddTool(tool);
 }
 
@@ -1111,10 +1152,7 @@ void McpServer::ParseMessage(const cJSON* json) {
     }
     
     auto method_str = std::string(method->valuestring);
-    if (method_str.find("notifications") == 0) {
-        return;
-    }
-    
+
     // Check params
     auto params = cJSON_GetObjectItem(json, "params");
     if (params != nullptr && !cJSON_IsObject(params)) {
@@ -1122,6 +1160,16 @@ void McpServer::ParseMessage(const cJSON* json) {
         return;
     }
 
+    if (method_str.find("notifications") == 0) {
+        if (method_str == "notifications/cancelled" && params != nullptr) {
+            auto request_id = cJSON_GetObjectItem(params, "requestId");
+            if (cJSON_IsNumber(request_id)) {
+                CancelToolCall(request_id->valueint);
+            }
+        }
+        return;
+    }
+
     auto id = cJSON_GetObjectItem(json, "id");
     if (id == nullptr || !cJSON_IsNumber(id)) {
         ESP_LOGE(TAG, "Invalid id for method: %s", method_str.c_str());
@@ -1173,7 +1221,17 @@ void McpServer::ParseMessage(const cJSON* json) {
             ReplyError(id_int, "Invalid arguments");
             return;
         }
-        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments);
+        std::string progress_token;
+        auto meta = cJSON_GetObjectItem(params, "_meta");
+        if (cJSON_IsObject(meta)) {
+            auto token = cJSON_GetObjectItem(meta, "progressToken");
+            if (cJSON_IsString(token) || cJSON_IsNumber(token)) {
+                char* token_str = cJSON_PrintUnformatted(token);
+                progress_token = token_str;
+                cJSON_free(token_str);
+            }
+        }
+        DoToolCall(id_int, std::string(tool_name->valuestring), tool_arguments, std::move(progress_token));
     } else {
         ESP_LOGE(TAG, "Method not implemented: %s", method_str.c_str());
         ReplyError(id_int, "Method not implemented: " + method_str);
@@ -1198,6 +1256,31 @@ void McpServer::ReplyError(int id, const std::string& message) {
 }
 
 void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
+    // Pages only depend on the registered tools, build each one once per boot
+    std::string key = cursor + (list_user_only_tools ? "|user" : "|");
+    std::string json;
+    {
+        std::lock_guard<std::mutex> lock(tools_list_mutex_);
+        auto it = tools_list_cache_.find(key);
+        if (it != tools_list_cache_.end()) {
+            json = it->second;
+        }
+    }
+
+    if (json.empty()) {
+        std::string error;
+        json = BuildToolsListPage(cursor, list_user_only_tools, error);
+        if (!error.empty()) {
+            ReplyError(id, error);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(tools_list_mutex_);
+        tools_list_cache_[key] = json;
+    }
+    ReplyResult(id, json);
+}
+
+std::string McpServer::BuildToolsListPage(const std::string& cursor, bool list_user_only_tools, std::string& error) {
     const int max_payload_size = 8000;
     std::string json = "{\"tools\":[";
     
@@ -1222,14 +1305,15 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
         }
         
         // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
+        const std::string& tool_json = (*it)->to_json();
+        if (json.length() + tool_json.length() + 1 + 30 > max_payload_size) {
             // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
             next_cursor = (*it)->name();
             break;
         }
         
         json += tool_json;
+        json += ',';
         ++it;
     }
     
@@ -1240,8 +1324,8 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
     if (json.back() == '[' && !tools_.empty()) {
         // 如果没有添加任何tool，返回错误
         ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
-        return;
+        error = "Failed to add tool " + next_cursor + " because of payload size limit";
+        return "";
     }
 
     if (next_cursor.empty()) {
@@ -1249,11 +1333,10 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
     } else {
         json += "],\"nextCursor\":\"" + next_cursor + "\"}";
     }
-    
-    ReplyResult(id, json);
+    return json;
 }
 
-void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
+void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, std::string progress_token) {
     auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
                                  [&tool_name](const McpTool* tool) { 
                                      return tool->name() == tool_name; 
@@ -1295,14 +1378,140 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
         return;
     }
 
-    // Use main thread to call the tool
-    auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
+    auto tool = *tool_iter;
+    if (tool->execution() == kMcpToolExecutionWorker) {
+        auto job = std::make_shared<ToolJob>();
+        job->id = id;
+        job->tool = tool;
+        job->arguments = std::move(arguments);
+        job->progress_token = std::move(progress_token);
+        StartToolJob(std::move(job));
+        return;
+    }
+
+    auto call = [this, id, tool, arguments = std::move(arguments)]() {
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            ReplyResult(id, tool->Call(arguments));
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
             ReplyError(id, e.what());
         }
-    });
+    };
+    if (tool->execution() == kMcpToolExecutionInline) {
+        call();
+    } else {
+        // Use main thread to call the tool
+        Application::GetInstance().Schedule(std::move(call));
+    }
+}
+
+void McpServer::StartToolJob(std::shared_ptr<ToolJob> job) {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    if (pending_jobs_.size() >= MCP_TOOL_MAX_PENDING_JOBS) {
+        ESP_LOGE(TAG, "tools/call: Too many pending tool calls, rejecting %s", job->tool->name().c_str());
+        ReplyError(job->id, "Too many tool calls in progress");
+        return;
+    }
+    pending_jobs_.push_back(std::move(job));
+
+    // Workers exit when the queue is empty, so idle devices keep no worker stacks
+    if (worker_count_ < CONFIG_MCP_TOOL_WORKER_COUNT) {
+        if (xTaskCreate([](void* arg) {
+            static_cast<McpServer*>(arg)->ToolWorkerTask();
+            vTaskDelete(NULL);
+        }, "mcp_tool", MCP_TOOL_WORKER_STACK_SIZE, this, 2, nullptr) == pdPASS) {
+            worker_count_++;
+        } else if (worker_count_ == 0) {
+            ESP_LOGE(TAG, "tools/call: Failed to start tool worker");
+            auto failed = std::move(pending_jobs_.back());
+            pending_jobs_.pop_back();
+            ReplyError(failed->id, "Failed to start tool worker");
+        }
+    }
+}
+
+void McpServer::ToolWorkerTask() {
+    while (true) {
+        std::shared_ptr<ToolJob> job;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            if (pending_jobs_.empty()) {
+                worker_count_--;
+                return;
+            }
+            job = std::move(pending_jobs_.front());
+            pending_jobs_.pop_front();
+            job->task = xTaskGetCurrentTaskHandle();
+            running_jobs_.push_back(job);
+        }
+
+        std::string result;
+        std::string error;
+        try {
+            result = job->tool->Call(job->arguments);
+        } catch (const std::exception& e) {
+            ESP_LOGE(TAG, "tools/call: %s", e.what());
+            error = e.what();
+        }
+
+        bool cancelled;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            running_jobs_.erase(std::find(running_jobs_.begin(), running_jobs_.end(), job));
+            cancelled = job->cancelled;
+        }
+        // A cancelled request gets no response
+        if (cancelled) {
+            ESP_LOGI(TAG, "tools/call: Dropped result of cancelled call %d", job->id);
+        } else if (!error.empty()) {
+            ReplyError(job->id, error);
+        } else {
+            ReplyResult(job->id, result);
+        }
+    }
+}
+
+void McpServer::CancelToolCall(int id) {
+    std::lock_guard<std::mutex> lock(jobs_mutex_);
+    for (auto it = pending_jobs_.begin(); it != pending_jobs_.end(); ++it) {
+        if ((*it)->id == id) {
+            ESP_LOGI(TAG, "tools/call: Cancelled pending call %d", id);
+            pending_jobs_.erase(it);
+            return;
+        }
+    }
+    // A running tool cannot be interrupted, its result is dropped when it returns
+    for (auto& job : running_jobs_) {
+        if (job->id == id) {
+            job->cancelled = true;
+            return;
+        }
+    }
+}
+
+void McpServer::ReportProgress(int progress, int total) {
+    std::string token;
+    {
+        std::lock_guard<std::mutex> lock(jobs_mutex_);
+        auto current = xTaskGetCurrentTaskHandle();
+        for (auto& job : running_jobs_) {
+            if (job->task == current) {
+                if (!job->cancelled) {
+                    token = job->progress_token;
+                }
+                break;
+            }
+        }
+    }
+    if (token.empty()) {
+        return;
+    }
+
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"method\":\"notifications/progress\",\"params\":{\"progressToken\":";
+    payload += token + ",\"progress\":" + std::to_string(progress);
+    if (total > 0) {
+        payload += ",\"total\":" + std::to_string(total);
+    }
+    payload += "}}";
+    Application::GetInstance().SendMcpMessage(payload);
 }
@@ -9,9 +9,14 @@
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
+#include <deque>
+#include <memory>
 #include <mbedtls/base64.h>
 
 #include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
 class ImageContent {
 private:
@@ -120,7 +125,7 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
         
         if (type_ == kPropertyTypeBoolean) {
@@ -145,7 +150,11 @@ public:
                 cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
             }
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -188,14 +197,16 @@ public:
         return required;
     }
 
-    std::string to_json() const {
+    cJSON* to_cjson() const {
         cJSON *json = cJSON_CreateObject();
-        
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            cJSON_AddItemToObject(json, property.name().c_str(), property.to_cjson());
         }
-        
+        return json;
+    }
+
+    std::string to_json() const {
+        cJSON *json = to_cjson();
         char *json_str = cJSON_PrintUnformatted(json);
         std::string result(json_str);
         cJSON_free(json_str);
@@ -205,6 +216,18 @@ public:
     }
 };
 
+// Where a tool callback runs
+enum McpToolExecution {
+    kMcpToolExecutionMainLoop,  // Application::Schedule, for tools that change device state or
+                                // start/stop a player (players are not safe to drive from two workers)
+    kMcpToolExecutionInline,    // In the task that received the call, must return quickly
+    kMcpToolExecutionWorker,    // In a worker task, for slow network or storage work. Player tools
+                                // search or scan here and Schedule only the player start
+};
+
+#define MCP_TOOL_WORKER_STACK_SIZE (1024 * 8)
+#define MCP_TOOL_MAX_PENDING_JOBS 4
+
 class McpTool {
 private:
     std::string name_;
@@ -212,6 +235,7 @@ private:
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
     bool user_only_ = false;
+    McpToolExecution execution_ = kMcpToolExecutionMainLoop;
 
 public:
     McpTool(const std::string& name, 
@@ -223,13 +247,26 @@ public:
         properties_(properties), 
         callback_(callback) {}
 
-    void set_user_only(bool user_only) { user_only_ = user_only; }
+    void set_user_only(bool user_only) { user_only_ = user_only; json_cache_.clear(); }
+    void set_execution(McpToolExecution execution) { execution_ = execution; }
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
+    inline McpToolExecution execution() const { return execution_; }
 
-    std::string to_json() const {
+    // The schema never changes after registration, so it is serialized once
+    const std::string& to_json() const {
+        if (json_cache_.empty()) {
+            json_cache_ = Serialize();
+        }
+        return json_cache_;
+    }
+
+private:
+    mutable std::string json_cache_;
+
+    std::string Serialize() const {
         std::vector<std::string> required = properties_.GetRequired();
         
         cJSON *json = cJSON_CreateObject();
@@ -239,8 +276,7 @@ public:
         cJSON *input_schema = cJSON_CreateObject();
         cJSON_AddStringToObject(input_schema, "type", "object");
         
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
+        cJSON_AddItemToObject(input_schema, "properties", properties_.to_cjson());
         
         if (!required.empty()) {
             cJSON *required_array = cJSON_CreateArray();
@@ -269,6 +305,7 @@ public:
         return result;
     }
 
+public:
     std::string Call(const PropertyList& properties) {
         ReturnValue return_value = callback_(properties);
         // Return result
@@ -321,24 +358,51 @@ public:
     void AddCommonTools();
     void AddUserOnlyTools();
     void AddTool(McpTool* tool);
-    void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
-    void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
+    void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback,
+        McpToolExecution execution = kMcpToolExecutionMainLoop);
+    void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback,
+        McpToolExecution execution = kMcpToolExecutionMainLoop);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    // Sends notifications/progress for the worker tool call running in the current task,
+    // if the caller asked for progress with a progressToken
+    void ReportProgress(int progress, int total = 0);
 
 private:
     McpServer();
     ~McpServer();
 
+    struct ToolJob {
+        int id;
+        McpTool* tool;
+        PropertyList arguments;
+        std::string progress_token;  // Raw JSON value, empty if not requested
+        bool cancelled = false;
+        TaskHandle_t task = nullptr;
+    };
+
+    std::mutex jobs_mutex_;
+    std::deque<std::shared_ptr<ToolJob>> pending_jobs_;
+    std::vector<std::shared_ptr<ToolJob>> running_jobs_;
+    int worker_count_ = 0;
+
+    void StartToolJob(std::shared_ptr<ToolJob> job);
+    void ToolWorkerTask();
+    void CancelToolCall(int id);
+
     void ParseCapabilities(const cJSON* capabilities);
 
     void ReplyResult(int id, const std::string& result);
     void ReplyError(int id, const std::string& message);
 
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
-    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
+    std::string BuildToolsListPage(const std::string& cursor, bool list_user_only_tools, std::string& error);
+    void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments, std::string progress_token);
 
     std::vector<McpTool*> tools_;
+    // tools/list results by cursor and user tool flag, cleared when a tool is added
+    std::mutex tools_list_mutex_;
+    std::map<std::string, std::string> tools_list_cache_;
 };
 
 #endif // MCP_SERVER_H
@@ -1,4 +1,5 @@
 #include "esp32_music.h"
+#include "http_pool.h"
 #include "board.h"
 #include "system_info.h"
 #include "audio/audio_codec.h"
@@ -89,7 +90,7 @@ static std::string generate_dynamic_key(int64_t timestamp) {
  * @brief Add authentication headers to HTTP request
  * @param http HTTP client pointer
  */
-static void add_auth_headers(Http* http) {
+static void add_auth_headers(PooledHttp* http) {
     // Get current timestamp
     int64_t timestamp = esp_timer_get_time() / 1000000;  // Convert to seconds
     
@@ -175,8 +176,8 @@ Esp32Music::Esp32Music() : last_downloaded_data_(), current_music_url_(), curren
                          song_name_displayed_(false), current_lyric_url_(), lyrics_(), 
                          current_lyric_index_(-1), lyric_thread_(), is_lyric_running_(false),
                          display_mode_(DISPLAY_MODE_SPECTRUM), is_playing_(false), is_downloading_(false), 
-                         play_thread_(), download_thread_(), audio_buffer_(), buffer_mutex_(), 
-                         buffer_cv_(), buffer_size_(0), mp3_decoder_(nullptr), mp3_frame_info_(), 
+                         play_thread_(), download_thread_(),
+                         audio_ring_(CONFIG_MUSIC_STREAM_BUFFER_MS, CONFIG_MUSIC_STREAM_START_MS), mp3_decoder_(nullptr), mp3_frame_info_(), 
                          mp3_decoder_initialized_(false) {
 }
 
@@ -189,10 +190,7 @@ Esp32Music::~Esp32Music() {
     is_lyric_running_ = false;
     
     // Notify all waiting threads
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    audio_ring_.Abort();
     
     // Wait for download thread to finish with 5-second timeout
     if (download_thread_.joinable()) {
@@ -215,10 +213,7 @@ Esp32Music::~Esp32Music() {
             is_downloading_ = false;
             
             // Notify condition variable
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex_);
-                buffer_cv_.notify_all();
-            }
+            audio_ring_.Abort();
             
             // Check if the thread has already finished
             if (!download_thread_.joinable()) {
@@ -257,10 +252,7 @@ Esp32Music::~Esp32Music() {
             is_playing_ = false;
             
             // Notify the condition variable
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex_);
-                buffer_cv_.notify_all();
-            }
+            audio_ring_.Abort();
             
             // Check if the thread has already finished
             if (!play_thread_.joinable()) {
@@ -402,15 +394,22 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
         return true;
     }
     
+    // Songs played before are replayed from the SD card cache without the network
+    SongCache::Entry cached;
+    std::string cached_path;
+    if (SongCache::GetInstance().LookupSong(song_name, artist_name, cached, cached_path) &&
+        PlayCachedSong(cached, cached_path)) {
+        return true;
+    }
+    
     // Step 1: Request the stream_pcm API to retrieve audio information
     std::string base_url = GetCheckMusicServerUrl();
     std::string full_url = base_url + "/stream_pcm?song=" + url_encode(song_name) + "&artist=" + url_encode(artist_name);
     
     ESP_LOGI(TAG, "Request URL: %s", full_url.c_str());
     
-    // Use the HTTP client provided by the Board
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
+    // Pooled keep-alive client, the stream and lyrics requests reuse this connection
+    auto http = std::make_unique<PooledHttp>();
     
     // Set basic request headers
     http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
@@ -503,14 +502,16 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                     current_music_url_ = base_url + audio_path;
                 }
                 
-                ESP_LOGI(TAG, "Starting streaming playback for: %s", song_name.c_str());
-                song_name_displayed_ = false; 
-				full_info_displayed_ = false;
-				
-                StartStreaming(current_music_url_);
-
+                // Another request name for a song that is already cached
+                if (SongCache::GetInstance().LookupAudioPath(audio_path, cached, cached_path) &&
+                    PlayCachedSong(cached, cached_path)) {
+                    SongCache::GetInstance().AddSongAlias(audio_path, song_name, artist_name);
+                    cJSON_Delete(response_json);
+                    return true;
+                }
                 
                 // Handle lyric URL - only start lyrics in lyric display mode
+                std::string lyric_full_url;
                 if (cJSON_IsString(lyric_url) && lyric_url->valuestring && strlen(lyric_url->valuestring) > 0) {
                     // Construct the complete lyric download URL using the same URL building logic
                     std::string lyric_path = lyric_url->valuestring;
@@ -519,13 +520,31 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                         std::string path = lyric_path.substr(0, query_pos);
                         std::string query = lyric_path.substr(query_pos + 1);
                         
-                        current_lyric_url_ = buildUrlWithParams(base_url, path, query);
+                        lyric_full_url = buildUrlWithParams(base_url, path, query);
                     } else {
-                        current_lyric_url_ = base_url + lyric_path;
+                        lyric_full_url = base_url + lyric_path;
+                    }
+                    if (display_mode_ != DISPLAY_MODE_LYRICS) {
+                        ESP_LOGI(TAG, "Lyric URL found but spectrum display mode is active, skipping lyrics");
                     }
+                } else {
+                    ESP_LOGW(TAG, "No lyric URL found for this song");
+                }
+                
+                // The lookup above may run in an MCP tool worker, the stream and lyric
+                // threads are started and stopped from the main loop only
+                SongCache::Source cache_source = {song_name, artist_name, audio_path, title_name_, artist_name_};
+                std::string music_url = current_music_url_;
+                Application::GetInstance().Schedule([this, song_name, music_url, cache_source, lyric_full_url]() {
+                    ESP_LOGI(TAG, "Starting streaming playback for: %s", song_name.c_str());
+                    song_name_displayed_ = false; 
+                    full_info_displayed_ = false;
+                    
+                    next_cache_source_ = cache_source;
+                    StartStreaming(music_url);
                     
                     // Decide whether to start lyrics based on the display mode
-                    if (display_mode_ == DISPLAY_MODE_LYRICS) {
+                    if (!lyric_full_url.empty() && display_mode_ == DISPLAY_MODE_LYRICS) {
                         ESP_LOGI(TAG, "Loading lyrics for: %s (lyrics display mode)", song_name.c_str());
                         
                         // Start lyric download and display
@@ -536,17 +555,14 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                             }
                         }
                         
+                        current_lyric_url_ = lyric_full_url;
                         is_lyric_running_ = true;
                         current_lyric_index_ = -1;
-                        lyrics_.clear();
+                        SetLyrics(nullptr);
                         
                         lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
-                    } else {
-                        ESP_LOGI(TAG, "Lyric URL found but spectrum display mode is active, skipping lyrics");
                     }
-                } else {
-                    ESP_LOGW(TAG, "No lyric URL found for this song");
-                }
+                });
                 
                 cJSON_Delete(response_json);
                 return true;
@@ -569,6 +585,44 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
 
 
 
+// Play a cached song through the SD card player
+bool Esp32Music::PlayCachedSong(const SongCache::Entry& entry, const std::string& path) {
+    auto sd_music = Application::GetInstance().GetSdMusic();
+    if (!sd_music) {
+        return false;
+    }
+    
+    Esp32SdMusic::TrackInfo track;
+    track.path = path;
+    track.name = entry.title;
+    track.title = entry.title;
+    track.artist = entry.artist;
+    track.file_size = entry.size;
+    
+    title_name_ = entry.title;
+    artist_name_ = entry.artist;
+    
+    cJSON* result = cJSON_CreateObject();
+    cJSON_AddStringToObject(result, "title", entry.title.c_str());
+    cJSON_AddStringToObject(result, "artist", entry.artist.c_str());
+    cJSON_AddStringToObject(result, "source", "sd_cache");
+    char* json = cJSON_PrintUnformatted(result);
+    last_downloaded_data_ = json ? json : "";
+    cJSON_free(json);
+    cJSON_Delete(result);
+    
+    // Like the stream threads, the players are only switched from the main loop
+    Application::GetInstance().Schedule([this, sd_music, track]() {
+        // Stop online streaming if playing
+        if (is_playing_ || is_downloading_) {
+            StopStreaming();
+        }
+        ESP_LOGI(TAG, "Playing '%s' from the SD card cache: %s", track.title.c_str(), track.path.c_str());
+        sd_music->playFile(track);
+    });
+    return true;
+}
+
 std::string Esp32Music::GetDownloadResult() {
     return last_downloaded_data_;
 }
@@ -609,21 +663,18 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
     
     // Wait for the previous threads to fully terminate
     if (download_thread_.joinable()) {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all();  // Notify threads to exit
-        }
+        audio_ring_.Abort();
         download_thread_.join();
     }
     if (play_thread_.joinable()) {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all();  // Notify threads to exit
-        }
+        audio_ring_.Abort();
         play_thread_.join();
     }
     
-    // Clear the buffer
+    // Clear the buffer, the ring itself is allocated once and reused for every song
+    if (!audio_ring_.Allocate()) {
+        return false;
+    }
     ClearAudioBuffer();
     
     // Configure thread stack size to avoid stack overflow
@@ -633,9 +684,11 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
     cfg.thread_name = "audio_stream";
     esp_pthread_set_cfg(&cfg);
     
-    // Start the download thread
+    // Start the download thread, songs from Download() are also written to the SD cache
+    SongCache::Source cache_source = next_cache_source_;
+    next_cache_source_ = {};
     is_downloading_ = true;
-    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, music_url);
+    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, music_url, cache_source);
     
     // Start the playback thread (will wait for the buffer to have enough data)
     is_playing_ = true;
@@ -678,10 +731,7 @@ bool Esp32Music::StopStreaming() {
     }
     
     // Notify all waiting threads
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    audio_ring_.Abort();
     
     // Wait for threads to finish (avoid duplicate code, ensure StopStreaming waits for threads to fully stop)
     if (download_thread_.joinable()) {
@@ -695,10 +745,7 @@ bool Esp32Music::StopStreaming() {
         is_playing_ = false;
         
         // Notify the condition variable to ensure the thread can exit
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all();
-        }
+        audio_ring_.Abort();
         
         // Use a timeout mechanism to wait for the thread to finish, avoiding deadlocks
         bool thread_finished = false;
@@ -751,7 +798,7 @@ bool Esp32Music::StopStreaming() {
 }
 
 // Stream audio data
-void Esp32Music::DownloadAudioStream(const std::string& music_url) {
+void Esp32Music::DownloadAudioStream(const std::string& music_url, SongCache::Source cache_source) {
     ESP_LOGD(TAG, "Starting audio stream download from: %s", music_url.c_str());
     
     // Validate URL
@@ -761,14 +808,12 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
         return;
     }
     
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
+    auto http = std::make_unique<PooledHttp>();
     
-    // Set basic request headers
+    // Set basic request headers, the pool adds Connection: keep-alive
     http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
     http->SetHeader("Accept", "*/*");
     http->SetHeader("Range", "bytes=0-");  // Support range requests
-    http->SetHeader("Connection", "keep-alive");  // Giữ kết nối ổn định
     http->SetHeader("Cache-Control", "no-cache"); // Tránh cache cũ
     
     // Add ESP32 authentication headers
@@ -790,34 +835,32 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
     
     ESP_LOGI(TAG, "Started downloading audio stream, status: %d", status_code);
     
-    // Read audio data in chunks
-    const size_t chunk_size = 4096;  // 4KB per chunk
-    char* buffer = new char[chunk_size];
+    // Tee the stream into the SD card cache, kept only if the whole song arrives
+    SongCache::Writer cache_writer(cache_source, http->GetBodyLength());
+    bool completed = false;
+    
+    // Receive straight into the stream ring
     size_t total_downloaded = 0;
     size_t total_print_bytes = 0;
     
     while (is_downloading_ && is_playing_) {
-        int bytes_read = http->Read(buffer, chunk_size);
+        uint8_t* buffer = nullptr;
+        size_t space = audio_ring_.AcquireWrite(buffer);
+        if (space == 0) {
+            break;  // Aborted
+        }
+        int bytes_read = http->Read((char*)buffer, space);
         if (bytes_read < 0) {
             ESP_LOGE(TAG, "Failed to read audio data: error code %d", bytes_read);
             break;
         }
         if (bytes_read == 0) {
             ESP_LOGI(TAG, "Audio stream download completed, total: %d bytes", total_downloaded);
+            completed = true;
             break;
         }
         
-        // Log chunk information
-        // ESP_LOGI(TAG, "Downloaded chunk: %d bytes at offset %d", bytes_read, total_downloaded);
-        
-        // Safely log the first 16 bytes of the chunk in hexadecimal
-        if (bytes_read >= 16) {
-            // ESP_LOGI(TAG, "Data: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X ...", 
-            //         (unsigned char)buffer[0], (unsigned char)buffer[1], (unsigned char)buffer[2], (unsigned char)buffer[3],
-            //         (unsigned char)buffer[4], (unsigned char)buffer[5], (unsigned char)buffer[6], (unsigned char)buffer[7],
-            //         (unsigned char)buffer[8], (unsigned char)buffer[9], (unsigned char)buffer[10], (unsigned char)buffer[11],
-            //         (unsigned char)buffer[12], (unsigned char)buffer[13], (unsigned char)buffer[14], (unsigned char)buffer[15]);
-        } else {
+        if (bytes_read < 16) {
             ESP_LOGI(TAG, "Data chunk too small: %d bytes", bytes_read);
         }
         
@@ -835,47 +878,27 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
                 ESP_LOGI(TAG, "Detected OGG file");
             } else {
                 ESP_LOGI(TAG, "Unknown audio format, first 4 bytes: %02X %02X %02X %02X", 
-                        (unsigned char)buffer[0], (unsigned char)buffer[1], 
-                        (unsigned char)buffer[2], (unsigned char)buffer[3]);
+                        buffer[0], buffer[1], buffer[2], buffer[3]);
             }
         }
         
-        // Create audio data chunk
-        uint8_t* chunk_data = (uint8_t*)heap_caps_malloc(bytes_read, MALLOC_CAP_SPIRAM);
-        if (!chunk_data) {
-            ESP_LOGE(TAG, "Failed to allocate memory for audio chunk");
-            break;
-        }
-        memcpy(chunk_data, buffer, bytes_read);
+        cache_writer.Write(buffer, bytes_read);
+        audio_ring_.CommitWrite(bytes_read);
+        total_downloaded += bytes_read;
+        total_print_bytes += bytes_read;
         
-        // Wait for buffer space
-        {
-            std::unique_lock<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.wait(lock, [this] { return buffer_size_ < MAX_BUFFER_SIZE || !is_downloading_; });
-            
-            if (is_downloading_) {
-                audio_buffer_.push(AudioChunk(chunk_data, bytes_read));
-                buffer_size_ += bytes_read;
-                total_downloaded += bytes_read;
-                total_print_bytes += bytes_read;
-                
-                // Notify playback thread of new data
-                buffer_cv_.notify_one();
-                
-                if (total_print_bytes >= (128 * 1024)) {  // Log progress every 128KB
-                    total_print_bytes = 0;
-                    ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, buffer_size_);
-                }
-            } else {
-                heap_caps_free(chunk_data);
-                break;
-            }
+        if (total_print_bytes >= (128 * 1024)) {  // Log progress every 128KB
+            total_print_bytes = 0;
+            ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, audio_ring_.size());
         }
     }
-    delete[] buffer;
     
     http->Close();
 
+    if (completed) {
+        cache_writer.Commit();
+    }
+
     if (is_downloading_) {
         ESP_LOGI(TAG, "Audio stream download finished successfully, total downloaded: %d bytes", total_downloaded);
     } else {
@@ -884,11 +907,8 @@ void Esp32Music::DownloadAudioStream(const std::string& music_url) {
     
     is_downloading_ = false;
     
-    // Notify playback thread that download is complete
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    // Let the playback thread drain the rest of the buffer
+    audio_ring_.FinishWriting();
     
     ESP_LOGI(TAG, "Audio stream download thread finished");
 }
@@ -901,6 +921,13 @@ void Esp32Music::PlayAudioStream() {
     current_play_time_ms_ = 0;
     last_frame_time_ms_ = 0;
     total_frames_decoded_ = 0;
+    output_played_us_ = 0;
+    
+    // Force a lookup of the first lyric line
+    lyric_timeline_.reset();
+    lyric_timeline_version_ = lyrics_version_.load() - 1;
+    lyric_line_start_ms_ = 0;
+    lyric_line_end_ms_ = 0;
     
     auto codec = Board::GetInstance().GetAudioCodec();
     if (!codec) {
@@ -919,29 +946,11 @@ void Esp32Music::PlayAudioStream() {
         InitializeMp3Decoder();
     }
     
-    // Wait for the buffer to have enough data to start playback
-    {
-        std::unique_lock<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.wait(lock, [this] { 
-            return buffer_size_ >= MIN_BUFFER_SIZE || (!is_downloading_ && !audio_buffer_.empty()); 
-        });
-    }
-    
-    ESP_LOGI(TAG, "Starting playback with buffer size: %d", buffer_size_);
-    
+    // The ring holds playback back until the start watermark is buffered
     size_t total_played_bytes = 0;
     size_t total_print_bytes = 0;
-    uint8_t* mp3_input_buffer = nullptr;
-    int bytes_left = 0;
-    uint8_t* read_ptr = nullptr;
-    
-    // Allocate MP3 input buffer
-    mp3_input_buffer = (uint8_t*)heap_caps_malloc(8192, MALLOC_CAP_SPIRAM);
-    if (!mp3_input_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate MP3 input buffer");
-        is_playing_ = false;
-        return;
-    }
+    size_t id3_remaining = 0;
+    bool byte_rate_known = false;
     
     // Flag to indicate if ID3 tags have been processed
     bool id3_processed = false;
@@ -951,7 +960,6 @@ void Esp32Music::PlayAudioStream() {
     int16_t* pcm_buffer = new int16_t[2304];  // Max PCM samples per MP3 frame
     if (!pcm_buffer) {
         ESP_LOGE(TAG, "Failed to allocate PCM buffer");
-        heap_caps_free(mp3_input_buffer);
         is_playing_ = false;
         return;
     }
@@ -1007,80 +1015,30 @@ void Esp32Music::PlayAudioStream() {
 			song_name_displayed_ = true;
 		}
         
-        // If more MP3 data is needed, read from the buffer
-        if (bytes_left < 4096) {  // Maintain at least 4KB of data for decoding
-            AudioChunk chunk;
-            
-            // Retrieve audio data from the buffer
-            {
-                std::unique_lock<std::mutex> lock(buffer_mutex_);
-                if (audio_buffer_.empty()) {
-                    if (!is_downloading_) {
-                        // Download complete and buffer empty, playback ends
-                        ESP_LOGI(TAG, "Playback finished, total played: %d bytes", total_played_bytes);
-                        break;
-                    }
-                    // Wait for new data
-                    buffer_cv_.wait(lock, [this] { return !audio_buffer_.empty() || !is_downloading_; });
-                    if (audio_buffer_.empty()) {
-                        continue;
-                    }
-                }
-                
-                chunk = audio_buffer_.front();
-                audio_buffer_.pop();
-                buffer_size_ -= chunk.size;
-                total_played_bytes += chunk.size;
-                total_print_bytes += chunk.size;
-                
-                // Notify download thread that buffer has space
-                buffer_cv_.notify_one();
-            }
-            
-            // Add new data to the MP3 input buffer
-            if (chunk.data && chunk.size > 0) {
-                // Move remaining data to the beginning of the buffer
-                if (bytes_left > 0 && read_ptr != mp3_input_buffer) {
-                    memmove(mp3_input_buffer, read_ptr, bytes_left);
-                }
-                
-                // Check buffer space
-                size_t space_available = 8192 - bytes_left;
-                size_t copy_size = std::min(chunk.size, space_available);
-                
-                // Copy new data
-                memcpy(mp3_input_buffer + bytes_left, chunk.data, copy_size);
-                bytes_left += copy_size;
-                read_ptr = mp3_input_buffer;
-                
-                // Check and skip ID3 tags (allow multi-chunk ID3 skipping)
-				if (!id3_processed && bytes_left >= 10)
-				{
-					size_t id3_skip = SkipId3Tag(read_ptr, bytes_left);
-					if (id3_skip > 0) {
-
-						// skip ID3 part in current buffer
-						read_ptr += id3_skip;
-						bytes_left -= id3_skip;
-
-						ESP_LOGI(TAG, "Skipped ID3 tag: %u bytes", (unsigned int)id3_skip);
-
-						// If ID3 header is larger than buffer, wait for next chunk
-						if (bytes_left < 256) {
-							ESP_LOGW(TAG, "Remaining buffer too small after ID3 skip, waiting for next chunk");
-							bytes_left = 0;
-							continue;   // pump next incoming data
-						}
-					}
-
-					// Mark as processed ONLY when buffer seems OK (≥ sync possible)
-					if (bytes_left >= 256) {
-						id3_processed = true;
-					}
-				}
-								
-                // Free chunk memory
-                heap_caps_free(chunk.data);
+        // Decode straight out of the stream ring, spans never wrap
+        const uint8_t* span = nullptr;
+        size_t span_size = audio_ring_.AcquireRead(span, 4096);  // At least 4KB for a full frame
+        if (span_size == 0) {
+            // Download complete and buffer empty (or aborted), playback ends
+            ESP_LOGI(TAG, "Playback finished, total played: %d bytes", total_played_bytes);
+            break;
+        }
+        uint8_t* read_ptr = const_cast<uint8_t*>(span);
+        int bytes_left = span_size;
+        
+        // Skip ID3 tags, a tag (cover art) can span many reads
+        if (id3_remaining > 0) {
+            size_t skip = std::min(id3_remaining, span_size);
+            audio_ring_.CommitRead(skip);
+            id3_remaining -= skip;
+            continue;
+        }
+        if (!id3_processed && bytes_left >= 10) {
+            id3_processed = true;
+            id3_remaining = SkipId3Tag(read_ptr, bytes_left);
+            if (id3_remaining > 0) {
+                ESP_LOGI(TAG, "Skipped ID3 tag: %u bytes", (unsigned int)id3_remaining);
+                continue;
             }
         }
         
@@ -1088,28 +1046,42 @@ void Esp32Music::PlayAudioStream() {
         int sync_offset = MP3FindSyncWord(read_ptr, bytes_left);
         if (sync_offset < 0) {
             ESP_LOGW(TAG, "No MP3 sync word found, skipping %d bytes", bytes_left);
+            audio_ring_.CommitRead(bytes_left);
             vTaskDelay(pdMS_TO_TICKS(2));
-			bytes_left = 0;
             continue;
         }
         
-		if (bytes_left < 128) {            
-			vTaskDelay(pdMS_TO_TICKS(2));
-			continue;
-		}
-
-        // Skip to sync position
+        // Skip to sync position, the next span then starts with a whole frame
         if (sync_offset > 0) {
-            read_ptr += sync_offset;
-            bytes_left -= sync_offset;
+            audio_ring_.CommitRead(sync_offset);
+            continue;
+        }
+        
+        // Drop a truncated tail at the end of the stream
+        if (bytes_left < 128 && audio_ring_.writer_finished()) {
+            audio_ring_.CommitRead(bytes_left);
+            continue;
         }
         
         // Decode MP3 frame
         int decode_result = MP3Decode(mp3_decoder_, &read_ptr, &bytes_left, pcm_buffer, 0);
+        size_t consumed = read_ptr - span;
+        if (decode_result != 0 && bytes_left > 0) {
+            consumed++;  // Skip a byte and resync
+        }
+        audio_ring_.CommitRead(consumed);
+        total_played_bytes += consumed;
+        total_print_bytes += consumed;
         
         if (decode_result == 0) {
             // Decode successful, get frame info
             MP3GetLastFrameInfo(mp3_decoder_, &mp3_frame_info_);
+            
+            // Rebuffer watermarks follow the real bitrate from now on
+            if (!byte_rate_known && mp3_frame_info_.bitrate > 0) {
+                audio_ring_.SetByteRate(mp3_frame_info_.bitrate / 8);
+                byte_rate_known = true;
+            }
 			
 			// ---- SONG INFO DISPLAY ----
 			if (!full_info_displayed_) {
@@ -1161,10 +1133,6 @@ void Esp32Music::PlayAudioStream() {
                     total_frames_decoded_, current_play_time_ms_, frame_duration_ms,
                     mp3_frame_info_.samprate, mp3_frame_info_.nChans);
             
-            // Update lyric display
-            int buffer_latency_ms = 600; // Adjusted based on testing
-            UpdateLyricDisplay(current_play_time_ms_ + buffer_latency_ms);
-            
             // Send PCM data to the Application's audio decoding queue
             if (mp3_frame_info_.outputSamps > 0) {
                 int16_t* final_pcm_data = pcm_buffer;
@@ -1224,26 +1192,26 @@ void Esp32Music::PlayAudioStream() {
                         final_sample_count, pcm_size_bytes, mp3_frame_info_.samprate, mp3_frame_info_.nChans);
                 
                 // Send to Application's audio decoding queue
-                app.AddAudioData(std::move(packet));
+                if (app.AddAudioData(std::move(packet))) {
+                    output_played_us_ += (int64_t)final_sample_count * 1000000 / mp3_frame_info_.samprate;
+                }
+                
+                // The codec write returns once the PCM is queued for I2S DMA, so the
+                // speaker is behind by what the DMA buffers hold
+                int output_latency_ms = AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM * 1000 /
+                                        std::max(codec->output_sample_rate(), 1);
+                UpdateLyricDisplay(output_played_us_ / 1000 - output_latency_ms);
                 
                 // Log playback progress
                 if (total_print_bytes >= (128 * 1024)) {
                     total_print_bytes = 0;
-                    ESP_LOGI(TAG, "Played %d bytes, buffer size: %d", total_played_bytes, buffer_size_);
+                    ESP_LOGI(TAG, "Played %d bytes, buffer size: %d", total_played_bytes, audio_ring_.size());
                 }
             }
             
         } else {
-            // Decode failed
+            // Decode failed, one byte was skipped above
             ESP_LOGW(TAG, "MP3 decode failed with error: %d", decode_result);
-            
-            // Skip some bytes and continue
-            if (bytes_left > 1) {
-                read_ptr++;
-                bytes_left--;
-            } else {
-                bytes_left = 0;
-            }
 			vTaskDelay(pdMS_TO_TICKS(2));  
 			continue;
         }
@@ -1252,6 +1220,10 @@ void Esp32Music::PlayAudioStream() {
     // Free PCM buffer
     delete[] pcm_buffer;
 
+    auto stats = audio_ring_.GetStats();
+    ESP_LOGI(TAG, "Stream stats: startup %lu ms, %lu stalls (%lu ms), refill %lu B/s, %u bytes received",
+            stats.startup_ms, stats.stalls, stats.stall_ms, stats.refill_bytes_per_sec, stats.bytes_in);
+
     if (is_playing_) {
         ESP_LOGI(TAG, "Audio stream playback finished successfully, total played: %d bytes", total_played_bytes);
         ClearAudioBuffer();
@@ -1261,11 +1233,6 @@ void Esp32Music::PlayAudioStream() {
         ESP_LOGI(TAG, "Audio stream playback stopped by user, total played: %d bytes", total_played_bytes);
     }
 
-    // Cleanup
-        if (mp3_input_buffer) {
-        heap_caps_free(mp3_input_buffer);
-    }
-    
     ESP_LOGI(TAG, "Audio stream playback finished, total played: %d bytes", total_played_bytes);
     ESP_LOGI(TAG, "Performing basic cleanup from play thread");
     
@@ -1288,8 +1255,7 @@ void Esp32Music::PlayAudioStream() {
         }
     }
 	final_pcm_data_fft = nullptr;
-	ClearAudioBuffer();
-	buffer_size_ = 0;
+	audio_ring_.Abort();  // Unblocks the download thread, the next stream resets the ring
 	CleanupMp3Decoder();
 
 	// Bật lại output để radio dùng
@@ -1301,17 +1267,7 @@ void Esp32Music::PlayAudioStream() {
 
 // Clear audio buffer
 void Esp32Music::ClearAudioBuffer() {
-    std::lock_guard<std::mutex> lock(buffer_mutex_);
-    
-    while (!audio_buffer_.empty()) {
-        AudioChunk chunk = audio_buffer_.front();
-        audio_buffer_.pop();
-        if (chunk.data) {
-            heap_caps_free(chunk.data);
-        }
-    }
-    
-    buffer_size_ = 0;
+    audio_ring_.Reset();
     ESP_LOGI(TAG, "Audio buffer cleared");
 }
 
@@ -1410,14 +1366,8 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
             std::this_thread::sleep_for(std::chrono::milliseconds(500));
         }
         
-        // Use the HTTP client provided by the Board
-        auto network = Board::GetInstance().GetNetwork();
-        auto http = network->CreateHttp(0);
-        if (!http) {
-            ESP_LOGE(TAG, "Failed to create HTTP client for lyric download");
-            retry_count++;
-            continue;
-        }
+        // Usually reuses the connection of the stream request to the same server
+        auto http = std::make_unique<PooledHttp>();
         
         // Set basic request headers
         http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
@@ -1438,12 +1388,23 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
         int status_code = http->GetStatusCode();
         ESP_LOGI(TAG, "Lyric download HTTP status code: %d", status_code);
         
-        // Handle redirects - Since the Http class does not have a GetHeader method, we can only report the redirect
+        // Handle redirects
         if (status_code == 301 || status_code == 302 || status_code == 303 || status_code == 307 || status_code == 308) {
-            // 由于无法获取Location头，只能报告重定向但无法继续
-            ESP_LOGW(TAG, "Received redirect status %d but cannot follow redirect (no GetHeader method)", status_code);
+            std::string location = http->GetResponseHeader("Location");
             http->Close();
-            retry_count++;
+            if (location.empty()) {
+                ESP_LOGW(TAG, "Received redirect status %d without a Location header", status_code);
+                retry_count++;
+                continue;
+            }
+            if (location[0] == '/') {
+                // Relative redirect, keep scheme and host
+                size_t host_end = current_url.find('/', current_url.find("://") + 3);
+                location = current_url.substr(0, host_end) + location;
+            }
+            ESP_LOGI(TAG, "Following redirect %d to %s", status_code, location.c_str());
+            current_url = location;
+            redirect_count++;
             continue;
         }
         
@@ -1534,93 +1495,11 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
 bool Esp32Music::ParseLyrics(const std::string& lyric_content) {
     ESP_LOGI(TAG, "Parsing lyrics content");
     
-    // Use a lock to protect access to the lyrics_ array
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    lyrics_.clear();
-    
-    // Split the lyric content by lines
-    std::istringstream stream(lyric_content);
-    std::string line;
-    
-    while (std::getline(stream, line)) {
-        // Remove carriage return at the end of the line
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        
-        // Skip empty lines
-        if (line.empty()) {
-            continue;
-        }
-        
-        // Parse LRC format: [mm:ss.xx]Lyric text
-        if (line.length() > 10 && line[0] == '[') {
-            size_t close_bracket = line.find(']');
-            if (close_bracket != std::string::npos) {
-                std::string tag_or_time = line.substr(1, close_bracket - 1);
-                std::string content = line.substr(close_bracket + 1);
-                
-                // Check if it's metadata instead of a timestamp
-                // Metadata tags are usually [ti:Title], [ar:Artist], [al:Album], etc.
-                size_t colon_pos = tag_or_time.find(':');
-                if (colon_pos != std::string::npos) {
-                    std::string left_part = tag_or_time.substr(0, colon_pos);
-                    
-                    // Check if the left part of the colon is a time (numeric)
-                    bool is_time_format = true;
-                    for (char c : left_part) {
-                        if (!isdigit(c)) {
-                            is_time_format = false;
-                            break;
-                        }
-                    }
-                    
-                    // If it's not a time format, skip this line (metadata tag)
-                    if (!is_time_format) {
-                        // Metadata like title, artist, etc., can be processed here
-                        ESP_LOGD(TAG, "Skipping metadata tag: [%s]", tag_or_time.c_str());
-                        continue;
-                    }
-                    
-                    // It's a time format, parse the timestamp
-                    try {
-                        int minutes = std::stoi(tag_or_time.substr(0, colon_pos));
-                        float seconds = std::stof(tag_or_time.substr(colon_pos + 1));
-                        int timestamp_ms = minutes * 60 * 1000 + (int)(seconds * 1000);
-                        
-                        // Safely handle lyric text, ensuring proper UTF-8 encoding
-                        std::string safe_lyric_text;
-                        if (!content.empty()) {
-                            // Create a safe copy and validate the string
-                            safe_lyric_text = content;
-                            // Ensure the string is null-terminated
-                            safe_lyric_text.shrink_to_fit();
-                        }
-                        
-                        lyrics_.push_back(std::make_pair(timestamp_ms, safe_lyric_text));
-                        
-                        if (!safe_lyric_text.empty()) {
-                            // Limit log output length to avoid truncation issues with non-ASCII characters
-                            size_t log_len = std::min(safe_lyric_text.length(), size_t(50));
-                            std::string log_text = safe_lyric_text.substr(0, log_len);
-                            ESP_LOGD(TAG, "Parsed lyric: [%d ms] %s", timestamp_ms, log_text.c_str());
-                        } else {
-                            ESP_LOGD(TAG, "Parsed lyric: [%d ms] (empty)", timestamp_ms);
-                        }
-                    } catch (const std::exception& e) {
-                        ESP_LOGW(TAG, "Failed to parse time: %s", tag_or_time.c_str());
-                    }
-                }
-            }
-        }
-    }
-    
-    // Sort by timestamp
-    std::sort(lyrics_.begin(), lyrics_.end());
-    
-    ESP_LOGI(TAG, "Parsed %d lyric lines", lyrics_.size());
-    return !lyrics_.empty();
+    // The timeline is built here and never changed again, the playback thread reads it without locking
+    auto timeline = LyricTimeline::Parse(lyric_content);
+    bool has_lyrics = !timeline->empty();
+    SetLyrics(std::move(timeline));
+    return has_lyrics;
 }
 
 // Lyric display thread
@@ -1641,52 +1520,55 @@ void Esp32Music::LyricDisplayThread() {
     ESP_LOGI(TAG, "Lyric display thread finished");
 }
 
-void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
+void Esp32Music::SetLyrics(std::shared_ptr<const LyricTimeline> timeline) {
     std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    if (lyrics_.empty()) {
+    lyrics_ = std::move(timeline);
+    lyrics_version_++;
+}
+
+// Called by the playback thread for every frame, only does work when the line changes
+void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
+    uint32_t version = lyrics_version_.load();
+    if (version != lyric_timeline_version_) {
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        lyric_timeline_ = lyrics_;
+        lyric_timeline_version_ = lyrics_version_.load();
+        lyric_line_start_ms_ = 0;
+        lyric_line_end_ms_ = 0;
+        current_lyric_index_ = -1;
+    } else if (current_time_ms >= lyric_line_start_ms_ && current_time_ms < lyric_line_end_ms_) {
         return;
     }
     
-    // Find the current lyric to display
-    int new_lyric_index = -1;
-    
-    // Start searching from the current lyric index to improve efficiency
-    int start_index = (current_lyric_index_.load() >= 0) ? current_lyric_index_.load() : 0;
-    
-    // Forward search: find the last timestamp less than or equal to the current time
-    for (int i = start_index; i < (int)lyrics_.size(); i++) {
-        if (lyrics_[i].first <= current_time_ms) {
-            new_lyric_index = i;
-        } else {
-            break;  // Timestamp exceeds the current time
-        }
+    auto timeline = lyric_timeline_;
+    if (!timeline || timeline->empty()) {
+        return;
     }
     
-    // If no lyric is found (e.g., current time is earlier than the first lyric), display nothing
-    if (new_lyric_index == -1) {
-        new_lyric_index = -1;
-    }
+    int new_lyric_index = timeline->Find(current_time_ms);
+    lyric_line_start_ms_ = timeline->LineStart(new_lyric_index);
+    lyric_line_end_ms_ = timeline->LineEnd(new_lyric_index);
     
     // If the lyric index has changed, update the display
     if (new_lyric_index != current_lyric_index_) {
         current_lyric_index_ = new_lyric_index;
         
-        auto& board = Board::GetInstance();
-        auto display = board.GetDisplay();
+        auto display = Board::GetInstance().GetDisplay();
         if (display) {
+            // Before the first line nothing is displayed
             std::string lyric_text;
-            
-            if (current_lyric_index_ >= 0 && current_lyric_index_ < (int)lyrics_.size()) {
-                lyric_text = lyrics_[current_lyric_index_].second;
+            if (new_lyric_index >= 0) {
+                lyric_text = timeline->line(new_lyric_index).text;
             }
             
-            // Display the lyric
-            display->SetChatMessage("lyric", lyric_text.c_str());
-            
             ESP_LOGD(TAG, "Lyric update at %lldms: %s", 
                     current_time_ms, 
                     lyric_text.empty() ? "(no lyric)" : lyric_text.c_str());
+            
+            // Render on the main task, a newer line replaces one that was not shown yet
+            Application::GetInstance().Schedule([display, lyric_text]() {
+                display->SetChatMessage("lyric", lyric_text.c_str());
+            }, kSchedulePriorityLow, "lyric");
         }
     }
 }
@@ -4,27 +4,20 @@
 #include <string>
 #include <thread>
 #include <atomic>
-#include <queue>
 #include <mutex>
-#include <condition_variable>
 #include <vector>
+#include <memory>
 
 #include "music.h"
+#include "stream_ring_buffer.h"
+#include "song_cache.h"
+#include "lyric_timeline.h"
 
 // MP3 decoder support
 extern "C" {
 #include "mp3dec.h"
 }
 
-// Audio data chunk structure
-struct AudioChunk {
-    uint8_t* data;
-    size_t size;
-    
-    AudioChunk() : data(nullptr), size(0) {}
-    AudioChunk(uint8_t* d, size_t s) : data(d), size(s) {}
-};
-
 class Esp32Music : public Music {
 public:
     // Display mode control - moved to public section
@@ -45,8 +38,9 @@ private:
     
     // Lyrics-related
     std::string current_lyric_url_;
-    std::vector<std::pair<int, std::string>> lyrics_;  // Timestamp and lyric text
-    std::mutex lyrics_mutex_;  // Mutex to protect the lyrics_ array
+    std::shared_ptr<const LyricTimeline> lyrics_;  // Published by the lyric thread
+    std::mutex lyrics_mutex_;  // Mutex to protect the lyrics_ pointer
+    std::atomic<uint32_t> lyrics_version_{0};  // Bumped whenever lyrics_ changes
     std::atomic<int> current_lyric_index_;
     std::thread lyric_thread_;
     std::atomic<bool> is_lyric_running_;
@@ -59,14 +53,18 @@ private:
     int64_t current_play_time_ms_;  // Current playback time (milliseconds)
     int64_t last_frame_time_ms_;    // Timestamp of the last frame
     int total_frames_decoded_;      // Total number of decoded frames
+    int64_t output_played_us_;      // Audio accepted by the codec (microseconds)
+
+    // Playback thread's copy of the lyrics and the time range of the line on screen
+    std::shared_ptr<const LyricTimeline> lyric_timeline_;
+    uint32_t lyric_timeline_version_ = 0;
+    int64_t lyric_line_start_ms_ = 0;
+    int64_t lyric_line_end_ms_ = 0;
 
-    // Audio buffer
-    std::queue<AudioChunk> audio_buffer_;
-    std::mutex buffer_mutex_;
-    std::condition_variable buffer_cv_;
-    size_t buffer_size_;
-    static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;  // 256KB buffer (reduced to minimize brownout risk)
-    static constexpr size_t MIN_BUFFER_SIZE = 32 * 1024;   // 32KB minimum playback buffer (reduced to minimize brownout risk)
+    // Compressed stream between the download and playback threads
+    StreamRingBuffer audio_ring_;
+    // What the next StartStreaming() call tees into the SD song cache
+    SongCache::Source next_cache_source_;
     
     // MP3 decoder-related
     HMP3Decoder mp3_decoder_;
@@ -74,7 +72,8 @@ private:
     bool mp3_decoder_initialized_;
     
     // Private methods
-    void DownloadAudioStream(const std::string& music_url);
+    void DownloadAudioStream(const std::string& music_url, SongCache::Source cache_source);
+    bool PlayCachedSong(const SongCache::Entry& entry, const std::string& path);
     void PlayAudioStream();
     void ClearAudioBuffer();
     bool InitializeMp3Decoder();
@@ -85,6 +84,7 @@ private:
     bool DownloadLyrics(const std::string& lyric_url);
     bool ParseLyrics(const std::string& lyric_content);
     void LyricDisplayThread();
+    void SetLyrics(std::shared_ptr<const LyricTimeline> timeline);
     void UpdateLyricDisplay(int64_t current_time_ms);
     
     // ID3 tag handling
@@ -105,7 +105,7 @@ public:
     // New methods
     virtual bool StartStreaming(const std::string& music_url) override;
     virtual bool StopStreaming() override;  // Stop streaming playback
-    virtual size_t GetBufferSize() const override { return buffer_size_; }
+    virtual size_t GetBufferSize() const override { return audio_ring_.size(); }
     virtual bool IsDownloading() const override { return is_downloading_; }
     virtual int16_t* GetAudioData() override { return final_pcm_data_fft; }
     bool IsPlaying() const { return is_playing_; }  // Check if music is currently playing
@@ -1,4 +1,5 @@
 #include "esp32_radio.h"
+#include "http_pool.h"
 #include "board.h"
 #include "system_info.h"
 #include "audio/audio_codec.h"
@@ -26,8 +27,8 @@
 Esp32Radio::Esp32Radio() : current_station_name_(), current_station_url_(),
                          station_name_displayed_(false), current_station_volume_(4.5f), radio_stations_(),
                          display_mode_(DISPLAY_MODE_SPECTRUM), is_playing_(false), is_downloading_(false), 
-                         play_thread_(), download_thread_(), audio_buffer_(), buffer_mutex_(), 
-                         buffer_cv_(), buffer_size_(0), aac_decoder_(nullptr), aac_info_(),
+                         play_thread_(), download_thread_(),
+                         audio_ring_(CONFIG_MUSIC_STREAM_BUFFER_MS, CONFIG_MUSIC_STREAM_START_MS), aac_decoder_(nullptr), aac_info_(),
                          aac_decoder_initialized_(false), aac_info_ready_(false), aac_out_buffer_() {
 }
 
@@ -39,10 +40,7 @@ Esp32Radio::~Esp32Radio() {
     is_playing_ = false;
     
     // Notify all waiting threads
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    audio_ring_.Abort();
     
     // Wait for the download thread to finish
     if (download_thread_.joinable()) {
@@ -223,7 +221,10 @@ bool Esp32Radio::PlayUrl(const std::string& radio_url, const std::string& statio
         current_station_volume_ = 4.5f;  // Default volume for custom URLs
     }
     
-    // Clear the buffer
+    // Clear the buffer, the ring itself is allocated once and reused for every station
+    if (!audio_ring_.Allocate()) {
+        return false;
+    }
     ClearAudioBuffer();
     
     // Configure thread stack size
@@ -276,10 +277,7 @@ bool Esp32Radio::Stop() {
     }
     
     // Notify all waiting threads
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    audio_ring_.Abort();
     
     // Wait for threads to finish
     if (download_thread_.joinable()) {
@@ -319,8 +317,7 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
         return;
     }
 
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
+    auto http = std::make_unique<PooledHttp>();
 
     http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
     http->SetHeader("Accept", "*/*");
@@ -331,19 +328,29 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
 
     auto display = Board::GetInstance().GetDisplay();
 
-    if (!http->Open("GET", radio_url)) {
-        ESP_LOGE(TAG, "Failed to connect to radio stream URL: %s", radio_url.c_str());
-        is_downloading_ = false;
-        if (display) display->SetMusicInfo("Radio connection error");
-        return;
-    }
-
-    int status_code = http->GetStatusCode();
-    if (status_code >= 300 && status_code < 400) {
-        ESP_LOGW(TAG, "HTTP %d redirect detected but cannot follow", status_code);
+    // Station URLs often redirect to a load balanced stream server
+    std::string stream_url = radio_url;
+    int status_code = 0;
+    for (int redirects = 0; ; redirects++) {
+        if (!http->Open("GET", stream_url)) {
+            ESP_LOGE(TAG, "Failed to connect to radio stream URL: %s", stream_url.c_str());
+            is_downloading_ = false;
+            if (display) display->SetMusicInfo("Radio connection error");
+            return;
+        }
+        status_code = http->GetStatusCode();
+        if (status_code < 300 || status_code >= 400) {
+            break;
+        }
+        std::string location = http->GetResponseHeader("Location");
         http->Close();
-        is_downloading_ = false;
-        return;
+        if (location.empty() || location.find("http") != 0 || redirects >= 3) {
+            ESP_LOGW(TAG, "HTTP %d redirect cannot be followed (Location: %s)", status_code, location.c_str());
+            is_downloading_ = false;
+            return;
+        }
+        ESP_LOGI(TAG, "Following redirect %d to %s", status_code, location.c_str());
+        stream_url = location;
     }
     if (status_code != 200 && status_code != 206) {
         ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
@@ -354,15 +361,19 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
 
     ESP_LOGI(TAG, "Started downloading radio stream, status: %d", status_code);
 
-    const size_t chunk_size = 4096;
-    char* buffer = new char[chunk_size];
     size_t total_downloaded = 0;
     size_t total_print_bytes = 0;
     const int kMaxReconnectAttempts = 3;
     int reconnect_attempts = 0;
 
     while (is_downloading_ && is_playing_) {
-        int bytes_read = http->Read(buffer, chunk_size);
+        // Receive straight into the stream ring
+        uint8_t* buffer = nullptr;
+        size_t space = audio_ring_.AcquireWrite(buffer);
+        if (space == 0) {
+            break;  // Aborted
+        }
+        int bytes_read = http->Read((char*)buffer, space);
 
         // ---- HANDLE READ ERRORS & RECONNECT ----
         if (bytes_read < 0 || bytes_read == 0) {
@@ -381,7 +392,7 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
             vTaskDelay(pdMS_TO_TICKS(1500));  // Wait 1.5s
             http->Close();
 
-            if (!http->Open("GET", radio_url)) {
+            if (!http->Open("GET", stream_url)) {
                 ESP_LOGE(TAG, "Reconnect failed at attempt %d", reconnect_attempts);
                 continue;
             } else {
@@ -399,7 +410,7 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
         if (total_downloaded == 0 && bytes_read >= 4) {
             if (memcmp(buffer, "ID3", 3) == 0) {
                 ESP_LOGI(TAG, "Detected MP3 with ID3 tag");
-            } else if ((buffer[0] & 0xFF) == 0xFF && (buffer[1] & 0xE0) == 0xE0) {
+            } else if (buffer[0] == 0xFF && (buffer[1] & 0xE0) == 0xE0) {
                 ESP_LOGI(TAG, "Detected MP3 file header");
             } else if (memcmp(buffer, "RIFF", 4) == 0) {
                 ESP_LOGI(TAG, "Detected WAV");
@@ -409,41 +420,20 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
                 ESP_LOGI(TAG, "Detected OGG");
             } else {
                 ESP_LOGI(TAG, "Unknown format, first 4 bytes: %02X %02X %02X %02X",
-                         (unsigned char)buffer[0], (unsigned char)buffer[1],
-                         (unsigned char)buffer[2], (unsigned char)buffer[3]);
+                         buffer[0], buffer[1], buffer[2], buffer[3]);
             }
         }
 
-        uint8_t* chunk_data = (uint8_t*)heap_caps_malloc(bytes_read, MALLOC_CAP_SPIRAM);
-        if (!chunk_data) {
-            ESP_LOGE(TAG, "Failed to allocate memory for radio chunk");
-            break;
-        }
-        memcpy(chunk_data, buffer, bytes_read);
-
-        {
-            std::unique_lock<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.wait(lock, [this] { return buffer_size_ < MAX_BUFFER_SIZE || !is_downloading_; });
+        audio_ring_.CommitWrite(bytes_read);
+        total_downloaded += bytes_read;
+        total_print_bytes += bytes_read;
 
-            if (is_downloading_) {
-                audio_buffer_.push(RadioAudioChunk(chunk_data, bytes_read));
-                buffer_size_ += bytes_read;
-                total_downloaded += bytes_read;
-                total_print_bytes += bytes_read;
-                buffer_cv_.notify_one();
-
-                if (total_print_bytes >= (128 * 1024)) {
-                    total_print_bytes = 0;
-                    ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, buffer_size_);
-                }
-            } else {
-                heap_caps_free(chunk_data);
-                break;
-            }
+        if (total_print_bytes >= (128 * 1024)) {
+            total_print_bytes = 0;
+            ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, audio_ring_.size());
         }
     }
 
-    delete[] buffer;
     http->Close();
 
     if (is_downloading_) {
@@ -453,11 +443,7 @@ void Esp32Radio::DownloadRadioStream(const std::string& radio_url) {
     }
 
     is_downloading_ = false;
-
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    audio_ring_.FinishWriting();
 
     if (total_downloaded < 1024 && display) {
         display->SetMusicInfo("❌ Không thể kết nối radio.");
@@ -488,29 +474,10 @@ void Esp32Radio::PlayRadioStream() {
         return;
     }
     
-    // Wait for the buffer to have enough data to start playback
-    {
-        std::unique_lock<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.wait(lock, [this] { 
-            return buffer_size_ >= MIN_BUFFER_SIZE || (!is_downloading_ && !audio_buffer_.empty()); 
-        });
-    }
-    
-    ESP_LOGI(TAG, "Starting radio playback with buffer size: %d", buffer_size_);
-    
+    // The ring holds playback back until the start watermark is buffered
     size_t total_played_bytes = 0;
     size_t total_print_bytes = 0;
-    uint8_t* input_buffer = nullptr;
-    int bytes_left = 0;
-    uint8_t* read_ptr = nullptr;
-    
-    // Allocate input buffer (for both MP3 and AAC)
-    input_buffer = (uint8_t*)heap_caps_malloc(4096, MALLOC_CAP_SPIRAM);
-    if (!input_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate input buffer");
-        is_playing_ = false;
-        return;
-    }
+    bool byte_rate_known = false;
 
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
@@ -559,69 +526,22 @@ void Esp32Radio::PlayRadioStream() {
 			}
 		}
 								
-        // If more audio data is needed, read from the buffer
-        if (bytes_left < 4096) {
-            RadioAudioChunk chunk;
-            
-            // Retrieve audio data from the buffer
-            {
-                std::unique_lock<std::mutex> lock(buffer_mutex_);
-                if (audio_buffer_.empty()) {
-                    if (!is_downloading_) {
-                        ESP_LOGI(TAG, "Radio stream ended, total played: %d bytes", total_played_bytes);
-                        break;
-                    }
-                    // Wait for new data
-                    buffer_cv_.wait(lock, [this] { return !audio_buffer_.empty() || !is_downloading_; });
-                    if (audio_buffer_.empty()) {
-                        continue;
-                    }
-                }
-                
-                chunk = audio_buffer_.front();
-                audio_buffer_.pop();
-                buffer_size_ -= chunk.size;
-                total_played_bytes += chunk.size;
-                total_print_bytes += chunk.size;
-                
-                // Notify download thread that buffer has space
-                buffer_cv_.notify_one();
-            }
-            
-            // Add new data to the input buffer
-            if (chunk.data && chunk.size > 0) {
-                // Move remaining data to the beginning of the buffer
-                if (bytes_left > 0 && read_ptr != input_buffer) {
-                    memmove(input_buffer, read_ptr, bytes_left);
-                }
-                
-                // Check buffer space
-                size_t space_available = 8192 - bytes_left;
-                size_t copy_size = std::min(chunk.size, space_available);
-                
-                // Copy new data
-                memcpy(input_buffer + bytes_left, chunk.data, copy_size);
-                bytes_left += copy_size;
-                read_ptr = input_buffer;
-                
-                // AAC streams don't need ID3 tag processing
-                
-                // Free chunk memory
-                heap_caps_free(chunk.data);
-            }
+        // Decode straight out of the stream ring, spans never wrap
+        const uint8_t* span = nullptr;
+        size_t span_size = audio_ring_.AcquireRead(span, 4096);
+        if (span_size == 0) {
+            ESP_LOGI(TAG, "Radio stream ended, total played: %d bytes", total_played_bytes);
+            break;
         }
-        
+
         // AAC DECODER for VOV streams
         // === AAC DECODER PATH ===
-        if (bytes_left <= 0) {
-            continue; // Need more data
-        }
-        
-        bool input_eos = (!is_downloading_ && audio_buffer_.empty());
+        // The writer only finishes once, after that the ring just drains
+        bool input_eos = audio_ring_.writer_finished() && span_size == audio_ring_.size();
         
         esp_audio_simple_dec_raw_t raw = {};
-        raw.buffer = read_ptr;
-        raw.len = bytes_left;
+        raw.buffer = const_cast<uint8_t*>(span);
+        raw.len = span_size;
         raw.eos = input_eos;
         
         esp_audio_simple_dec_out_t out_frame = {};
@@ -655,6 +575,12 @@ void Esp32Radio::PlayRadioStream() {
 							 aac_info_.bits_per_sample,
 							 aac_info_.channel);
 
+					// Rebuffer watermarks follow the real bitrate from now on
+					if (!byte_rate_known && aac_info_.bitrate > 0) {
+						audio_ring_.SetByteRate(aac_info_.bitrate / 8);
+						byte_rate_known = true;
+					}
+
 					// ===============================
 					//   HIỂN THỊ THÔNG TIN AAC LÊN LCD
 					// ===============================
@@ -745,30 +671,36 @@ void Esp32Radio::PlayRadioStream() {
                 
                 if (total_print_bytes >= (128 * 1024)) {
                     total_print_bytes = 0;
-                    ESP_LOGI(TAG, "AAC: Played %d bytes, buffer size: %d", total_played_bytes, buffer_size_);
+                    ESP_LOGI(TAG, "AAC: Played %d bytes, buffer size: %d", total_played_bytes, audio_ring_.size());
                 }
             }
             
+            // A partial frame at the end of the span waits for the next read
+            if (raw.consumed == 0 && out_frame.decoded_size == 0) {
+                break;
+            }
+            
             // Update input pointer based on consumed bytes
             raw.len -= raw.consumed;
             raw.buffer += raw.consumed;
         }
         
-        // Update read_ptr and bytes_left for main loop
-        bytes_left = raw.len;
-        read_ptr = const_cast<uint8_t*>(raw.buffer);
+        // Release what the decoder consumed, a partial frame stays in the ring
+        size_t consumed = span_size - raw.len;
+        audio_ring_.CommitRead(consumed);
+        total_played_bytes += consumed;
+        total_print_bytes += consumed;
         
         // Check for end of stream
-        if (input_eos && bytes_left == 0) {
+        if (input_eos && raw.len == 0) {
             ESP_LOGI(TAG, "AAC radio stream ended");
             break;
         }
     }
     
-    // Cleanup
-    if (input_buffer) {
-        heap_caps_free(input_buffer);
-    }
+    auto stats = audio_ring_.GetStats();
+    ESP_LOGI(TAG, "Stream stats: startup %lu ms, %lu stalls (%lu ms), refill %lu B/s, %u bytes received",
+            stats.startup_ms, stats.stalls, stats.stall_ms, stats.refill_bytes_per_sec, stats.bytes_in);
     
     if (is_playing_) {
         ESP_LOGI(TAG, "Radio stream playback finished successfully");
@@ -784,6 +716,7 @@ void Esp32Radio::PlayRadioStream() {
 
     ESP_LOGI(TAG, "Radio stream playback finished, total played: %d bytes", total_played_bytes);
     is_playing_ = false;
+    audio_ring_.Abort();  // Unblocks the download thread, the next station resets the ring
     
     // Stop FFT display
     if (display_mode_ == DISPLAY_MODE_SPECTRUM) {
@@ -796,17 +729,7 @@ void Esp32Radio::PlayRadioStream() {
 }
 
 void Esp32Radio::ClearAudioBuffer() {
-    std::lock_guard<std::mutex> lock(buffer_mutex_);
-    
-    while (!audio_buffer_.empty()) {
-        RadioAudioChunk chunk = audio_buffer_.front();
-        audio_buffer_.pop();
-        if (chunk.data) {
-            heap_caps_free(chunk.data);
-        }
-    }
-    
-    buffer_size_ = 0;
+    audio_ring_.Reset();
     ESP_LOGI(TAG, "Radio audio buffer cleared");
 }
 
@@ -4,13 +4,11 @@
 #include <string>
 #include <thread>
 #include <atomic>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
 #include <vector>
 #include <map>
 
 #include "radio.h"
+#include "stream_ring_buffer.h"
 
 // AAC Simple Decoder for VOV radio streams
 // VOV URLs return audio/aacp format which requires AAC decoder
@@ -18,15 +16,6 @@ extern "C" {
 #include "esp_audio_simple_dec_default.h"
 }
 
-// Audio data chunk structure
-struct RadioAudioChunk {
-    uint8_t* data;
-    size_t size;
-    
-    RadioAudioChunk() : data(nullptr), size(0) {}
-    RadioAudioChunk(uint8_t* d, size_t s) : data(d), size(s) {}
-};
-
 // Radio station information structure
 struct RadioStation {
     std::string name;        // Radio station name
@@ -63,13 +52,8 @@ private:
     std::thread play_thread_;
     std::thread download_thread_;
     
-    // Audio buffer
-    std::queue<RadioAudioChunk> audio_buffer_;
-    std::mutex buffer_mutex_;
-    std::condition_variable buffer_cv_;
-    size_t buffer_size_;
-    static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;  // 256KB buffer
-    static constexpr size_t MIN_BUFFER_SIZE = 32 * 1024;   // 32KB minimum playback buffer
+    // Compressed stream between the download and playback threads
+    StreamRingBuffer audio_ring_;
     
     // AAC Simple Decoder for VOV radio streams
     esp_audio_simple_dec_handle_t aac_decoder_;
@@ -115,7 +99,7 @@ public:
     virtual std::string GetCurrentStation() const override { return current_station_name_; }
     
     // Buffer status
-    virtual size_t GetBufferSize() const override { return buffer_size_; }
+    virtual size_t GetBufferSize() const override { return audio_ring_.size(); }
     virtual bool IsDownloading() const override { return is_downloading_; }
     virtual int16_t* GetAudioData() override { return final_pcm_data_fft; }
     
@@ -1036,22 +1036,6 @@ void Esp32SdMusic::repeat(RepeatMode mode)
 
 bool Esp32SdMusic::play()
 {
-    {
-        std::lock_guard<std::mutex> lock(playlist_mutex_);
-
-        if (playlist_.empty()) {
-            ESP_LOGW(TAG, "Playlist empty — reloading");
-            loadTrackList();
-            if (playlist_.empty()) {
-                ESP_LOGE(TAG, "No MP3 files found on SD");
-                return false;
-            }
-        }
-
-        if (current_index_ < 0)
-            current_index_ = 0;
-    }
-
     if (state_.load() == PlayerState::Paused) {
         ESP_LOGI(TAG, "Resuming playback");
         pause_requested_ = false;
@@ -1067,8 +1051,14 @@ bool Esp32SdMusic::play()
         if (display) {
             // Restore track info on display
             std::lock_guard<std::mutex> lock(playlist_mutex_);
-            if (current_index_ >= 0 && current_index_ < (int)playlist_.size()) {
-                const auto& track = playlist_[current_index_];
+            const TrackInfo* current = nullptr;
+            if (external_track_active_) {
+                current = &external_track_;
+            } else if (current_index_ >= 0 && current_index_ < (int)playlist_.size()) {
+                current = &playlist_[current_index_];
+            }
+            if (current) {
+                const auto& track = *current;
                 std::string title = !track.title.empty() ? track.title : track.name;
                 std::string line = !track.artist.empty() ? (track.artist + " - " + title) : title;
                 display->SetMusicInfo(line.c_str());
@@ -1079,6 +1069,41 @@ bool Esp32SdMusic::play()
         return true;
     }
 
+    {
+        std::lock_guard<std::mutex> lock(playlist_mutex_);
+
+        if (playlist_.empty()) {
+            ESP_LOGW(TAG, "Playlist empty — reloading");
+            loadTrackList();
+            if (playlist_.empty()) {
+                ESP_LOGE(TAG, "No MP3 files found on SD");
+                return false;
+            }
+        }
+
+        if (current_index_ < 0)
+            current_index_ = 0;
+
+        external_track_active_ = false;
+    }
+
+    return startPlaybackThread();
+}
+
+bool Esp32SdMusic::playFile(const TrackInfo& track)
+{
+    {
+        std::lock_guard<std::mutex> lock(playlist_mutex_);
+        external_track_ = track;
+        external_track_active_ = true;
+    }
+
+    ESP_LOGI(TAG, "Play file outside playlist: %s", track.path.c_str());
+    return startPlaybackThread();
+}
+
+bool Esp32SdMusic::startPlaybackThread()
+{
     {
         std::lock_guard<std::mutex> lk(state_mutex_);
         stop_requested_ = true;
@@ -1235,17 +1260,24 @@ void Esp32SdMusic::playbackThreadFunc()
 {
     TrackInfo track;
     int play_index = -1;
+    bool external = false;
     {
         std::lock_guard<std::mutex> lock(playlist_mutex_);
 
-        if (current_index_ < 0 || current_index_ >= (int)playlist_.size()) {
-            ESP_LOGE(TAG, "Invalid current track index");
-            state_.store(PlayerState::Error);
-            return;
-        }
+        if (external_track_active_) {
+            // File ngoài playlist: không ghi lịch sử, không chuyển bài
+            track = external_track_;
+            external = true;
+        } else {
+            if (current_index_ < 0 || current_index_ >= (int)playlist_.size()) {
+                ESP_LOGE(TAG, "Invalid current track index");
+                state_.store(PlayerState::Error);
+                return;
+            }
 
-        track = playlist_[current_index_];
-        play_index = current_index_;
+            track = playlist_[current_index_];
+            play_index = current_index_;
+        }
     }
 
     recordPlayHistory(play_index);
@@ -1301,6 +1333,11 @@ void Esp32SdMusic::playbackThreadFunc()
     }
 
     ESP_LOGI(TAG, "Playback finished normally: %s", track.name.c_str());
+
+    if (external) {
+        state_.store(PlayerState::Stopped);
+        return;
+    }
 	
 	// Ưu tiên chuyển bài theo genre nếu đang bật
 	if (!genre_playlist_.empty()) {
@@ -107,6 +107,8 @@ public:
     bool playDirectory(const std::string& relative_dir); // Chọn + phát từ thư mục
 
     bool playByName(const std::string& keyword);   // Phát bài theo tên / từ khóa
+    // Tìm index theo keyword (tên hoặc đường dẫn), so khớp UTF-8, case-insensitive ASCII
+    int findTrackIndexByKeyword(const std::string& keyword) const;
     TrackInfo getTrackInfo(int index) const;       // Lấy thông tin bài theo index
     bool setTrack(int index);                      // Chọn bài theo index rồi play
 
@@ -143,6 +145,9 @@ public:
     bool next();       // Bài kế tiếp (hỗ trợ shuffle/repeat)
     bool prev();       // Bài trước đó
 
+    // Phát một file ngoài playlist (bài online đã cache trên thẻ), dừng khi hết bài
+    bool playFile(const TrackInfo& track);
+
     // ============================================================
     // 8) Playback Settings
     // ============================================================
@@ -198,12 +203,11 @@ private:
     bool resolveDirectoryRelative(const std::string& relative_dir,
                                   std::string& out_full);
 
-    // Tìm index theo keyword (tên hoặc đường dẫn), so khớp UTF-8, case-insensitive ASCII
-    int findTrackIndexByKeyword(const std::string& keyword) const;
 
     // ============================================================
     // Playback Thread
     // ============================================================
+    bool startPlaybackThread();             // Dừng thread cũ rồi phát bài đã chọn
     void playbackThreadFunc();              // Thread main loop
     bool decodeAndPlayFile(const TrackInfo& track);
 
@@ -232,6 +236,9 @@ private:
     std::vector<TrackInfo> playlist_;
     mutable std::mutex playlist_mutex_;
     int current_index_;
+    // Bài phát bằng playFile(), ưu tiên hơn current_index_ khi active
+    TrackInfo external_track_;
+    bool external_track_active_ = false;
     std::vector<uint32_t> play_count_;      // Đếm số lần phát từng bài
 	// Cache ID3 toàn bộ file đã từng thấy trong session (RAM only)
     std::unordered_map<std::string, TrackInfo> id3_cache_;
@@ -0,0 +1,564 @@
+#include "http_pool.h"
+#include "board.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+
+#define TAG "HttpPool"
+
+static std::string to_lower(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+    return str;
+}
+
+static std::string trim(const std::string& str) {
+    size_t start = str.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = str.find_last_not_of(" \t\r");
+    return str.substr(start, end - start + 1);
+}
+
+HttpConnection::~HttpConnection() {
+    {
+        // Wake a reader waiting for data
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        cv.notify_all();
+    }
+    if (tcp) {
+        tcp->Disconnect();
+        tcp.reset();
+    }
+    HttpPool::GetInstance().FreeConnectId(connect_id);
+}
+
+// ---------------------------------------------------------------------------
+// PooledHttp
+
+PooledHttp::~PooledHttp() {
+    Close();
+}
+
+void PooledHttp::SetHeader(const std::string& key, const std::string& value) {
+    // Connection management belongs to the pool
+    if (to_lower(key) == "connection") {
+        return;
+    }
+    for (auto& header : headers_) {
+        if (strcasecmp(header.first.c_str(), key.c_str()) == 0) {
+            header.second = value;
+            return;
+        }
+    }
+    headers_.emplace_back(key, value);
+}
+
+std::string PooledHttp::GetResponseHeader(const std::string& key) const {
+    auto it = response_headers_.find(to_lower(key));
+    return it != response_headers_.end() ? it->second : "";
+}
+
+bool PooledHttp::Open(const std::string& method, const std::string& url) {
+    Close();
+    method_ = method;
+    url_ = url;
+    body_read_ = 0;
+    range_start_ = 0;
+    for (auto& header : headers_) {
+        if (strcasecmp(header.first.c_str(), "Range") == 0 && header.second.compare(0, 6, "bytes=") == 0) {
+            range_start_ = strtoul(header.second.c_str() + 6, nullptr, 10);
+        }
+    }
+    return OpenRequest();
+}
+
+bool PooledHttp::OpenRequest() {
+    const std::string& url = url_;
+    const std::string& method = method_;
+    bool https;
+    size_t host_start;
+    if (url.compare(0, 8, "https://") == 0) {
+        https = true;
+        host_start = 8;
+    } else if (url.compare(0, 7, "http://") == 0) {
+        https = false;
+        host_start = 7;
+    } else {
+        ESP_LOGE(TAG, "Unsupported URL: %s", url.c_str());
+        return false;
+    }
+    size_t path_start = url.find_first_of("/?", host_start);
+    std::string authority = url.substr(host_start, path_start == std::string::npos ? std::string::npos : path_start - host_start);
+    std::string path = path_start == std::string::npos ? "/" : url.substr(path_start);
+    if (path[0] == '?') {
+        path = "/" + path;
+    }
+    std::string host = authority;
+    int port = https ? 443 : 80;
+    size_t colon = authority.rfind(':');
+    if (colon != std::string::npos) {
+        host = authority.substr(0, colon);
+        port = atoi(authority.c_str() + colon + 1);
+    }
+    if (host.empty() || port <= 0) {
+        ESP_LOGE(TAG, "Invalid URL: %s", url.c_str());
+        return false;
+    }
+
+    // A pooled connection may have been closed by the server just before we used it,
+    // retry once on a fresh connection in that case
+    for (int attempt = 0; attempt < 2; attempt++) {
+        connection_ = HttpPool::GetInstance().Acquire(https, host, port);
+        if (!connection_) {
+            return false;
+        }
+        reused_ = connection_->requests > 0;
+        connection_->requests++;
+        if (SendRequest(method, host, port, https, path) && ReadResponseHeaders(method)) {
+            return true;
+        }
+        connection_.reset();
+        if (!reused_) {
+            return false;
+        }
+        ESP_LOGW(TAG, "Pooled connection to %s:%d went stale, reconnecting", host.c_str(), port);
+    }
+    return false;
+}
+
+bool PooledHttp::SendRequest(const std::string& method, const std::string& host, int port, bool https, const std::string& path) {
+    std::string request = method + " " + path + " HTTP/1.1\r\n";
+    request += "Host: " + host;
+    if (port != (https ? 443 : 80)) {
+        request += ":" + std::to_string(port);
+    }
+    request += "\r\n";
+    for (auto& header : headers_) {
+        request += header.first + ": " + header.second + "\r\n";
+    }
+    request += "Connection: keep-alive\r\n\r\n";
+    return connection_->tcp->Send(request) == (int)request.size();
+}
+
+bool PooledHttp::WaitForData(std::unique_lock<std::mutex>& lock) {
+    auto& conn = *connection_;
+    return conn.cv.wait_for(lock, std::chrono::milliseconds(HTTP_POOL_READ_TIMEOUT_MS), [&conn] {
+        return !conn.rx.empty() || conn.closed || conn.overflowed;
+    }) && !conn.rx.empty();
+}
+
+// The reader fell behind and the connection dropped data, continue on a new connection
+// from the first byte that was not read
+bool PooledHttp::ResumeBody() {
+    if (body_mode_ != kBodyLength || (status_code_ != 200 && status_code_ != 206)) {
+        ESP_LOGE(TAG, "Reader fell behind on a body that can not be resumed");
+        return false;
+    }
+    size_t offset = range_start_ + body_read_;
+    size_t remaining = remaining_;
+    int status_code = status_code_;
+    size_t body_length = body_length_;
+    ESP_LOGW(TAG, "Reader fell behind, resuming %s at byte %u", url_.c_str(), offset);
+
+    connection_.reset();
+    SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+    if (!OpenRequest()) {
+        return false;
+    }
+    if (status_code_ != 206 || body_mode_ != kBodyLength || remaining_ != remaining) {
+        ESP_LOGE(TAG, "Server did not resume at byte %u (status %d, %u bytes)", offset, status_code_, remaining_);
+        return false;
+    }
+    // Callers keep seeing the original response
+    status_code_ = status_code;
+    body_length_ = body_length;
+    return true;
+}
+
+bool PooledHttp::ReadLine(std::unique_lock<std::mutex>& lock, std::string& line) {
+    auto& conn = *connection_;
+    size_t searched = 0;
+    while (true) {
+        size_t end = conn.rx.find("\r\n", searched);
+        if (end != std::string::npos) {
+            line = conn.rx.substr(0, end);
+            conn.rx.erase(0, end + 2);
+            return true;
+        }
+        searched = conn.rx.empty() ? 0 : conn.rx.size() - 1;
+        if (conn.closed || conn.overflowed) {
+            return false;
+        }
+        size_t size = conn.rx.size();
+        if (!conn.cv.wait_for(lock, std::chrono::milliseconds(HTTP_POOL_READ_TIMEOUT_MS), [&conn, size] {
+            return conn.rx.size() > size || conn.closed || conn.overflowed;
+        })) {
+            ESP_LOGE(TAG, "Timed out waiting for the response");
+            return false;
+        }
+    }
+}
+
+bool PooledHttp::ReadResponseHeaders(const std::string& method) {
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    std::string line;
+    do {
+        // Skip interim 1xx responses
+        response_headers_.clear();
+        if (!ReadLine(lock, line)) {
+            return false;
+        }
+        // HTTP/1.1 200 OK, or ICY 200 OK from SHOUTcast radio servers
+        if (line.compare(0, 5, "HTTP/") == 0 && line.size() >= 12) {
+            keep_alive_ = line.compare(0, 8, "HTTP/1.1") == 0;
+            status_code_ = atoi(line.c_str() + 9);
+        } else if (line.compare(0, 4, "ICY ") == 0) {
+            keep_alive_ = false;
+            status_code_ = atoi(line.c_str() + 4);
+        } else {
+            ESP_LOGE(TAG, "Invalid status line: %s", line.c_str());
+            return false;
+        }
+        while (true) {
+            if (!ReadLine(lock, line)) {
+                return false;
+            }
+            if (line.empty()) {
+                break;
+            }
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                response_headers_[to_lower(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+            }
+        }
+    } while (status_code_ >= 100 && status_code_ < 200);
+
+    std::string connection = to_lower(GetResponseHeader("Connection"));
+    if (connection == "close") {
+        keep_alive_ = false;
+    } else if (connection == "keep-alive") {
+        keep_alive_ = true;
+    }
+
+    body_length_ = 0;
+    remaining_ = 0;
+    chunk_crlf_pending_ = false;
+    body_done_ = false;
+    std::string content_length = GetResponseHeader("Content-Length");
+    if (method == "HEAD" || status_code_ == 204 || status_code_ == 304) {
+        body_mode_ = kBodyNone;
+        body_done_ = true;
+    } else if (to_lower(GetResponseHeader("Transfer-Encoding")).find("chunked") != std::string::npos) {
+        body_mode_ = kBodyChunked;
+    } else if (!content_length.empty()) {
+        body_mode_ = kBodyLength;
+        body_length_ = strtoul(content_length.c_str(), nullptr, 10);
+        remaining_ = body_length_;
+        body_done_ = body_length_ == 0;
+    } else {
+        // Endless radio streams and HTTP/1.0 servers end the body by closing the socket
+        body_mode_ = kBodyUntilClose;
+        keep_alive_ = false;
+    }
+    return true;
+}
+
+bool PooledHttp::ReadChunkHeader(std::unique_lock<std::mutex>& lock) {
+    std::string line;
+    if (chunk_crlf_pending_) {
+        if (!ReadLine(lock, line)) {
+            return false;
+        }
+        chunk_crlf_pending_ = false;
+    }
+    if (!ReadLine(lock, line)) {
+        return false;
+    }
+    remaining_ = strtoul(line.c_str(), nullptr, 16);
+    if (remaining_ == 0) {
+        // Skip trailers up to the empty line that ends the message
+        do {
+            if (!ReadLine(lock, line)) {
+                return false;
+            }
+        } while (!line.empty());
+        body_done_ = true;
+    }
+    chunk_crlf_pending_ = true;
+    return true;
+}
+
+int PooledHttp::Read(char* buffer, size_t buffer_size) {
+    if (!connection_) {
+        return -1;
+    }
+    if (body_done_) {
+        return 0;
+    }
+
+    std::unique_lock<std::mutex> lock(connection_->mutex);
+    if (body_mode_ == kBodyChunked && remaining_ == 0) {
+        if (!ReadChunkHeader(lock)) {
+            return -1;
+        }
+        if (body_done_) {
+            return 0;
+        }
+    }
+
+    if (!WaitForData(lock)) {
+        if (connection_->overflowed) {
+            lock.unlock();
+            if (!ResumeBody()) {
+                return -1;
+            }
+            return Read(buffer, buffer_size);
+        }
+        if (connection_->closed && body_mode_ == kBodyUntilClose) {
+            body_done_ = true;
+            return 0;
+        }
+        ESP_LOGE(TAG, "%s", connection_->closed ? "Connection closed before the end of the body" : "Timed out reading the body");
+        return -1;
+    }
+
+    auto& rx = connection_->rx;
+    size_t n = std::min(buffer_size, rx.size());
+    if (body_mode_ != kBodyUntilClose) {
+        n = std::min(n, remaining_);
+    }
+    memcpy(buffer, rx.data(), n);
+    rx.erase(0, n);
+    body_read_ += n;
+
+    if (body_mode_ != kBodyUntilClose) {
+        remaining_ -= n;
+        if (body_mode_ == kBodyLength && remaining_ == 0) {
+            body_done_ = true;
+        }
+    }
+    return n;
+}
+
+std::string PooledHttp::ReadAll() {
+    std::string body;
+    if (body_length_ > 0) {
+        body.reserve(body_length_);
+    }
+    char buffer[1024];
+    int n;
+    while ((n = Read(buffer, sizeof(buffer))) > 0) {
+        body.append(buffer, n);
+    }
+    return body;
+}
+
+void PooledHttp::Close() {
+    if (!connection_) {
+        return;
+    }
+    // Small unread bodies (error pages) are drained so the connection stays usable
+    if (!body_done_ && keep_alive_ && body_mode_ == kBodyLength && remaining_ <= 4096) {
+        char buffer[256];
+        while (Read(buffer, sizeof(buffer)) > 0) {
+        }
+    }
+    bool reusable = keep_alive_ && body_done_;
+    if (reusable) {
+        std::lock_guard<std::mutex> lock(connection_->mutex);
+        reusable = !connection_->closed && !connection_->overflowed && connection_->rx.empty();
+    }
+    HttpPool::GetInstance().Release(std::move(connection_), reusable);
+    status_code_ = -1;
+    body_length_ = 0;
+    body_mode_ = kBodyNone;
+    response_headers_.clear();
+}
+
+// ---------------------------------------------------------------------------
+// HttpPool
+
+int HttpPool::AllocateConnectId() {
+    for (int i = 0; i < HTTP_POOL_CONNECT_ID_COUNT; i++) {
+        if ((busy_connect_ids_ & (1 << i)) == 0) {
+            busy_connect_ids_ |= 1 << i;
+            return HTTP_POOL_FIRST_CONNECT_ID + i;
+        }
+    }
+    return -1;
+}
+
+void HttpPool::FreeConnectId(int connect_id) {
+    int i = connect_id - HTTP_POOL_FIRST_CONNECT_ID;
+    if (i >= 0 && i < HTTP_POOL_CONNECT_ID_COUNT) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        busy_connect_ids_ &= ~(1 << i);
+    }
+}
+
+std::unique_ptr<HttpConnection> HttpPool::Acquire(bool https, const std::string& host, int port) {
+    std::string key = (https ? "https://" : "http://") + host + ":" + std::to_string(port);
+    std::unique_ptr<HttpConnection> connection;
+    std::vector<std::unique_ptr<HttpConnection>> expired;
+    int connect_id = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        for (auto it = idle_.begin(); it != idle_.end();) {
+            bool closed;
+            {
+                std::lock_guard<std::mutex> conn_lock((*it)->mutex);
+                closed = (*it)->closed || (*it)->overflowed || !(*it)->rx.empty();
+            }
+            if (closed || now - (*it)->idle_since_us > HTTP_POOL_IDLE_TIMEOUT_MS * 1000LL) {
+                expired.push_back(std::move(*it));
+                it = idle_.erase(it);
+            } else if (!connection && (*it)->key == key) {
+                connection = std::move(*it);
+                it = idle_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (connection) {
+            connections_reused_++;
+        } else {
+            connect_id = AllocateConnectId();
+            if (connect_id < 0 && !idle_.empty()) {
+                // All ids are parked on idle connections to other hosts, close the oldest
+                expired.push_back(std::move(idle_.front()));
+                idle_.erase(idle_.begin());
+            }
+        }
+    }
+    // Disconnect outside the lock, the destructor gives the connect id back
+    expired.clear();
+    if (connection) {
+        ESP_LOGI(TAG, "Reusing connection to %s (request %d)", key.c_str(), connection->requests + 1);
+        return connection;
+    }
+    if (connect_id < 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connect_id = AllocateConnectId();
+    }
+    if (connect_id < 0) {
+        ESP_LOGW(TAG, "No free pool connect id, using the default one");
+    }
+
+    connection = std::make_unique<HttpConnection>();
+    connection->key = key;
+    connection->connect_id = connect_id;
+    auto network = Board::GetInstance().GetNetwork();
+    connection->tcp = https ? network->CreateSsl(connect_id) : network->CreateTcp(connect_id);
+    if (!connection->tcp) {
+        ESP_LOGE(TAG, "Failed to create connection to %s", key.c_str());
+        return nullptr;
+    }
+    HttpConnection* conn = connection.get();
+    connection->tcp->OnStream([conn](const std::string& data) {
+        // Never wait here, the network task may also serve other connections
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        if (conn->closed || conn->overflowed) {
+            return;
+        }
+        if (conn->rx.size() + data.size() > HTTP_POOL_RX_LIMIT) {
+            conn->overflowed = true;
+        } else {
+            conn->rx.append(data);
+        }
+        conn->cv.notify_all();
+    });
+    connection->tcp->OnDisconnected([conn]() {
+        std::lock_guard<std::mutex> lock(conn->mutex);
+        conn->closed = true;
+        conn->cv.notify_all();
+    });
+
+    // TLS needs the host name for SNI and certificate checks
+    std::string address = https ? host : Resolve(host);
+    int64_t start_time = esp_timer_get_time();
+    if (!connection->tcp->Connect(address, port)) {
+        ESP_LOGE(TAG, "Failed to connect to %s", key.c_str());
+        return nullptr;
+    }
+    size_t opened, reused;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        opened = ++connections_opened_;
+        reused = connections_reused_;
+    }
+    ESP_LOGI(TAG, "Connected to %s in %d ms (%u opened, %u reused)", key.c_str(),
+        (int)((esp_timer_get_time() - start_time) / 1000), opened, reused);
+    return connection;
+}
+
+void HttpPool::Release(std::unique_ptr<HttpConnection> connection, bool reusable) {
+    if (!reusable) {
+        return;
+    }
+    std::unique_ptr<HttpConnection> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection->idle_since_us = esp_timer_get_time();
+        if (idle_.size() >= HTTP_POOL_MAX_IDLE) {
+            evicted = std::move(idle_.front());
+            idle_.erase(idle_.begin());
+        }
+        idle_.push_back(std::move(connection));
+    }
+}
+
+void HttpPool::Clear() {
+    std::vector<std::unique_ptr<HttpConnection>> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        idle.swap(idle_);
+        dns_cache_.clear();
+    }
+}
+
+std::string HttpPool::Resolve(const std::string& host) {
+    struct in_addr addr;
+    if (inet_pton(AF_INET, host.c_str(), &addr) == 1) {
+        return host;
+    }
+    // Cellular modules resolve names on the module, lwIP has no route there
+    if (Board::GetInstance().GetBoardType() != "wifi") {
+        return host;
+    }
+
+    int64_t now = esp_timer_get_time();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = dns_cache_.find(host);
+        if (it != dns_cache_.end() && it->second.expires_us > now) {
+            return it->second.address;
+        }
+    }
+
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+        ESP_LOGW(TAG, "Failed to resolve %s", host.c_str());
+        return host;
+    }
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &((struct sockaddr_in*)result->ai_addr)->sin_addr, address, sizeof(address));
+    freeaddrinfo(result);
+    ESP_LOGI(TAG, "Resolved %s to %s in %d ms", host.c_str(), address, (int)((esp_timer_get_time() - now) / 1000));
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    dns_cache_[host] = { address, esp_timer_get_time() + HTTP_POOL_DNS_TTL_MS * 1000LL };
+    return address;
+}
@@ -0,0 +1,148 @@
+#ifndef HTTP_POOL_H
+#define HTTP_POOL_H
+
+#include <tcp.h>
+#include <sdkconfig.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#define HTTP_POOL_MAX_IDLE 2
+// Most servers drop idle keep-alive sockets after 15-60 seconds
+#define HTTP_POOL_IDLE_TIMEOUT_MS 15000
+#define HTTP_POOL_DNS_TTL_MS (5 * 60 * 1000)
+#define HTTP_POOL_READ_TIMEOUT_MS 15000
+// Connect ids 0-3 are taken by the protocol, OTA and camera clients (used by ML307 boards)
+#define HTTP_POOL_FIRST_CONNECT_ID 4
+#define HTTP_POOL_CONNECT_ID_COUNT 2
+// Received bytes held per connection. The stream callback never blocks (on ML307 boards the
+// network task is shared with the voice connection), data past this limit is dropped and
+// PooledHttp resumes a Content-Length body with a Range request once the buffer is read,
+// other bodies end with a read error (the radio player reconnects the live stream).
+#if CONFIG_SPIRAM
+#define HTTP_POOL_RX_LIMIT (128 * 1024)
+#else
+#define HTTP_POOL_RX_LIMIT (16 * 1024)
+#endif
+
+// One TCP/TLS connection, kept open between requests to the same host
+struct HttpConnection {
+    std::string key;            // scheme://host:port
+    int connect_id = 0;
+    std::unique_ptr<Tcp> tcp;
+    int requests = 0;
+    int64_t idle_since_us = 0;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::string rx;             // Received, not yet consumed
+    bool closed = false;
+    bool overflowed = false;    // Data was dropped after rx, the connection can not be reused
+
+    ~HttpConnection();
+};
+
+/*
+ * HTTP/1.1 client for the music, lyrics and radio requests.
+ *
+ * Mirrors the Http calls the players use, but asks for keep-alive and returns the
+ * connection to HttpPool when the body was read completely, so search -> stream -> lyrics
+ * against the same server pay for TCP/TLS setup once.
+ */
+class PooledHttp {
+public:
+    PooledHttp() = default;
+    ~PooledHttp();
+
+    void SetHeader(const std::string& key, const std::string& value);
+    bool Open(const std::string& method, const std::string& url);
+    void Close();
+    // Returns the number of bytes read, 0 at the end of the body and <0 on errors
+    int Read(char* buffer, size_t buffer_size);
+    std::string ReadAll();
+
+    int GetStatusCode() const { return status_code_; }
+    // Content-Length, 0 for chunked or close delimited bodies
+    size_t GetBodyLength() const { return body_length_; }
+    std::string GetResponseHeader(const std::string& key) const;
+    bool reused() const { return reused_; }
+
+private:
+    enum BodyMode {
+        kBodyNone,
+        kBodyLength,
+        kBodyChunked,
+        kBodyUntilClose,
+    };
+
+    std::vector<std::pair<std::string, std::string>> headers_;
+    std::string method_;
+    std::string url_;
+    size_t range_start_ = 0;    // From the caller's Range header
+    size_t body_read_ = 0;
+    std::unique_ptr<HttpConnection> connection_;
+    std::map<std::string, std::string> response_headers_;
+    int status_code_ = -1;
+    size_t body_length_ = 0;
+    BodyMode body_mode_ = kBodyNone;
+    size_t remaining_ = 0;      // Of the body or of the current chunk
+    bool chunk_crlf_pending_ = false;
+    bool body_done_ = false;
+    bool keep_alive_ = false;
+    bool reused_ = false;
+
+    bool OpenRequest();
+    bool ResumeBody();
+    bool SendRequest(const std::string& method, const std::string& host, int port, bool https, const std::string& path);
+    bool ReadResponseHeaders(const std::string& method);
+    bool ReadLine(std::unique_lock<std::mutex>& lock, std::string& line);
+    bool WaitForData(std::unique_lock<std::mutex>& lock);
+    bool ReadChunkHeader(std::unique_lock<std::mutex>& lock);
+};
+
+class HttpPool {
+public:
+    static HttpPool& GetInstance() {
+        static HttpPool instance;
+        return instance;
+    }
+
+    // Returns an idle connection to the host or opens a new one, nullptr if connecting failed
+    std::unique_ptr<HttpConnection> Acquire(bool https, const std::string& host, int port);
+    // Keeps a connection whose response was read completely for the next request
+    void Release(std::unique_ptr<HttpConnection> connection, bool reusable);
+    // Drops all idle connections, e.g. after the network changed
+    void Clear();
+
+    // Cached IPv4 address of a host, the host itself when it can not be resolved here
+    std::string Resolve(const std::string& host);
+
+private:
+    friend struct HttpConnection;
+
+    HttpPool() = default;
+    HttpPool(const HttpPool&) = delete;
+    HttpPool& operator=(const HttpPool&) = delete;
+
+    struct DnsEntry {
+        std::string address;
+        int64_t expires_us;
+    };
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<HttpConnection>> idle_;
+    std::map<std::string, DnsEntry> dns_cache_;
+    uint32_t busy_connect_ids_ = 0;
+    size_t connections_opened_ = 0;
+    size_t connections_reused_ = 0;
+
+    int AllocateConnectId();
+    void FreeConnectId(int connect_id);
+};
+
+#endif // HTTP_POOL_H
@@ -0,0 +1,142 @@
+#include "lyric_timeline.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#define TAG "LyricTimeline"
+
+static std::string Trim(const std::string& text) {
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+// mm:ss, mm:ss.x, mm:ss.xx, mm:ss.xxx or mm:ss:xx
+static bool ParseTimeTag(const std::string& tag, int64_t& time_ms) {
+    size_t colon = tag.find(':');
+    if (colon == 0 || colon == std::string::npos) {
+        return false;
+    }
+    int64_t minutes = 0;
+    for (size_t i = 0; i < colon; i++) {
+        if (tag[i] < '0' || tag[i] > '9') {
+            return false;
+        }
+        minutes = minutes * 10 + (tag[i] - '0');
+    }
+
+    size_t pos = colon + 1;
+    int64_t seconds = 0;
+    size_t digits = 0;
+    while (pos < tag.size() && tag[pos] >= '0' && tag[pos] <= '9') {
+        seconds = seconds * 10 + (tag[pos++] - '0');
+        digits++;
+    }
+    if (digits == 0) {
+        return false;
+    }
+
+    int64_t fraction_ms = 0;
+    if (pos < tag.size()) {
+        if (tag[pos] != '.' && tag[pos] != ':') {
+            return false;
+        }
+        pos++;
+        int64_t scale = 100;
+        while (pos < tag.size() && tag[pos] >= '0' && tag[pos] <= '9') {
+            fraction_ms += (tag[pos++] - '0') * scale;
+            scale /= 10;
+        }
+        if (pos != tag.size()) {
+            return false;
+        }
+    }
+
+    time_ms = (minutes * 60 + seconds) * 1000 + fraction_ms;
+    return true;
+}
+
+std::shared_ptr<const LyricTimeline> LyricTimeline::Parse(const std::string& lrc) {
+    auto timeline = std::make_shared<LyricTimeline>();
+    auto& lines = timeline->lines_;
+    std::vector<int64_t> times;
+
+    size_t start = 0;
+    // Skip a UTF-8 byte order mark
+    if (lrc.compare(0, 3, "\xEF\xBB\xBF") == 0) {
+        start = 3;
+    }
+    while (start < lrc.size()) {
+        size_t end = lrc.find('\n', start);
+        if (end == std::string::npos) {
+            end = lrc.size();
+        }
+        std::string line = lrc.substr(start, end - start);
+        start = end + 1;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        // Leading tags: time tags for the text that follows, or one metadata tag
+        times.clear();
+        size_t pos = 0;
+        while (pos < line.size() && line[pos] == '[') {
+            size_t close = line.find(']', pos);
+            if (close == std::string::npos) {
+                break;
+            }
+            std::string tag = line.substr(pos + 1, close - pos - 1);
+            int64_t time_ms;
+            if (ParseTimeTag(tag, time_ms)) {
+                times.push_back(time_ms);
+            } else if (times.empty() && tag.compare(0, 7, "offset:") == 0) {
+                timeline->offset_ms_ = atoi(tag.c_str() + 7);
+            } else if (times.empty()) {
+                ESP_LOGD(TAG, "Skipping metadata tag: [%s]", tag.c_str());
+            }
+            pos = close + 1;
+        }
+        if (times.empty()) {
+            continue;
+        }
+
+        // Empty text is kept, it clears the display at that time
+        std::string text = Trim(line.substr(pos));
+        for (int64_t time_ms : times) {
+            lines.push_back(Line{time_ms, text});
+        }
+    }
+
+    // A positive offset shows the lyrics earlier
+    for (auto& line : lines) {
+        line.time_ms = std::max<int64_t>(0, line.time_ms - timeline->offset_ms_);
+    }
+    // Lines with several time tags are out of order, equal times keep the file order
+    std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) {
+        return a.time_ms < b.time_ms;
+    });
+
+    ESP_LOGI(TAG, "Parsed %u lyric lines, offset %d ms", lines.size(), timeline->offset_ms_);
+    return timeline;
+}
+
+int LyricTimeline::Find(int64_t position_ms) const {
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), position_ms,
+        [](int64_t position, const Line& line) { return position < line.time_ms; });
+    return (int)(it - lines_.begin()) - 1;
+}
+
+int64_t LyricTimeline::LineStart(int index) const {
+    return index < 0 ? INT64_MIN : lines_[index].time_ms;
+}
+
+int64_t LyricTimeline::LineEnd(int index) const {
+    return index + 1 < (int)lines_.size() ? lines_[index + 1].time_ms : INT64_MAX;
+}
@@ -0,0 +1,42 @@
+#ifndef LYRIC_TIMELINE_H
+#define LYRIC_TIMELINE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+/*
+ * Parsed LRC lyrics, sorted by time and never modified after Parse().
+ *
+ * The lyric thread builds a timeline and publishes it as a shared pointer, the playback
+ * thread keeps its own reference and looks up the line for the output position with a
+ * binary search, without locking. Lines with several time tags ([00:12.00][01:30.50]) are
+ * expanded, [offset:+/-ms] is applied to every line.
+ */
+class LyricTimeline {
+public:
+    struct Line {
+        int64_t time_ms;
+        std::string text;   // Trimmed, ready for the display
+    };
+
+    static std::shared_ptr<const LyricTimeline> Parse(const std::string& lrc);
+
+    // Line shown at the position, -1 before the first line
+    int Find(int64_t position_ms) const;
+    // Time range of a line (index -1 is the time before the first line)
+    int64_t LineStart(int index) const;
+    int64_t LineEnd(int index) const;
+
+    const Line& line(size_t index) const { return lines_[index]; }
+    size_t size() const { return lines_.size(); }
+    bool empty() const { return lines_.empty(); }
+    int offset_ms() const { return offset_ms_; }
+
+private:
+    std::vector<Line> lines_;
+    int offset_ms_ = 0;
+};
+
+#endif // LYRIC_TIMELINE_H
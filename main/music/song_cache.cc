@@ -0,0 +1,423 @@
+#include "song_cache.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "SongCache"
+
+static std::string NormalizeName(const std::string& text) {
+    // Lowercase ASCII and collapse whitespace, UTF-8 bytes are kept as they are
+    std::string result;
+    result.reserve(text.size());
+    bool pending_space = false;
+    for (unsigned char c : text) {
+        if (std::isspace(c)) {
+            pending_space = !result.empty();
+            continue;
+        }
+        if (pending_space) {
+            result += ' ';
+            pending_space = false;
+        }
+        result += (char)std::tolower(c);
+    }
+    return result;
+}
+
+static uint32_t Fnv1a(const std::string& text) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 8.3 compatible name, the card may be mounted without long file name support
+static std::string CacheFileName(const SongCache::Source& source) {
+    std::string key = !source.audio_path.empty() ? source.audio_path : NormalizeName(source.song + "|" + source.artist);
+    char name[16];
+    snprintf(name, sizeof(name), "%08lx", (unsigned long)Fnv1a(key));
+    return std::string(name) + SONG_CACHE_EXT;
+}
+
+SongCache::Writer::Writer(const Source& source, size_t expected_size)
+    : source_(source), expected_size_(expected_size) {
+    auto& cache = SongCache::GetInstance();
+    if (!cache.enabled() || (source.audio_path.empty() && source.song.empty())) {
+        return;
+    }
+    if (expected_size > cache.capacity_) {
+        ESP_LOGI(TAG, "Song of %u bytes does not fit the cache", expected_size);
+        return;
+    }
+    temp_path_ = cache.TempPath(CacheFileName(source));
+    file_ = fopen(temp_path_.c_str(), "wb");
+    if (file_ == nullptr) {
+        ESP_LOGW(TAG, "Failed to create %s", temp_path_.c_str());
+        temp_path_.clear();
+    }
+}
+
+SongCache::Writer::~Writer() {
+    Discard();
+}
+
+void SongCache::Writer::Write(const void* data, size_t size) {
+    if (file_ == nullptr) {
+        return;
+    }
+    if (fwrite(data, 1, size, file_) != size) {
+        // Card full or removed, the stream itself keeps playing
+        ESP_LOGW(TAG, "Failed to write the cache file, not caching this song");
+        Discard();
+        return;
+    }
+    written_ += size;
+}
+
+bool SongCache::Writer::Commit() {
+    if (file_ == nullptr) {
+        return false;
+    }
+    bool ok = fclose(file_) == 0;
+    file_ = nullptr;
+    if (!ok || written_ == 0 || (expected_size_ != 0 && written_ != expected_size_)) {
+        ESP_LOGW(TAG, "Incomplete download (%u of %u bytes), not caching", written_, expected_size_);
+        Discard();
+        return false;
+    }
+    SongCache::GetInstance().Insert(source_, temp_path_, written_);
+    temp_path_.clear();
+    return true;
+}
+
+void SongCache::Writer::Discard() {
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+    if (!temp_path_.empty()) {
+        unlink(temp_path_.c_str());
+        temp_path_.clear();
+    }
+}
+
+void SongCache::Initialize(const std::string& mount_point) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = (uint64_t)CONFIG_MUSIC_SD_CACHE_MB * 1024 * 1024;
+    if (capacity_ == 0) {
+        ESP_LOGI(TAG, "Song cache disabled");
+        return;
+    }
+
+    std::string directory = mount_point + "/" SONG_CACHE_DIR;
+    if (mkdir(directory.c_str(), 0775) != 0 && errno != EEXIST) {
+        ESP_LOGE(TAG, "Failed to create %s", directory.c_str());
+        return;
+    }
+    directory_ = directory;
+    LoadIndexLocked();
+    ESP_LOGI(TAG, "Song cache: %u songs, %llu of %llu KB", entries_.size(), total_size_ / 1024, capacity_ / 1024);
+}
+
+bool SongCache::enabled() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !directory_.empty() && capacity_ > 0;
+}
+
+std::string SongCache::SongKey(const std::string& song, const std::string& artist) {
+    return "s:" + NormalizeName(song) + "|" + NormalizeName(artist);
+}
+
+std::string SongCache::PathKey(const std::string& audio_path) {
+    return "p:" + audio_path;
+}
+
+std::string SongCache::TempPath(const std::string& file) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return directory_ + "/" + file.substr(0, file.find('.')) + ".tmp";
+}
+
+bool SongCache::LookupSong(const std::string& song, const std::string& artist, Entry& entry, std::string& path) {
+    if (song.empty()) {
+        return false;
+    }
+    return Lookup(SongKey(song, artist), entry, path);
+}
+
+bool SongCache::LookupAudioPath(const std::string& audio_path, Entry& entry, std::string& path) {
+    if (audio_path.empty()) {
+        return false;
+    }
+    return Lookup(PathKey(audio_path), entry, path);
+}
+
+void SongCache::AddSongAlias(const std::string& audio_path, const std::string& song, const std::string& artist) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int index = FindEntry(PathKey(audio_path));
+    std::string key = SongKey(song, artist);
+    if (index < 0 || song.empty() || FindEntry(key) == index) {
+        return;
+    }
+    // A request now resolves to another song, the old alias is stale
+    int old_index = FindEntry(key);
+    if (old_index >= 0) {
+        auto& keys = entries_[old_index].keys;
+        keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+    }
+    entries_[index].keys.push_back(key);
+    SaveIndexLocked();
+}
+
+bool SongCache::Lookup(const std::string& key, Entry& entry, std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (directory_.empty()) {
+        return false;
+    }
+    int index = FindEntry(key);
+    if (index < 0) {
+        return false;
+    }
+
+    std::string file_path = directory_ + "/" + entries_[index].file;
+    struct stat st;
+    if (stat(file_path.c_str(), &st) != 0 || (size_t)st.st_size != entries_[index].size) {
+        ESP_LOGW(TAG, "Cached file %s is missing or truncated", file_path.c_str());
+        RemoveEntryLocked(index);
+        SaveIndexLocked();
+        return false;
+    }
+
+    entries_[index].last_used = ++use_sequence_;
+    SaveIndexLocked();
+    entry = entries_[index];
+    path = file_path;
+    return true;
+}
+
+int SongCache::FindEntry(const std::string& key) const {
+    for (size_t i = 0; i < entries_.size(); i++) {
+        const auto& keys = entries_[i].keys;
+        if (std::find(keys.begin(), keys.end(), key) != keys.end()) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void SongCache::Insert(const Source& source, const std::string& temp_path, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry entry;
+    entry.file = CacheFileName(source);
+    entry.title = !source.title.empty() ? source.title : source.song;
+    entry.artist = !source.title_artist.empty() ? source.title_artist : source.artist;
+    entry.size = size;
+    if (!source.audio_path.empty()) {
+        entry.keys.push_back(PathKey(source.audio_path));
+    }
+    if (!source.song.empty()) {
+        entry.keys.push_back(SongKey(source.song, source.artist));
+    }
+    if (!source.title.empty()) {
+        std::string key = SongKey(source.title, source.title_artist);
+        if (std::find(entry.keys.begin(), entry.keys.end(), key) == entry.keys.end()) {
+            entry.keys.push_back(key);
+        }
+    }
+
+    // Replaces an older copy of the same song and steals its aliases from other entries
+    for (size_t i = entries_.size(); i-- > 0;) {
+        if (entries_[i].file == entry.file) {
+            RemoveEntryLocked(i);
+            continue;
+        }
+        auto& keys = entries_[i].keys;
+        for (const auto& key : entry.keys) {
+            keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+        }
+    }
+
+    std::string file_path = directory_ + "/" + entry.file;
+    unlink(file_path.c_str());
+    if (rename(temp_path.c_str(), file_path.c_str()) != 0) {
+        ESP_LOGE(TAG, "Failed to move %s to %s", temp_path.c_str(), file_path.c_str());
+        unlink(temp_path.c_str());
+        return;
+    }
+
+    entry.last_used = ++use_sequence_;
+    entries_.push_back(entry);
+    total_size_ += size;
+    ESP_LOGI(TAG, "Cached '%s' (%u bytes) as %s", entry.title.c_str(), size, entry.file.c_str());
+
+    EvictLocked(entry.file);
+    SaveIndexLocked();
+}
+
+void SongCache::EvictLocked(const std::string& keep_file) {
+    while (total_size_ > capacity_) {
+        int oldest = -1;
+        for (size_t i = 0; i < entries_.size(); i++) {
+            if (entries_[i].file != keep_file &&
+                (oldest < 0 || entries_[i].last_used < entries_[oldest].last_used)) {
+                oldest = (int)i;
+            }
+        }
+        if (oldest < 0) {
+            break;
+        }
+        ESP_LOGI(TAG, "Evicting '%s' (%u bytes)", entries_[oldest].title.c_str(), entries_[oldest].size);
+        RemoveEntryLocked(oldest);
+    }
+}
+
+void SongCache::RemoveEntryLocked(size_t index) {
+    std::string file_path = directory_ + "/" + entries_[index].file;
+    unlink(file_path.c_str());
+    total_size_ -= std::min<uint64_t>(total_size_, entries_[index].size);
+    entries_.erase(entries_.begin() + index);
+}
+
+void SongCache::LoadIndexLocked() {
+    entries_.clear();
+    total_size_ = 0;
+    use_sequence_ = 0;
+
+    // The index is replaced by writing a temporary copy first, use it if the swap was cut short
+    std::string index_path = directory_ + "/" SONG_CACHE_INDEX_FILE;
+    FILE* fp = fopen(index_path.c_str(), "rb");
+    if (fp == nullptr) {
+        fp = fopen((directory_ + "/" SONG_CACHE_INDEX_TEMP).c_str(), "rb");
+    }
+    if (fp != nullptr) {
+        std::string content;
+        char buffer[512];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+            content.append(buffer, n);
+        }
+        fclose(fp);
+
+        cJSON* root = cJSON_Parse(content.c_str());
+        if (root == nullptr) {
+            ESP_LOGW(TAG, "Failed to parse the cache index, starting empty");
+        } else {
+            cJSON* sequence = cJSON_GetObjectItem(root, "sequence");
+            if (cJSON_IsNumber(sequence)) {
+                use_sequence_ = (uint32_t)sequence->valuedouble;
+            }
+            cJSON* item = nullptr;
+            cJSON_ArrayForEach(item, cJSON_GetObjectItem(root, "entries")) {
+                cJSON* file = cJSON_GetObjectItem(item, "file");
+                cJSON* title = cJSON_GetObjectItem(item, "title");
+                cJSON* artist = cJSON_GetObjectItem(item, "artist");
+                cJSON* size = cJSON_GetObjectItem(item, "size");
+                cJSON* used = cJSON_GetObjectItem(item, "used");
+                if (!cJSON_IsString(file) || !cJSON_IsNumber(size)) {
+                    continue;
+                }
+                Entry entry;
+                entry.file = file->valuestring;
+                entry.title = cJSON_IsString(title) ? title->valuestring : "";
+                entry.artist = cJSON_IsString(artist) ? artist->valuestring : "";
+                entry.size = (size_t)size->valuedouble;
+                entry.last_used = cJSON_IsNumber(used) ? (uint32_t)used->valuedouble : 0;
+                cJSON* key = nullptr;
+                cJSON_ArrayForEach(key, cJSON_GetObjectItem(item, "keys")) {
+                    if (cJSON_IsString(key)) {
+                        entry.keys.push_back(key->valuestring);
+                    }
+                }
+
+                struct stat st;
+                std::string file_path = directory_ + "/" + entry.file;
+                if (stat(file_path.c_str(), &st) != 0 || (size_t)st.st_size != entry.size) {
+                    ESP_LOGW(TAG, "Dropping missing cache entry %s", entry.file.c_str());
+                    continue;
+                }
+                use_sequence_ = std::max(use_sequence_, entry.last_used);
+                total_size_ += entry.size;
+                entries_.push_back(entry);
+            }
+            cJSON_Delete(root);
+        }
+    }
+
+    // Remove downloads that were cut off by a reboot and files the index lost track of
+    DIR* dir = opendir(directory_.c_str());
+    if (dir != nullptr) {
+        struct dirent* ent;
+        while ((ent = readdir(dir)) != nullptr) {
+            std::string name = ent->d_name;
+            if (name == "." || name == ".." || strcasecmp(name.c_str(), SONG_CACHE_INDEX_FILE) == 0 ||
+                strcasecmp(name.c_str(), SONG_CACHE_INDEX_TEMP) == 0) {
+                continue;
+            }
+            bool known = std::any_of(entries_.begin(), entries_.end(),
+                [&name](const Entry& entry) { return strcasecmp(entry.file.c_str(), name.c_str()) == 0; });
+            if (!known) {
+                ESP_LOGI(TAG, "Removing stray cache file %s", name.c_str());
+                unlink((directory_ + "/" + name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+
+    // The size cap may have been lowered since the last boot
+    EvictLocked("");
+    SaveIndexLocked();
+}
+
+void SongCache::SaveIndexLocked() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "sequence", use_sequence_);
+    cJSON* entries = cJSON_AddArrayToObject(root, "entries");
+    for (const auto& entry : entries_) {
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "file", entry.file.c_str());
+        cJSON_AddStringToObject(item, "title", entry.title.c_str());
+        cJSON_AddStringToObject(item, "artist", entry.artist.c_str());
+        cJSON_AddNumberToObject(item, "size", entry.size);
+        cJSON_AddNumberToObject(item, "used", entry.last_used);
+        cJSON* keys = cJSON_AddArrayToObject(item, "keys");
+        for (const auto& key : entry.keys) {
+            cJSON_AddItemToArray(keys, cJSON_CreateString(key.c_str()));
+        }
+        cJSON_AddItemToArray(entries, item);
+    }
+    char* json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (json == nullptr) {
+        return;
+    }
+
+    // FAT can not rename over an existing file, so write a copy and swap it in
+    std::string index_path = directory_ + "/" SONG_CACHE_INDEX_FILE;
+    std::string temp_path = directory_ + "/" SONG_CACHE_INDEX_TEMP;
+    FILE* fp = fopen(temp_path.c_str(), "wb");
+    if (fp == nullptr) {
+        ESP_LOGE(TAG, "Failed to write the cache index");
+        cJSON_free(json);
+        return;
+    }
+    size_t length = strlen(json);
+    bool ok = fwrite(json, 1, length, fp) == length;
+    ok = fclose(fp) == 0 && ok;
+    cJSON_free(json);
+    if (!ok) {
+        ESP_LOGE(TAG, "Failed to write the cache index");
+        unlink(temp_path.c_str());
+        return;
+    }
+    unlink(index_path.c_str());
+    rename(temp_path.c_str(), index_path.c_str());
+}
@@ -0,0 +1,109 @@
+#ifndef SONG_CACHE_H
+#define SONG_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+
+// Cache directory below the SD mount point, the files use a non-.mp3 extension so the
+// Esp32SdMusic playlist scan does not pick them up as local songs
+#define SONG_CACHE_DIR "mcache"
+#define SONG_CACHE_EXT ".sng"
+// 8.3 names, the default FATFS configuration has no long file name support
+#define SONG_CACHE_INDEX_FILE "index.jsn"
+#define SONG_CACHE_INDEX_TEMP "index.tmp"
+
+/*
+ * LRU cache of streamed songs on the SD card.
+ *
+ * Esp32Music tees the MP3 it downloads into a temporary file and commits it here when the
+ * whole body arrived. Entries are found by the song/artist the user asked for or by the
+ * server audio path, so a replay is played from the card by Esp32SdMusic without touching
+ * the network. The least recently played entries are deleted once the cache grows past
+ * CONFIG_MUSIC_SD_CACHE_MB.
+ */
+class SongCache {
+public:
+    struct Entry {
+        std::string file;           // Name inside the cache directory
+        std::string title;
+        std::string artist;
+        size_t size = 0;
+        uint32_t last_used = 0;     // Use sequence number, higher is more recent
+        std::vector<std::string> keys;
+    };
+
+    // What a download is cached under
+    struct Source {
+        std::string song;           // As requested by the user
+        std::string artist;
+        std::string audio_path;     // Server path of the stream, without the host
+        std::string title;          // As returned by the server
+        std::string title_artist;
+    };
+
+    // Tees one download into the cache, discarded unless Commit() is called
+    class Writer {
+    public:
+        Writer(const Source& source, size_t expected_size);
+        ~Writer();
+
+        bool active() const { return file_ != nullptr; }
+        void Write(const void* data, size_t size);
+        // The whole body was received, moves the file into the cache
+        bool Commit();
+
+    private:
+        Source source_;
+        std::string temp_path_;
+        FILE* file_ = nullptr;
+        size_t expected_size_;
+        size_t written_ = 0;
+
+        void Discard();
+    };
+
+    static SongCache& GetInstance() {
+        static SongCache instance;
+        return instance;
+    }
+
+    // Loads the index below the mount point of a mounted card
+    void Initialize(const std::string& mount_point);
+    bool enabled() const;
+
+    // Finds a cached song and marks it as used, fills the absolute path of the file
+    bool LookupSong(const std::string& song, const std::string& artist, Entry& entry, std::string& path);
+    bool LookupAudioPath(const std::string& audio_path, Entry& entry, std::string& path);
+    // Makes a later LookupSong() for this request find the entry of an audio path
+    void AddSongAlias(const std::string& audio_path, const std::string& song, const std::string& artist);
+
+private:
+    SongCache() = default;
+    SongCache(const SongCache&) = delete;
+    SongCache& operator=(const SongCache&) = delete;
+
+    mutable std::mutex mutex_;
+    std::string directory_;
+    // 64-bit, caches of 4 GB and more do not fit size_t
+    uint64_t capacity_ = 0;
+    uint64_t total_size_ = 0;
+    uint32_t use_sequence_ = 0;
+    std::vector<Entry> entries_;
+
+    static std::string SongKey(const std::string& song, const std::string& artist);
+    static std::string PathKey(const std::string& audio_path);
+
+    std::string TempPath(const std::string& file) const;
+    bool Lookup(const std::string& key, Entry& entry, std::string& path);
+    int FindEntry(const std::string& key) const;
+    void Insert(const Source& source, const std::string& temp_path, size_t size);
+    void EvictLocked(const std::string& keep_file);
+    void RemoveEntryLocked(size_t index);
+    void LoadIndexLocked();
+    void SaveIndexLocked();
+};
+
+#endif // SONG_CACHE_H
@@ -0,0 +1,175 @@
+#include "stream_ring_buffer.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "StreamRingBuffer"
+
+StreamRingBuffer::StreamRingBuffer(uint32_t buffer_ms, uint32_t start_ms) : start_ms_(start_ms) {
+    capacity_ = (size_t)buffer_ms * STREAM_RING_MAX_BYTES_PER_SEC / 1000;
+    capacity_ = std::max(capacity_, (size_t)STREAM_RING_MAX_SPAN * 4);
+    SetByteRate(STREAM_RING_NOMINAL_BYTES_PER_SEC);
+}
+
+StreamRingBuffer::~StreamRingBuffer() {
+    if (storage_ != nullptr) {
+        heap_caps_free(storage_);
+    }
+}
+
+bool StreamRingBuffer::Allocate() {
+    if (storage_ != nullptr) {
+        return true;
+    }
+    storage_ = (uint8_t*)heap_caps_malloc(capacity_ + STREAM_RING_MAX_SPAN, MALLOC_CAP_SPIRAM);
+    if (storage_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for the stream buffer", capacity_ + STREAM_RING_MAX_SPAN);
+        return false;
+    }
+    ESP_LOGI(TAG, "Stream buffer: %u bytes, start watermark %u bytes", capacity_, resume_level_);
+    return true;
+}
+
+size_t StreamRingBuffer::AcquireWrite(uint8_t*& data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Wait for a reasonably large hole so the HTTP reader does not spin on tiny reads
+    size_t low_water = std::min((size_t)STREAM_RING_MAX_SPAN, capacity_ / 4);
+    cv_.wait(lock, [this, low_water] { return aborted_ || capacity_ - level_ >= low_water; });
+    if (aborted_) {
+        return 0;
+    }
+    data = storage_ + write_pos_;
+    return std::min(capacity_ - level_, capacity_ - write_pos_);
+}
+
+void StreamRingBuffer::CommitWrite(size_t size) {
+    if (size == 0) {
+        return;
+    }
+    // Writes never wrap, mirror the head of the storage so reads near the end stay contiguous
+    if (write_pos_ < STREAM_RING_MAX_SPAN) {
+        size_t n = std::min(size, (size_t)STREAM_RING_MAX_SPAN - write_pos_);
+        memcpy(storage_ + capacity_ + write_pos_, storage_ + write_pos_, n);
+    }
+
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_pos_ = (write_pos_ + size) % capacity_;
+    level_ += size;
+    bytes_in_ += size;
+    if (first_write_us_ == 0) {
+        first_write_us_ = now;
+    }
+    last_write_us_ = now;
+    cv_.notify_all();
+}
+
+void StreamRingBuffer::FinishWriting() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    cv_.notify_all();
+}
+
+size_t StreamRingBuffer::AcquireRead(const uint8_t*& data, size_t want) {
+    want = std::min(want, (size_t)STREAM_RING_MAX_SPAN);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!aborted_) {
+        if (!buffering_) {
+            if (level_ >= want || finished_) {
+                break;
+            }
+            // Underrun, stop reading until the resume watermark is reached again
+            buffering_ = true;
+            stall_start_us_ = esp_timer_get_time();
+            stalls_++;
+            ESP_LOGW(TAG, "Stream buffer underrun (%u bytes left), rebuffering", level_);
+        }
+
+        size_t target = std::max(resume_level_, want);
+        cv_.wait(lock, [this, target] { return aborted_ || finished_ || level_ >= target; });
+        if (aborted_) {
+            break;
+        }
+        int64_t now = esp_timer_get_time();
+        if (!started_) {
+            started_ = true;
+            startup_us_ = now - reset_time_us_;
+            ESP_LOGI(TAG, "Playback started after %lld ms with %u bytes buffered", startup_us_ / 1000, level_);
+        } else {
+            stall_us_ += now - stall_start_us_;
+        }
+        buffering_ = false;
+    }
+    if (aborted_ || level_ == 0) {
+        return 0;
+    }
+    data = storage_ + read_pos_;
+    // Small spans keep committing, so the writer can refill while a long buffer is decoded
+    return std::min(level_, (size_t)STREAM_RING_MAX_SPAN);
+}
+
+void StreamRingBuffer::CommitRead(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size = std::min(size, level_);
+    read_pos_ = (read_pos_ + size) % capacity_;
+    level_ -= size;
+    cv_.notify_all();
+}
+
+void StreamRingBuffer::SetByteRate(uint32_t bytes_per_sec) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t level = (size_t)start_ms_ * bytes_per_sec / 1000;
+    resume_level_ = std::clamp(level, (size_t)STREAM_RING_MAX_SPAN, capacity_ / 2);
+}
+
+void StreamRingBuffer::Abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    cv_.notify_all();
+}
+
+void StreamRingBuffer::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_pos_ = 0;
+    write_pos_ = 0;
+    level_ = 0;
+    finished_ = false;
+    aborted_ = false;
+    buffering_ = true;
+    started_ = false;
+    bytes_in_ = 0;
+    reset_time_us_ = esp_timer_get_time();
+    first_write_us_ = 0;
+    last_write_us_ = 0;
+    stall_us_ = 0;
+    stalls_ = 0;
+    startup_us_ = 0;
+}
+
+size_t StreamRingBuffer::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return level_;
+}
+
+bool StreamRingBuffer::writer_finished() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return finished_;
+}
+
+StreamRingBuffer::Stats StreamRingBuffer::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = {};
+    stats.bytes_in = bytes_in_;
+    int64_t active_us = last_write_us_ - first_write_us_;
+    if (active_us > 0) {
+        stats.refill_bytes_per_sec = (uint32_t)(bytes_in_ * 1000000LL / active_us);
+    }
+    stats.stalls = stalls_;
+    stats.stall_ms = (uint32_t)(stall_us_ / 1000);
+    stats.startup_ms = (uint32_t)(startup_us_ / 1000);
+    return stats;
+}
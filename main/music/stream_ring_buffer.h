@@ -0,0 +1,93 @@
+#ifndef STREAM_RING_BUFFER_H
+#define STREAM_RING_BUFFER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <condition_variable>
+
+// Decoders get contiguous spans of up to this many bytes, enough for any MP3 or AAC frame
+#define STREAM_RING_MAX_SPAN (4 * 1024)
+// Nominal stream byte rate used for the watermarks until the decoder reports the real one
+#define STREAM_RING_NOMINAL_BYTES_PER_SEC (128000 / 8)
+// Capacity is sized for the worst case bitrate so the buffer always holds the configured time
+#define STREAM_RING_MAX_BYTES_PER_SEC (320000 / 8)
+
+/*
+ * Single producer / single consumer byte ring for compressed audio streams.
+ *
+ * The storage is allocated once in PSRAM. The HTTP reader receives straight into the ring
+ * and the decoder reads straight out of it: the first STREAM_RING_MAX_SPAN bytes are mirrored
+ * past the end of the storage, so a read span never wraps.
+ *
+ * Playback starts (and resumes after an underrun) once the ring holds start_ms of audio,
+ * every underrun is counted as a stall.
+ */
+class StreamRingBuffer {
+public:
+    struct Stats {
+        size_t bytes_in;
+        uint32_t refill_bytes_per_sec;  // Average receive rate while the writer was active
+        uint32_t stalls;                // Underruns after playback started
+        uint32_t stall_ms;              // Time spent rebuffering
+        uint32_t startup_ms;            // Reset() to the first read
+    };
+
+    StreamRingBuffer(uint32_t buffer_ms, uint32_t start_ms);
+    ~StreamRingBuffer();
+
+    // Allocates the storage on first use, returns false when PSRAM is exhausted
+    bool Allocate();
+
+    // Producer: waits for free space and returns a contiguous writable span (0 when aborted)
+    size_t AcquireWrite(uint8_t*& data);
+    void CommitWrite(size_t size);
+    // No more data will be written, readers drain the rest
+    void FinishWriting();
+
+    // Consumer: waits until at least want bytes are buffered (or the writer finished) and
+    // returns a contiguous readable span of up to STREAM_RING_MAX_SPAN bytes, 0 when the
+    // stream ended or the ring was aborted
+    size_t AcquireRead(const uint8_t*& data, size_t want);
+    void CommitRead(size_t size);
+
+    // Updates the start/resume watermark once the stream bitrate is known
+    void SetByteRate(uint32_t bytes_per_sec);
+
+    // Wakes up both sides, they return 0 until Reset()
+    void Abort();
+    // Drops buffered data and statistics for a new stream, no thread may be using the ring
+    void Reset();
+
+    size_t size() const;
+    size_t capacity() const { return capacity_; }
+    bool writer_finished() const;
+    Stats GetStats() const;
+
+private:
+    uint32_t start_ms_;
+    size_t capacity_;
+    uint8_t* storage_ = nullptr;
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t read_pos_ = 0;
+    size_t write_pos_ = 0;
+    size_t level_ = 0;
+    size_t resume_level_ = 0;
+    bool finished_ = false;
+    bool aborted_ = false;
+    bool buffering_ = true;
+    bool started_ = false;
+
+    size_t bytes_in_ = 0;
+    int64_t reset_time_us_ = 0;
+    int64_t first_write_us_ = 0;
+    int64_t last_write_us_ = 0;
+    int64_t stall_start_us_ = 0;
+    int64_t stall_us_ = 0;
+    uint32_t stalls_ = 0;
+    int64_t startup_us_ = 0;
+};
+
+#endif // STREAM_RING_BUFFER_H
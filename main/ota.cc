@@ -2,6 +2,8 @@
 #include "system_info.h"
 #include "http_client.h"
 #include "settings.h"
+#include "resumable_download.h"
+#include "delta_patch.h"
 #include "assets/lang_config.h"
 
 #include <cJSON.h>
@@ -16,6 +18,7 @@
 #endif
 
 #include <cstring>
+#include <strings.h>
 #include <vector>
 #include <sstream>
 #include <algorithm>
@@ -354,6 +357,37 @@ bool Ota::CheckVersion(std::string& url) {
             firmware_size_ = size->valueint;
             ESP_LOGI(TAG, "Firmware size from server: %d bytes", firmware_size_);
         }
+        // Optional delta patch against the running firmware:
+        // { "patch": { "url": "http://", "size": 12345, "source_sha256": "hex" } }
+        firmware_patch_url_.clear();
+        firmware_patch_source_sha256_.clear();
+        cJSON *patch = cJSON_GetObjectItem(firmware, "patch");
+        if (cJSON_IsObject(patch)) {
+            cJSON *patch_url = cJSON_GetObjectItem(patch, "url");
+            cJSON *source_sha256 = cJSON_GetObjectItem(patch, "source_sha256");
+            if (cJSON_IsString(patch_url)) {
+                firmware_patch_url_ = patch_url->valuestring;
+                ESP_LOGI(TAG, "Delta patch available: %s", firmware_patch_url_.c_str());
+            }
+            if (cJSON_IsString(source_sha256)) {
+                firmware_patch_source_sha256_ = source_sha256->valuestring;
+            }
+        }
+        // Optional per-block SHA-256 manifest: { "block_size": 65536, "block_sha256": ["hex", ...] }
+        firmware_block_size_ = 0;
+        firmware_block_hashes_.clear();
+        cJSON *block_size = cJSON_GetObjectItem(firmware, "block_size");
+        cJSON *block_sha256 = cJSON_GetObjectItem(firmware, "block_sha256");
+        if (cJSON_IsNumber(block_size) && cJSON_IsArray(block_sha256)) {
+            firmware_block_size_ = block_size->valueint;
+            cJSON *item;
+            cJSON_ArrayForEach(item, block_sha256) {
+                if (cJSON_IsString(item)) {
+                    firmware_block_hashes_.push_back(item->valuestring);
+                }
+            }
+            ESP_LOGI(TAG, "Firmware manifest: %u blocks of %u bytes", firmware_block_hashes_.size(), firmware_block_size_);
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -417,93 +451,96 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     }
 
     ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
-
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    auto user_agent = SystemInfo::GetUserAgent();
-    http->SetHeader("User-Agent", user_agent);
-    http->SetHeader("Content-Type", "*/*");
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
+    if (firmware_url == firmware_url_ && !firmware_patch_url_.empty()) {
+        if (UpgradeWithPatch(firmware_patch_url_, update_partition)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Delta update failed, falling back to the full image");
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
-        return false;
-    }
+    bool image_header_checked = false;
+    std::string image_header;
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        if (firmware_size_ > 0) {
-            content_length = firmware_size_;
-        } else {
-            esp_partition_iterator_t it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
-            const esp_partition_t *partition = esp_partition_get(it);
-            content_length = partition->size;
-        }
-        // return false;
+    // 断点续传：进度记录在 NVS，断线后使用 Range 请求从上次写入的位置继续
+    ResumableDownload download(firmware_url, "ota_download", update_partition);
+    download.SetHeader("User-Agent", SystemInfo::GetUserAgent());
+    download.SetHeader("Content-Type", "*/*");
+    download.SetExpectedSize(firmware_size_ > 0 ? firmware_size_ : update_partition->size);
+    if (firmware_url == firmware_url_ && !firmware_block_hashes_.empty()) {
+        download.SetBlockHashes(firmware_block_size_, firmware_block_hashes_);
     }
-    ESP_LOGI(TAG, "Firmware size: %u bytes", content_length);
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            return false;
+    bool ota_begun = false;
+    size_t next_offset = 0;
+    auto result = download.Run([&](const uint8_t* data, size_t size, size_t offset) {
+        // A retry rewinds to an earlier offset, restart the OTA handle there
+        if (ota_begun && offset != next_offset) {
+            esp_ota_abort(update_handle);
+            ota_begun = false;
         }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
+        if (!ota_begun && offset > 0) {
+            auto err = esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, offset, &update_handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to resume OTA at offset %u: %s", offset, esp_err_to_name(err));
+                return false;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
+            ota_begun = true;
+            image_header_checked = true;
         }
+        next_offset = offset + size;
 
-        if (ret == 0) {
-            break;
-        }
+        if (!ota_begun) {
+            if (offset == 0) {
+                image_header.clear();
+            }
+            image_header.append((const char*)data, size);
+            if (image_header.size() < sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+                return true;
+            }
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
 
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
+            auto current_version = esp_app_get_description()->version;
+            ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
 
-                image_header_checked = true;
-                std::string().swap(image_header);
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                return false;
             }
+            ota_begun = true;
+            image_header_checked = true;
+            // Flush everything buffered while waiting for the header
+            auto err = esp_ota_write(update_handle, image_header.data(), image_header.size());
+            std::string().swap(image_header);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                return false;
+            }
+            return true;
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
+        auto err = esp_ota_write(update_handle, data, size);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
             return false;
         }
+        return true;
+    }, [this](int progress, size_t speed) {
+        if (upgrade_callback_) {
+            upgrade_callback_(progress, speed);
+        }
+    });
+    if (result != kResumableDownloadOk || !image_header_checked) {
+        ESP_LOGE(TAG, "Failed to download firmware");
+        if (ota_begun) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
     }
-    http->Close();
 
+    return FinishUpgrade(update_handle, update_partition);
+}
+
+bool Ota::FinishUpgrade(esp_ota_handle_t update_handle, const esp_partition_t* update_partition) {
     esp_err_t err = esp_ota_end(update_handle);
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
@@ -524,6 +561,75 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     return true;
 }
 
+bool Ota::UpgradeWithPatch(const std::string& patch_url, const esp_partition_t* update_partition) {
+    auto running_partition = esp_ota_get_running_partition();
+    if (!firmware_patch_source_sha256_.empty()) {
+        // 确认补丁是基于当前运行的固件生成的
+        uint8_t sha256[32];
+        if (esp_partition_get_sha256(running_partition, sha256) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to hash running partition");
+            return false;
+        }
+        char hex[65];
+        for (int i = 0; i < 32; i++) {
+            snprintf(hex + i * 2, 3, "%02x", sha256[i]);
+        }
+        if (strcasecmp(hex, firmware_patch_source_sha256_.c_str()) != 0) {
+            ESP_LOGW(TAG, "Patch source %s does not match running image %s", firmware_patch_source_sha256_.c_str(), hex);
+            return false;
+        }
+    }
+
+    ESP_LOGI(TAG, "Applying delta patch from %s", patch_url.c_str());
+    auto http = SetupHttp();
+    if (!http->Open("GET", patch_url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to get patch, status code: %d", http->GetStatusCode());
+        return false;
+    }
+
+    esp_ota_handle_t update_handle = 0;
+    bool ota_begun = false;
+    DeltaPatch delta(running_partition, [&](const uint8_t* data, size_t size) {
+        if (!ota_begun) {
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to begin OTA");
+                return false;
+            }
+            ota_begun = true;
+        }
+        auto err = esp_ota_write(update_handle, data, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    });
+
+    // 补丁流式下载，边下载边与当前固件合成新固件写入 OTA 分区
+    DownloadPipeline pipeline;
+    bool success = pipeline.Run(http.get(), http->GetBodyLength(), [&delta](const uint8_t* data, size_t size, size_t offset) {
+        return delta.Feed(data, size);
+    }, [this, &delta](int progress, size_t speed) {
+        if (upgrade_callback_ && delta.target_size() > 0) {
+            upgrade_callback_(delta.target_written() * 100 / delta.target_size(), speed);
+        }
+    });
+    http->Close();
+
+    if (!success || !delta.Finish()) {
+        if (ota_begun) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
+    }
+    ESP_LOGI(TAG, "Delta patch applied, %u bytes downloaded for a %u byte image", pipeline.total_written(), delta.target_size());
+    return FinishUpgrade(update_handle, update_partition);
+}
+
 bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
     return Upgrade(firmware_url_);
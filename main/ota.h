@@ -3,8 +3,10 @@
 
 #include <functional>
 #include <string>
+#include <vector>
 
 #include <esp_err.h>
+#include <esp_ota_ops.h>
 #include "board.h"
 
 class Ota {
@@ -47,9 +49,15 @@ private:
     std::string activation_challenge_;
     std::string serial_number_;
     int firmware_size_ = 0;
+    size_t firmware_block_size_ = 0;
+    std::vector<std::string> firmware_block_hashes_;
+    std::string firmware_patch_url_;
+    std::string firmware_patch_source_sha256_;
     int activation_timeout_ms_ = 30000;
 
     bool Upgrade(const std::string& firmware_url);
+    bool UpgradeWithPatch(const std::string& patch_url, const esp_partition_t* update_partition);
+    bool FinishUpgrade(esp_ota_handle_t update_handle, const esp_partition_t* update_partition);
     std::function<void(int progress, size_t speed)> upgrade_callback_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
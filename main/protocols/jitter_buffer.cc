@@ -0,0 +1,118 @@
+#include "jitter_buffer.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "JitterBuffer"
+
+void JitterBuffer::Reset(int frame_duration_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (received_ > 0) {
+        ESP_LOGI(TAG, "Session: %lu received, %lu reordered, %lu late, %lu concealed, %lu skipped, jitter %lld us",
+            received_, reordered_, late_, concealed_, skipped_, jitter_us_);
+    }
+    pending_.clear();
+    next_sequence_ = 0;
+    frame_us_ = frame_duration_ms * 1000;
+    last_transit_us_ = 0;
+    jitter_us_ = 0;
+    has_transit_ = false;
+    received_ = 0;
+    reordered_ = 0;
+    late_ = 0;
+    concealed_ = 0;
+    skipped_ = 0;
+}
+
+int64_t JitterBuffer::TargetDelayUs() const {
+    return std::clamp<int64_t>(jitter_us_ * 2, JITTER_BUFFER_MIN_DELAY_MS * 1000, JITTER_BUFFER_MAX_DELAY_MS * 1000);
+}
+
+void JitterBuffer::UpdateJitter(uint32_t sequence, int64_t now_us) {
+    int64_t transit = now_us - (int64_t)sequence * frame_us_;
+    if (has_transit_) {
+        int64_t d = std::abs(transit - last_transit_us_);
+        // A jump of a second or more is a pause between sentences, not jitter
+        if (d < 1000000) {
+            jitter_us_ += (d - jitter_us_) / 16;
+        }
+    }
+    last_transit_us_ = transit;
+    has_transit_ = true;
+}
+
+std::vector<std::unique_ptr<AudioStreamPacket>> JitterBuffer::Put(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet, int64_t now_us) {
+    std::vector<std::unique_ptr<AudioStreamPacket>> output;
+    std::lock_guard<std::mutex> lock(mutex_);
+    received_++;
+    if (next_sequence_ == 0) {
+        next_sequence_ = sequence;
+    }
+    if (sequence < next_sequence_) {
+        late_++;
+        ESP_LOGW(TAG, "Dropped late audio packet: %lu, expected: %lu", sequence, next_sequence_);
+        return output;
+    }
+    if (!pending_.empty() && sequence < pending_.rbegin()->first) {
+        reordered_++;
+    }
+    UpdateJitter(sequence, now_us);
+    pending_.emplace(sequence, Entry{std::move(packet), now_us});
+    Release(now_us, output);
+    return output;
+}
+
+std::vector<std::unique_ptr<AudioStreamPacket>> JitterBuffer::Poll(int64_t now_us) {
+    std::vector<std::unique_ptr<AudioStreamPacket>> output;
+    std::lock_guard<std::mutex> lock(mutex_);
+    Release(now_us, output);
+    return output;
+}
+
+int64_t JitterBuffer::NextDeadline() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.empty()) {
+        return 0;
+    }
+    int64_t oldest = pending_.begin()->second.arrival_us;
+    for (auto& [sequence, entry] : pending_) {
+        oldest = std::min(oldest, entry.arrival_us);
+    }
+    return oldest + TargetDelayUs();
+}
+
+void JitterBuffer::Release(int64_t now_us, std::vector<std::unique_ptr<AudioStreamPacket>>& output) {
+    while (!pending_.empty()) {
+        auto it = pending_.begin();
+        if (it->first != next_sequence_) {
+            // Wait for the missing packet unless the oldest held packet has waited long enough
+            int64_t oldest = it->second.arrival_us;
+            for (auto& [sequence, entry] : pending_) {
+                oldest = std::min(oldest, entry.arrival_us);
+            }
+            if (now_us - oldest < TargetDelayUs() && pending_.size() < JITTER_BUFFER_MAX_PACKETS) {
+                break;
+            }
+
+            uint32_t missing = it->first - next_sequence_;
+            if (missing <= JITTER_BUFFER_MAX_CONCEALED_FRAMES) {
+                for (uint32_t i = 0; i < missing; i++) {
+                    auto plc = std::make_unique<AudioStreamPacket>();
+                    plc->sample_rate = it->second.packet->sample_rate;
+                    plc->frame_duration = it->second.packet->frame_duration;
+                    output.push_back(std::move(plc));
+                }
+                concealed_ += missing;
+            } else {
+                skipped_ += missing;
+            }
+            ESP_LOGW(TAG, "Lost %lu audio packets before %lu, %s", missing, it->first,
+                missing <= JITTER_BUFFER_MAX_CONCEALED_FRAMES ? "concealed" : "skipped");
+            next_sequence_ = it->first;
+        }
+        output.push_back(std::move(it->second.packet));
+        pending_.erase(it);
+        next_sequence_++;
+    }
+}
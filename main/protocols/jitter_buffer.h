@@ -0,0 +1,62 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include "protocol.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define JITTER_BUFFER_MIN_DELAY_MS 20
+#define JITTER_BUFFER_MAX_DELAY_MS 240
+#define JITTER_BUFFER_MAX_PACKETS 8
+// Longer gaps are skipped instead of concealed, Opus PLC fades to silence anyway
+#define JITTER_BUFFER_MAX_CONCEALED_FRAMES 3
+
+/*
+ * Reorders downlink packets by sequence number before they reach the decoder.
+ *
+ * Packets that arrive in order are released at once. When a sequence number is missing,
+ * later packets are held until the missing one arrives or the wait exceeds a delay derived
+ * from the observed arrival jitter; the missing frames are then released as packets with an
+ * empty payload, which the Opus decoder turns into packet loss concealment.
+ */
+class JitterBuffer {
+public:
+    void Reset(int frame_duration_ms);
+
+    // Returns the packets that can be decoded now, in sequence order
+    std::vector<std::unique_ptr<AudioStreamPacket>> Put(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet, int64_t now_us);
+    std::vector<std::unique_ptr<AudioStreamPacket>> Poll(int64_t now_us);
+    // Time at which Poll will release held packets, 0 if nothing is waiting
+    int64_t NextDeadline();
+
+private:
+    struct Entry {
+        std::unique_ptr<AudioStreamPacket> packet;
+        int64_t arrival_us;
+    };
+
+    std::mutex mutex_;
+    std::map<uint32_t, Entry> pending_;
+    uint32_t next_sequence_ = 0;
+    int64_t frame_us_ = 60000;
+
+    // RFC 3550 style interarrival jitter, relative to the sequence based schedule
+    int64_t last_transit_us_ = 0;
+    int64_t jitter_us_ = 0;
+    bool has_transit_ = false;
+
+    uint32_t received_ = 0;
+    uint32_t reordered_ = 0;
+    uint32_t late_ = 0;
+    uint32_t concealed_ = 0;
+    uint32_t skipped_ = 0;
+
+    int64_t TargetDelayUs() const;
+    void UpdateJitter(uint32_t sequence, int64_t now_us);
+    void Release(int64_t now_us, std::vector<std::unique_ptr<AudioStreamPacket>>& output);
+};
+
+#endif // JITTER_BUFFER_H
@@ -0,0 +1,273 @@
+#include "json_scanner.h"
+
+#include <cstring>
+#include <cstdint>
+
+namespace {
+
+struct Cursor {
+    const char* p;
+    const char* end;
+
+    void SkipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+        }
+    }
+};
+
+// Leaves the cursor after the closing quote, the opening quote must be current
+bool SkipString(Cursor& c) {
+    c.p++;
+    while (c.p < c.end) {
+        char ch = *c.p++;
+        if (ch == '"') {
+            return true;
+        }
+        if (ch == '\\') {
+            if (c.p >= c.end) {
+                return false;
+            }
+            c.p++;
+        } else if ((unsigned char)ch < 0x20) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool SkipLiteral(Cursor& c, const char* literal) {
+    size_t length = strlen(literal);
+    if ((size_t)(c.end - c.p) < length || memcmp(c.p, literal, length) != 0) {
+        return false;
+    }
+    c.p += length;
+    return true;
+}
+
+bool SkipNumber(Cursor& c) {
+    const char* start = c.p;
+    if (c.p < c.end && *c.p == '-') {
+        c.p++;
+    }
+    bool digits = false;
+    while (c.p < c.end && ((*c.p >= '0' && *c.p <= '9') || *c.p == '.' || *c.p == 'e' || *c.p == 'E' ||
+        *c.p == '+' || *c.p == '-')) {
+        digits = digits || (*c.p >= '0' && *c.p <= '9');
+        c.p++;
+    }
+    return digits && c.p > start;
+}
+
+bool SkipValue(Cursor& c, int depth) {
+    if (depth > JSON_SCANNER_MAX_DEPTH || c.p >= c.end) {
+        return false;
+    }
+    switch (*c.p) {
+    case '"':
+        return SkipString(c);
+    case '{':
+    case '[': {
+        bool object = *c.p == '{';
+        char close = object ? '}' : ']';
+        c.p++;
+        c.SkipSpace();
+        if (c.p < c.end && *c.p == close) {
+            c.p++;
+            return true;
+        }
+        while (true) {
+            c.SkipSpace();
+            if (object) {
+                if (c.p >= c.end || *c.p != '"' || !SkipString(c)) {
+                    return false;
+                }
+                c.SkipSpace();
+                if (c.p >= c.end || *c.p++ != ':') {
+                    return false;
+                }
+                c.SkipSpace();
+            }
+            if (!SkipValue(c, depth + 1)) {
+                return false;
+            }
+            c.SkipSpace();
+            if (c.p >= c.end) {
+                return false;
+            }
+            char ch = *c.p++;
+            if (ch == close) {
+                return true;
+            }
+            if (ch != ',') {
+                return false;
+            }
+        }
+    }
+    case 't':
+        return SkipLiteral(c, "true");
+    case 'f':
+        return SkipLiteral(c, "false");
+    case 'n':
+        return SkipLiteral(c, "null");
+    default:
+        return SkipNumber(c);
+    }
+}
+
+int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+    if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+    return -1;
+}
+
+bool ReadHex4(const char*& p, const char* end, uint32_t& value) {
+    if (end - p < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = HexValue(*p++);
+        if (digit < 0) {
+            return false;
+        }
+        value = (value << 4) | digit;
+    }
+    return true;
+}
+
+void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(cp);
+    } else if (cp < 0x800) {
+        out.push_back(0xC0 | (cp >> 6));
+        out.push_back(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out.push_back(0xE0 | (cp >> 12));
+        out.push_back(0x80 | ((cp >> 6) & 0x3F));
+        out.push_back(0x80 | (cp & 0x3F));
+    } else {
+        out.push_back(0xF0 | (cp >> 18));
+        out.push_back(0x80 | ((cp >> 12) & 0x3F));
+        out.push_back(0x80 | ((cp >> 6) & 0x3F));
+        out.push_back(0x80 | (cp & 0x3F));
+    }
+}
+
+} // namespace
+
+JsonScanner::JsonScanner(const char* data, size_t length) {
+    Cursor c{data, data + length};
+    c.SkipSpace();
+    if (c.p >= c.end || *c.p++ != '{') {
+        return;
+    }
+    c.SkipSpace();
+    if (c.p < c.end && *c.p == '}') {
+        c.p++;
+    } else {
+        while (true) {
+            c.SkipSpace();
+            const char* key_start = c.p;
+            if (c.p >= c.end || *c.p != '"' || !SkipString(c)) {
+                return;
+            }
+            std::string_view key(key_start + 1, c.p - key_start - 2);
+            c.SkipSpace();
+            if (c.p >= c.end || *c.p++ != ':') {
+                return;
+            }
+            c.SkipSpace();
+            const char* value_start = c.p;
+            if (!SkipValue(c, 1)) {
+                return;
+            }
+            // Fields beyond the limit are validated but not indexed
+            if (field_count_ < JSON_SCANNER_MAX_FIELDS) {
+                fields_[field_count_++] = Field{key, std::string_view(value_start, c.p - value_start)};
+            }
+            c.SkipSpace();
+            if (c.p >= c.end) {
+                return;
+            }
+            char ch = *c.p++;
+            if (ch == '}') {
+                break;
+            }
+            if (ch != ',') {
+                return;
+            }
+        }
+    }
+    // Text frames may be NUL terminated
+    c.SkipSpace();
+    while (c.p < c.end && *c.p == '\0') {
+        c.p++;
+    }
+    valid_ = c.p == c.end;
+}
+
+std::string_view JsonScanner::Find(std::string_view key) const {
+    for (int i = 0; i < field_count_; i++) {
+        if (fields_[i].key == key) {
+            return fields_[i].value;
+        }
+    }
+    return std::string_view();
+}
+
+bool JsonScanner::StringEquals(std::string_view key, std::string_view expected) const {
+    auto value = Find(key);
+    return value.size() == expected.size() + 2 && value.front() == '"' && value.substr(1, expected.size()) == expected;
+}
+
+bool JsonScanner::GetString(std::string_view key, std::string& value) const {
+    auto raw = Find(key);
+    if (raw.size() < 2 || raw.front() != '"') {
+        return false;
+    }
+    value.clear();
+    value.reserve(raw.size() - 2);
+    const char* p = raw.data() + 1;
+    const char* end = raw.data() + raw.size() - 1;
+    while (p < end) {
+        char ch = *p++;
+        if (ch != '\\') {
+            value.push_back(ch);
+            continue;
+        }
+        // The scanner guarantees a character follows every backslash
+        char escape = *p++;
+        switch (escape) {
+        case 'b': value.push_back('\b'); break;
+        case 'f': value.push_back('\f'); break;
+        case 'n': value.push_back('\n'); break;
+        case 'r': value.push_back('\r'); break;
+        case 't': value.push_back('\t'); break;
+        case 'u': {
+            uint32_t cp;
+            if (!ReadHex4(p, end, cp)) {
+                return false;
+            }
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                uint32_t low;
+                if (end - p < 6 || p[0] != '\\' || p[1] != 'u') {
+                    return false;
+                }
+                p += 2;
+                if (!ReadHex4(p, end, low) || low < 0xDC00 || low > 0xDFFF) {
+                    return false;
+                }
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+            }
+            AppendUtf8(value, cp);
+            break;
+        }
+        default:
+            value.push_back(escape);
+            break;
+        }
+    }
+    return true;
+}
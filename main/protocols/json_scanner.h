@@ -0,0 +1,42 @@
+#ifndef JSON_SCANNER_H
+#define JSON_SCANNER_H
+
+#include <string>
+#include <string_view>
+
+#define JSON_SCANNER_MAX_FIELDS 12
+#define JSON_SCANNER_MAX_DEPTH 16
+
+/*
+ * Scans the top level fields of a JSON object without building a cJSON tree.
+ *
+ * Keys and values are kept as spans into the original text, so a message like
+ * {"type":"tts","state":"sentence_start","text":"..."} costs no heap allocation until
+ * a string value is actually copied out. Nested objects and arrays are validated and
+ * skipped; callers that need them fall back to cJSON.
+ */
+class JsonScanner {
+public:
+    JsonScanner(const char* data, size_t length);
+
+    // False when the text is not a well formed JSON object
+    bool valid() const { return valid_; }
+    // Raw text of a top level value (strings keep their quotes), empty when absent
+    std::string_view Find(std::string_view key) const;
+    // Compares a string value without decoding it, escaped strings never match
+    bool StringEquals(std::string_view key, std::string_view expected) const;
+    // Decodes a string value, false when absent or not a string
+    bool GetString(std::string_view key, std::string& value) const;
+
+private:
+    struct Field {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    Field fields_[JSON_SCANNER_MAX_FIELDS];
+    int field_count_ = 0;
+    bool valid_ = false;
+};
+
+#endif // JSON_SCANNER_H
@@ -6,12 +6,14 @@
 #include <esp_log.h>
 #include <cstring>
 #include <arpa/inet.h>
+#include <algorithm>
 #include "assets/lang_config.h"
 
 #define TAG "MQTT"
 
 MqttProtocol::MqttProtocol() {
     event_group_handle_ = xEventGroupCreate();
+    mbedtls_aes_init(&aes_ctx_);
 
     // Initialize reconnect timer
     esp_timer_create_args_t reconnect_timer_args = {
@@ -28,6 +30,20 @@ MqttProtocol::MqttProtocol() {
         .arg = this,
     };
     esp_timer_create(&reconnect_timer_args, &reconnect_timer_);
+
+    // Releases packets held by the jitter buffer when the missing ones never arrive
+    esp_timer_create_args_t jitter_timer_args = {
+        .callback = [](void* arg) {
+            MqttProtocol* protocol = (MqttProtocol*)arg;
+            std::lock_guard<std::mutex> lock(protocol->incoming_audio_mutex_);
+            protocol->DeliverAudio(protocol->jitter_buffer_.Poll(esp_timer_get_time()));
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "jitter_buffer",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&jitter_timer_args, &jitter_timer_);
 }
 
 MqttProtocol::~MqttProtocol() {
@@ -36,9 +52,14 @@ MqttProtocol::~MqttProtocol() {
         esp_timer_stop(reconnect_timer_);
         esp_timer_delete(reconnect_timer_);
     }
+    if (jitter_timer_ != nullptr) {
+        esp_timer_stop(jitter_timer_);
+        esp_timer_delete(jitter_timer_);
+    }
 
     udp_.reset();
     mqtt_.reset();
+    mbedtls_aes_free(&aes_ctx_);
     
     if (event_group_handle_ != nullptr) {
         vEventGroupDelete(event_group_handle_);
@@ -91,6 +112,10 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
+        if (HandleIncomingMessage(payload.data(), payload.size())) {
+            last_incoming_time_ = std::chrono::steady_clock::now();
+            return;
+        }
         cJSON* root = cJSON_Parse(payload.c_str());
         if (root == nullptr) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
@@ -152,30 +177,33 @@ bool MqttProtocol::SendText(const std::string& text) {
     return true;
 }
 
-bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool MqttProtocol::SendAudio(const AudioStreamPacket& packet) {
     std::lock_guard<std::mutex> lock(channel_mutex_);
     if (udp_ == nullptr) {
         return false;
     }
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet->payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
-
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
-
+    // Header and ciphertext are written into one reused buffer, no allocation per packet
+    size_t payload_size = packet.payload.size();
+    send_buffer_.resize(aes_nonce_.size() + payload_size);
+    auto buffer = (uint8_t*)send_buffer_.data();
+    memcpy(buffer, aes_nonce_.data(), aes_nonce_.size());
+    *(uint16_t*)&buffer[2] = htons(payload_size);
+    *(uint32_t*)&buffer[8] = htonl(packet.timestamp);
+    *(uint32_t*)&buffer[12] = htonl(++local_sequence_);
+
+    // CTR mode advances the counter block, so it works on a copy of the header
+    uint8_t nonce_counter[16];
+    memcpy(nonce_counter, buffer, sizeof(nonce_counter));
     size_t nc_off = 0;
     uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+    if (mbedtls_aes_crypt_ctr(&aes_ctx_, payload_size, &nc_off, nonce_counter, stream_block,
+        packet.payload.data(), buffer + aes_nonce_.size()) != 0) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    return udp_->Send(send_buffer_) > 0;
 }
 
 void MqttProtocol::CloseAudioChannel() {
@@ -183,6 +211,7 @@ void MqttProtocol::CloseAudioChannel() {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         udp_.reset();
     }
+    esp_timer_stop(jitter_timer_);
 
     std::string message = "{";
     message += "\"session_id\":\"" + session_id_ + "\",";
@@ -229,7 +258,7 @@ bool MqttProtocol::OpenAudioChannel() {
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
          */
-        if (data.size() < sizeof(aes_nonce_)) {
+        if (data.size() < aes_nonce_.size()) {
             ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
             return;
         }
@@ -239,19 +268,13 @@ bool MqttProtocol::OpenAudioChannel() {
         }
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
 
         size_t decrypted_size = data.size() - aes_nonce_.size();
         size_t nc_off = 0;
         uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
+        uint8_t nonce[16];
+        memcpy(nonce, data.data(), sizeof(nonce));
+        auto encrypted = (const uint8_t*)data.data() + aes_nonce_.size();
         auto packet = std::make_unique<AudioStreamPacket>();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
@@ -262,11 +285,17 @@ bool MqttProtocol::OpenAudioChannel() {
             ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
             return;
         }
-        if (on_incoming_audio_ != nullptr) {
-            on_incoming_audio_(std::move(packet));
-        }
-        remote_sequence_ = sequence;
         last_incoming_time_ = std::chrono::steady_clock::now();
+
+        // Keep the packets released here and by the timer in sequence order
+        std::lock_guard<std::mutex> lock(incoming_audio_mutex_);
+        auto now = esp_timer_get_time();
+        DeliverAudio(jitter_buffer_.Put(sequence, std::move(packet), now));
+        auto deadline = jitter_buffer_.NextDeadline();
+        esp_timer_stop(jitter_timer_);
+        if (deadline > 0) {
+            esp_timer_start_once(jitter_timer_, std::max<int64_t>(deadline - now, 1000));
+        }
     });
 
     udp_->Connect(udp_server_, udp_port_);
@@ -293,7 +322,8 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "frame_duration",
+        Application::GetInstance().GetAudioService().uplink_controller().frame_duration_ms());
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -341,10 +371,14 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
     aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
+    if (aes_nonce_.size() != 16) {
+        ESP_LOGE(TAG, "Invalid UDP nonce size: %u", aes_nonce_.size());
+        return;
+    }
+    // The context is reused across sessions, only the key changes
     mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
     local_sequence_ = 0;
-    remote_sequence_ = 0;
+    jitter_buffer_.Reset(server_frame_duration_);
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
@@ -367,6 +401,15 @@ std::string MqttProtocol::DecodeHexString(const std::string& hex_string) {
     return decoded;
 }
 
+void MqttProtocol::DeliverAudio(std::vector<std::unique_ptr<AudioStreamPacket>>&& packets) {
+    if (on_incoming_audio_ == nullptr) {
+        return;
+    }
+    for (auto& packet : packets) {
+        on_incoming_audio_(std::move(packet));
+    }
+}
+
 bool MqttProtocol::IsAudioChannelOpened() const {
     return udp_ != nullptr && !error_occurred_ && !IsTimeout();
 }
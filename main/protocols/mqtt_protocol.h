@@ -3,6 +3,7 @@
 
 
 #include "protocol.h"
+#include "jitter_buffer.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
@@ -27,7 +28,7 @@ public:
     ~MqttProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(const AudioStreamPacket& packet) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
@@ -38,18 +39,22 @@ private:
     std::string publish_topic_;
 
     std::mutex channel_mutex_;
+    std::mutex incoming_audio_mutex_;
     std::unique_ptr<Mqtt> mqtt_;
     std::unique_ptr<Udp> udp_;
     mbedtls_aes_context aes_ctx_;
     std::string aes_nonce_;
+    std::string send_buffer_;
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+    JitterBuffer jitter_buffer_;
     esp_timer_handle_t reconnect_timer_;
+    esp_timer_handle_t jitter_timer_ = nullptr;
 
     bool StartMqttClient(bool report_error=false);
     void ParseServerHello(const cJSON* root);
+    void DeliverAudio(std::vector<std::unique_ptr<AudioStreamPacket>>&& packets);
     std::string DecodeHexString(const std::string& hex_string);
 
     bool SendText(const std::string& text) override;
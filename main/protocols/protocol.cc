@@ -8,6 +8,10 @@ void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
+void Protocol::OnIncomingMessage(std::function<bool(const JsonScanner& message)> callback) {
+    on_incoming_message_ = callback;
+}
+
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
     on_incoming_audio_ = callback;
 }
@@ -32,6 +36,17 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+bool Protocol::HandleIncomingMessage(const char* data, size_t length) {
+    if (on_incoming_message_ == nullptr) {
+        return false;
+    }
+    JsonScanner message(data, length);
+    if (!message.valid()) {
+        return false;
+    }
+    return on_incoming_message_(message);
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
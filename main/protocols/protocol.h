@@ -2,6 +2,7 @@
 #define PROTOCOL_H
 
 #include <cJSON.h>
+#include "json_scanner.h"
 #include <string>
 #include <functional>
 #include <chrono>
@@ -57,6 +58,8 @@ public:
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // Handles frequent messages from their top level fields, return false to fall back to OnIncomingJson
+    void OnIncomingMessage(std::function<bool(const JsonScanner& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -67,7 +70,10 @@ public:
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
-    virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    // Connect ahead of time so the next OpenAudioChannel can skip the handshake
+    virtual void PrewarmAudioChannel() {}
+    // The packet stays with the caller, so a failed send can be retried
+    virtual bool SendAudio(const AudioStreamPacket& packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
@@ -76,6 +82,7 @@ public:
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<bool(const JsonScanner& message)> on_incoming_message_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -90,6 +97,7 @@ protected:
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
     virtual bool SendText(const std::string& text) = 0;
+    bool HandleIncomingMessage(const char* data, size_t length);
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
 };
@@ -14,9 +14,31 @@
 
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+    xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT);
+
+    esp_timer_create_args_t warm_session_timer_args = {
+        .callback = [](void* arg) {
+            auto protocol = static_cast<WebsocketProtocol*>(arg);
+            Application::GetInstance().Schedule([protocol]() {
+                protocol->CloseWarmSession();
+            });
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ws_warm_session",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&warm_session_timer_args, &warm_session_timer_);
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
+    // Let a running pre-connect finish before tearing down
+    xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT, pdFALSE, pdFALSE, portMAX_DELAY);
+    if (warm_session_timer_ != nullptr) {
+        esp_timer_stop(warm_session_timer_);
+        esp_timer_delete(warm_session_timer_);
+    }
+    websocket_.reset();
     vEventGroupDelete(event_group_handle_);
 }
 
@@ -25,40 +47,42 @@ bool WebsocketProtocol::Start() {
     return true;
 }
 
-bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
-    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+bool WebsocketProtocol::SendAudio(const AudioStreamPacket& packet) {
+    // Audio is sent from its own task, the channel may be closed at the same time
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!channel_opened_ || websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
 
+    // Serialize into a buffer that keeps its capacity, so steady-state sending does not allocate
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        send_buffer_.resize(sizeof(BinaryProtocol2) + packet.payload.size());
+        auto bp2 = (BinaryProtocol2*)send_buffer_.data();
         bp2->version = htons(version_);
         bp2->type = 0;
         bp2->reserved = 0;
-        bp2->timestamp = htonl(packet->timestamp);
-        bp2->payload_size = htonl(packet->payload.size());
-        memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
+        bp2->timestamp = htonl(packet.timestamp);
+        bp2->payload_size = htonl(packet.payload.size());
+        memcpy(bp2->payload, packet.payload.data(), packet.payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        return websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
     } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
+        send_buffer_.resize(sizeof(BinaryProtocol3) + packet.payload.size());
+        auto bp3 = (BinaryProtocol3*)send_buffer_.data();
         bp3->type = 0;
         bp3->reserved = 0;
-        bp3->payload_size = htons(packet->payload.size());
-        memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
+        bp3->payload_size = htons(packet.payload.size());
+        memcpy(bp3->payload, packet.payload.data(), packet.payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        return websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
     } else {
-        return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
+        return websocket_->Send(packet.payload.data(), packet.payload.size(), true);
     }
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
-    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!channel_opened_ || websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
 
@@ -72,14 +96,180 @@ bool WebsocketProtocol::SendText(const std::string& text) {
 }
 
 bool WebsocketProtocol::IsAudioChannelOpened() const {
-    return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
+    return channel_opened_ && websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
-    websocket_.reset();
+    esp_timer_stop(warm_session_timer_);
+    std::unique_ptr<WebSocket> websocket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        websocket = std::move(websocket_);
+    }
+    // Destroy outside the lock, the receive task may be waiting for it in SendText.
+    // Reset first so the disconnect still reports the channel as closed
+    websocket.reset();
+    channel_opened_ = false;
+}
+
+void WebsocketProtocol::PrewarmAudioChannel() {
+#if CONFIG_WEBSOCKET_WARM_SESSION_SECONDS > 0
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (websocket_ != nullptr) {
+            return;
+        }
+    }
+    // Only one pre-connect at a time
+    if (!(xEventGroupGetBits(event_group_handle_) & WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT)) {
+        return;
+    }
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT);
+
+    xTaskCreate([](void* arg) {
+        auto protocol = static_cast<WebsocketProtocol*>(arg);
+        auto start_time = esp_timer_get_time();
+        auto websocket = protocol->Connect(false);
+        if (websocket != nullptr) {
+            std::lock_guard<std::mutex> lock(protocol->mutex_);
+            if (protocol->websocket_ == nullptr) {
+                ESP_LOGI(TAG, "Warm session ready in %lld ms", (esp_timer_get_time() - start_time) / 1000);
+                protocol->websocket_ = std::move(websocket);
+                esp_timer_start_once(protocol->warm_session_timer_, CONFIG_WEBSOCKET_WARM_SESSION_SECONDS * 1000000ULL);
+            }
+        }
+        xEventGroupSetBits(protocol->event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT);
+        vTaskDelete(NULL);
+    }, "ws_prewarm", 4096, this, 2, nullptr);
+#endif
+}
+
+void WebsocketProtocol::CloseWarmSession() {
+    std::unique_ptr<WebSocket> websocket;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!channel_opened_ && websocket_ != nullptr) {
+            ESP_LOGI(TAG, "Closing unused warm session");
+            websocket = std::move(websocket_);
+        }
+    }
 }
 
 bool WebsocketProtocol::OpenAudioChannel() {
+    // Wait for a pre-connect in flight, it is at least as far along as a new connection would
+    // be and shares the hello event and session state with Connect(). Taking the idle bit also
+    // keeps a new pre-connect from starting until the channel is open.
+    xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT, pdTRUE, pdFALSE, portMAX_DELAY);
+    esp_timer_stop(warm_session_timer_);
+    {
+        // Set before the channel opens, so nothing bypasses the messages held so far
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        delivering_pending_ = true;
+    }
+
+    error_occurred_ = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (websocket_ != nullptr && websocket_->IsConnected()) {
+            ESP_LOGI(TAG, "Using warm session: %s", session_id_.c_str());
+            channel_opened_ = true;
+            last_incoming_time_ = std::chrono::steady_clock::now();
+        } else {
+            websocket_.reset();
+        }
+    }
+
+    if (!channel_opened_) {
+        auto websocket = Connect(true);
+        if (websocket == nullptr) {
+            {
+                std::lock_guard<std::mutex> lock(pending_mutex_);
+                pending_messages_.clear();
+                delivering_pending_ = false;
+            }
+            xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT);
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        websocket_ = std::move(websocket);
+        channel_opened_ = true;
+    }
+    xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT);
+
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+    DeliverPendingMessages();
+
+    return true;
+}
+
+// Called from the receive task, returns true when the message was taken before the channel opened
+bool WebsocketProtocol::HoldUntilOpened(const char* data, size_t len) {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (channel_opened_ && !delivering_pending_) {
+        return false;
+    }
+    if (!channel_opened_) {
+        // Connect() waits for the server hello, it is handled right away
+        auto root = cJSON_Parse(data);
+        auto type = cJSON_GetObjectItem(root, "type");
+        bool hello = cJSON_IsString(type) && strcmp(type->valuestring, "hello") == 0;
+        if (hello) {
+            ParseServerHello(root);
+        }
+        cJSON_Delete(root);
+        if (hello) {
+            return true;
+        }
+    }
+    if (pending_messages_.size() >= WEBSOCKET_PROTOCOL_MAX_PENDING_MESSAGES) {
+        ESP_LOGW(TAG, "Dropping message received before the channel opened: %.*s", (int)len, data);
+        return true;
+    }
+    pending_messages_.emplace_back(data, len);
+    return true;
+}
+
+// Messages arriving meanwhile are queued behind, so the receive task takes over in order
+void WebsocketProtocol::DeliverPendingMessages() {
+    while (true) {
+        std::string message;
+        {
+            std::lock_guard<std::mutex> lock(pending_mutex_);
+            if (pending_messages_.empty()) {
+                delivering_pending_ = false;
+                return;
+            }
+            message = std::move(pending_messages_.front());
+            pending_messages_.pop_front();
+        }
+        HandleText(message.c_str(), message.size());
+    }
+}
+
+void WebsocketProtocol::HandleText(const char* data, size_t len) {
+    if (HandleIncomingMessage(data, len)) {
+        return;
+    }
+    // Parse JSON data
+    auto root = cJSON_Parse(data);
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (cJSON_IsString(type)) {
+        if (strcmp(type->valuestring, "hello") == 0) {
+            ParseServerHello(root);
+        } else {
+            if (on_incoming_json_ != nullptr) {
+                on_incoming_json_(root);
+            }
+        }
+    } else {
+        ESP_LOGE(TAG, "Missing message type, data: %s", data);
+    }
+    cJSON_Delete(root);
+}
+
+std::unique_ptr<WebSocket> WebsocketProtocol::Connect(bool report_errors) {
     Settings settings("websocket", false);
     std::string url = settings.GetString("url");
     std::string token = settings.GetString("token");
@@ -88,13 +278,11 @@ bool WebsocketProtocol::OpenAudioChannel() {
         version_ = version;
     }
 
-    error_occurred_ = false;
-
     auto network = Board::GetInstance().GetNetwork();
-    websocket_ = network->CreateWebSocket(1);
-    if (websocket_ == nullptr) {
+    auto websocket = network->CreateWebSocket(1);
+    if (websocket == nullptr) {
         ESP_LOGE(TAG, "Failed to create websocket");
-        return false;
+        return nullptr;
     }
 
     if (!token.empty()) {
@@ -102,101 +290,101 @@ bool WebsocketProtocol::OpenAudioChannel() {
         if (token.find(" ") == std::string::npos) {
             token = "Bearer " + token;
         }
-        websocket_->SetHeader("Authorization", token.c_str());
+        websocket->SetHeader("Authorization", token.c_str());
     }
-    websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
-    websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    websocket->SetHeader("Protocol-Version", std::to_string(version_).c_str());
+    websocket->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    websocket->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
 
-    websocket_->OnData([this](const char* data, size_t len, bool binary) {
+    websocket->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
-            if (on_incoming_audio_ != nullptr) {
+            if (on_incoming_audio_ != nullptr && channel_opened_) {
+                // The headers are read from a copy, the transport buffer is left untouched
+                auto bytes = reinterpret_cast<const uint8_t*>(data);
+                uint32_t timestamp = 0;
+                const uint8_t* payload = bytes;
+                size_t payload_size = len;
                 if (version_ == 2) {
-                    BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
-                    bp2->version = ntohs(bp2->version);
-                    bp2->type = ntohs(bp2->type);
-                    bp2->timestamp = ntohl(bp2->timestamp);
-                    bp2->payload_size = ntohl(bp2->payload_size);
-                    auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = bp2->timestamp,
-                        .payload = std::vector<uint8_t>(payload, payload + bp2->payload_size)
-                    }));
+                    BinaryProtocol2 bp2;
+                    if (len < sizeof(bp2)) {
+                        ESP_LOGE(TAG, "Binary frame too short: %u", len);
+                        return;
+                    }
+                    memcpy(&bp2, bytes, sizeof(bp2));
+                    timestamp = ntohl(bp2.timestamp);
+                    payload = bytes + sizeof(bp2);
+                    payload_size = ntohl(bp2.payload_size);
                 } else if (version_ == 3) {
-                    BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
-                    bp3->type = bp3->type;
-                    bp3->payload_size = ntohs(bp3->payload_size);
-                    auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
-                    }));
-                } else {
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
-                    }));
-                }
-            }
-        } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
-                    ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
+                    BinaryProtocol3 bp3;
+                    if (len < sizeof(bp3)) {
+                        ESP_LOGE(TAG, "Binary frame too short: %u", len);
+                        return;
                     }
+                    memcpy(&bp3, bytes, sizeof(bp3));
+                    payload = bytes + sizeof(bp3);
+                    payload_size = ntohs(bp3.payload_size);
+                }
+                if (payload_size > len - (payload - bytes)) {
+                    ESP_LOGE(TAG, "Invalid payload size %u, frame length %u", payload_size, len);
+                    return;
                 }
-            } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+                on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+                    .sample_rate = server_sample_rate_,
+                    .frame_duration = server_frame_duration_,
+                    .timestamp = timestamp,
+                    .payload = std::vector<uint8_t>(payload, payload + payload_size)
+                }));
             }
-            cJSON_Delete(root);
+        } else if (!HoldUntilOpened(data, len)) {
+            HandleText(data, len);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
-    websocket_->OnDisconnected([this]() {
+    websocket->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
-        if (on_audio_channel_closed_ != nullptr) {
+        // A warm session that was never used closes silently
+        if (channel_opened_ && on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
     });
 
+    {
+        // Left over from a session that was closed before it was used
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        pending_messages_.clear();
+    }
     ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
-    if (!websocket_->Connect(url.c_str())) {
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
+    if (!websocket->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
+        if (report_errors) {
+            SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+        }
+        return nullptr;
     }
 
     // Send hello message to describe the client
     auto message = GetHelloMessage();
-    if (!SendText(message)) {
-        return false;
+    if (!websocket->Send(message)) {
+        ESP_LOGE(TAG, "Failed to send hello: %s", message.c_str());
+        if (report_errors) {
+            SetError(Lang::Strings::SERVER_ERROR);
+        }
+        return nullptr;
     }
 
     // Wait for server hello
     EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
     if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
         ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
-        return false;
-    }
-
-    if (on_audio_channel_opened_ != nullptr) {
-        on_audio_channel_opened_();
+        if (report_errors) {
+            SetError(Lang::Strings::SERVER_TIMEOUT);
+        }
+        return nullptr;
     }
 
-    return true;
+    return websocket;
 }
 
 std::string WebsocketProtocol::GetHelloMessage() {
@@ -215,7 +403,8 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "frame_duration",
+        Application::GetInstance().GetAudioService().uplink_controller().frame_duration_ms());
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
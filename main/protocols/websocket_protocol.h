@@ -7,8 +7,15 @@
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <esp_timer.h>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <string>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
+#define WEBSOCKET_PROTOCOL_PREWARM_IDLE_EVENT (1 << 1)
+#define WEBSOCKET_PROTOCOL_MAX_PENDING_MESSAGES 8
 
 class WebsocketProtocol : public Protocol {
 public:
@@ -16,16 +23,32 @@ public:
     ~WebsocketProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(const AudioStreamPacket& packet) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void PrewarmAudioChannel() override;
 
 private:
     EventGroupHandle_t event_group_handle_;
+    std::mutex mutex_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
-
+    std::vector<uint8_t> send_buffer_;
+    // websocket_ may be a warm session (connected and hello exchanged) that is not in use yet
+    std::atomic<bool> channel_opened_ = false;
+    esp_timer_handle_t warm_session_timer_ = nullptr;
+    // Messages received after the server hello but before the channel is open (like the
+    // MCP initialize request), delivered in order by OpenAudioChannel()
+    std::mutex pending_mutex_;
+    std::deque<std::string> pending_messages_;
+    bool delivering_pending_ = false;
+
+    std::unique_ptr<WebSocket> Connect(bool report_errors);
+    bool HoldUntilOpened(const char* data, size_t len);
+    void DeliverPendingMessages();
+    void HandleText(const char* data, size_t len);
+    void CloseWarmSession();
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
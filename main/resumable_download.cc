@@ -0,0 +1,253 @@
+#include "resumable_download.h"
+#include "board.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#define TAG "ResumableDownload"
+
+ResumableDownload::ResumableDownload(const std::string& url, const std::string& journal_ns, const esp_partition_t* partition)
+    : url_(url), journal_ns_(journal_ns), partition_(partition) {
+}
+
+bool ResumableDownload::SetBlockHashes(size_t block_size, const std::vector<std::string>& hashes) {
+    // Blocks must start on sector boundaries so a rejected block can be rewritten in place
+    if (block_size == 0 || block_size % esp_partition_get_main_flash_sector_size() != 0) {
+        ESP_LOGW(TAG, "Invalid hash block size %u, ignoring manifest", block_size);
+        return false;
+    }
+    std::vector<std::array<uint8_t, 32>> parsed;
+    parsed.reserve(hashes.size());
+    for (auto& hex : hashes) {
+        if (hex.size() != 64) {
+            ESP_LOGW(TAG, "Invalid block hash %s, ignoring manifest", hex.c_str());
+            return false;
+        }
+        std::array<uint8_t, 32> digest;
+        for (int i = 0; i < 32; i++) {
+            digest[i] = (uint8_t)strtoul(hex.substr(i * 2, 2).c_str(), nullptr, 16);
+        }
+        parsed.push_back(digest);
+    }
+    hash_block_size_ = block_size;
+    block_hashes_ = std::move(parsed);
+    return true;
+}
+
+size_t ResumableDownload::LoadJournal() {
+    Settings settings(journal_ns_);
+    if (settings.GetString("url") != url_) {
+        return 0;
+    }
+    content_length_ = settings.GetInt("size");
+    journaled_offset_ = settings.GetInt("offset");
+    return journaled_offset_;
+}
+
+void ResumableDownload::SaveJournal(size_t offset) {
+    Settings settings(journal_ns_, true);
+    if (offset == 0) {
+        settings.SetString("url", url_);
+        settings.SetInt("size", content_length_);
+    }
+    settings.SetInt("offset", offset);
+    journaled_offset_ = offset;
+}
+
+void ResumableDownload::ClearJournal() {
+    Settings settings(journal_ns_, true);
+    settings.EraseAll();
+    journaled_offset_ = 0;
+}
+
+size_t ResumableDownload::VerifyWritten(size_t offset) {
+    if (block_hashes_.empty()) {
+        // Data is journaled only after it reached flash, trust it as is
+        return offset;
+    }
+
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[4096]);
+    size_t verified = 0;
+    while (verified + hash_block_size_ <= offset) {
+        size_t index = verified / hash_block_size_;
+        if (index >= block_hashes_.size()) {
+            break;
+        }
+        mbedtls_sha256_context ctx;
+        mbedtls_sha256_init(&ctx);
+        mbedtls_sha256_starts(&ctx, 0);
+        for (size_t pos = 0; pos < hash_block_size_; pos += 4096) {
+            if (esp_partition_read(partition_, verified + pos, buffer.get(), 4096) != ESP_OK) {
+                mbedtls_sha256_free(&ctx);
+                return verified;
+            }
+            mbedtls_sha256_update(&ctx, buffer.get(), 4096);
+        }
+        uint8_t digest[32];
+        mbedtls_sha256_finish(&ctx, digest);
+        mbedtls_sha256_free(&ctx);
+        if (memcmp(digest, block_hashes_[index].data(), 32) != 0) {
+            ESP_LOGW(TAG, "Block %u in flash does not match the manifest", index);
+            break;
+        }
+        verified += hash_block_size_;
+    }
+    ESP_LOGI(TAG, "Verified %u of %u journaled bytes", verified, offset);
+    return verified;
+}
+
+bool ResumableDownload::HashData(const uint8_t* data, size_t size, size_t offset) {
+    while (size > 0) {
+        size_t block_end = (offset / hash_block_size_ + 1) * hash_block_size_;
+        block_end = std::min(block_end, content_length_);
+        size_t n = std::min(size, block_end - offset);
+        mbedtls_sha256_update(&sha_ctx_, data, n);
+        data += n;
+        size -= n;
+        offset += n;
+
+        if (offset == block_end) {
+            size_t index = (block_end - 1) / hash_block_size_;
+            uint8_t digest[32];
+            mbedtls_sha256_finish(&sha_ctx_, digest);
+            mbedtls_sha256_starts(&sha_ctx_, 0);
+            if (index >= block_hashes_.size() || memcmp(digest, block_hashes_[index].data(), 32) != 0) {
+                ESP_LOGE(TAG, "SHA-256 mismatch in block %u", index);
+                hash_mismatch_ = true;
+                return false;
+            }
+            verified_offset_ = block_end;
+        }
+    }
+    return true;
+}
+
+ResumableDownloadResult ResumableDownload::Run(DownloadPipeline::Sink sink, DownloadPipeline::ProgressCallback progress_callback) {
+    size_t offset = LoadJournal();
+    if (offset > 0) {
+        offset = VerifyWritten(offset);
+        ESP_LOGI(TAG, "Resuming %s from offset %u", url_.c_str(), offset);
+    }
+
+    auto network = Board::GetInstance().GetNetwork();
+    DownloadPipeline pipeline;
+    int attempts = 0;
+    while (attempts++ < RESUMABLE_DOWNLOAD_MAX_ATTEMPTS) {
+        if (attempts > 1) {
+            vTaskDelay(pdMS_TO_TICKS(std::min(attempts * 2000, 10000)));
+        }
+
+        auto http = network->CreateHttp(0);
+        for (auto& header : headers_) {
+            http->SetHeader(header.first, header.second);
+        }
+        if (offset > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+        }
+        if (!http->Open("GET", url_)) {
+            ESP_LOGW(TAG, "Failed to open HTTP connection, attempt %d", attempts);
+            continue;
+        }
+
+        int status_code = http->GetStatusCode();
+        size_t body_length = http->GetBodyLength();
+        bool length_known = body_length > 0;
+        if (status_code == 206 && offset > 0) {
+            if (body_length > 0 && content_length_ != 0 && offset + body_length != content_length_) {
+                ESP_LOGW(TAG, "Remote file changed size, restarting from 0");
+                http->Close();
+                offset = 0;
+                continue;
+            }
+        } else if (status_code == 200) {
+            if (offset > 0) {
+                ESP_LOGW(TAG, "Server ignored the Range request, restarting from 0");
+                offset = 0;
+            }
+            content_length_ = body_length > 0 ? body_length : expected_size_;
+        } else if (status_code == 416) {
+            ESP_LOGW(TAG, "Journaled offset %u is out of range, restarting from 0", offset);
+            http->Close();
+            offset = 0;
+            continue;
+        } else {
+            ESP_LOGE(TAG, "Failed to download %s, status code: %d", url_.c_str(), status_code);
+            http->Close();
+            // Timeouts, rate limits and server errors may pass, other client errors will not
+            if (status_code == 408 || status_code == 429 || status_code >= 500) {
+                return kResumableDownloadNetworkError;
+            }
+            ClearJournal();
+            return kResumableDownloadFailed;
+        }
+
+        if (content_length_ == 0 || content_length_ > partition_->size) {
+            ESP_LOGE(TAG, "Invalid content length %u for partition size %lu", content_length_, partition_->size);
+            http->Close();
+            ClearJournal();
+            return kResumableDownloadFailed;
+        }
+        if (offset == 0) {
+            SaveJournal(0);
+        }
+
+        verified_offset_ = offset;
+        hash_mismatch_ = false;
+        if (!block_hashes_.empty()) {
+            mbedtls_sha256_init(&sha_ctx_);
+            mbedtls_sha256_starts(&sha_ctx_, 0);
+        }
+
+        bool success = pipeline.Run(http.get(), content_length_, [&](const uint8_t* data, size_t size, size_t block_offset) {
+            if (!sink(data, size, block_offset)) {
+                return false;
+            }
+            if (block_hashes_.empty()) {
+                verified_offset_ = block_offset + size;
+            } else if (!HashData(data, size, block_offset)) {
+                return false;
+            }
+            if (verified_offset_ - journaled_offset_ >= RESUMABLE_DOWNLOAD_JOURNAL_INTERVAL) {
+                SaveJournal(verified_offset_);
+            }
+            return true;
+        }, progress_callback, offset);
+        http->Close();
+
+        if (!block_hashes_.empty()) {
+            mbedtls_sha256_free(&sha_ctx_);
+        }
+
+        // Without Content-Length the expected size is only an upper bound, EOF ends the image
+        if (success && (verified_offset_ == content_length_ || !length_known)) {
+            ClearJournal();
+            return kResumableDownloadOk;
+        }
+        if (pipeline.sink_failed() && !hash_mismatch_) {
+            // The writer itself failed, retrying would not help
+            return kResumableDownloadFailed;
+        }
+
+        if (verified_offset_ > offset) {
+            // Made progress, do not count this attempt against the limit
+            attempts = 0;
+        }
+        offset = verified_offset_;
+        SaveJournal(offset);
+        ESP_LOGW(TAG, "Download interrupted at %u/%u, retrying", offset, content_length_);
+    }
+
+    ESP_LOGE(TAG, "Failed to download %s after %d attempts", url_.c_str(), RESUMABLE_DOWNLOAD_MAX_ATTEMPTS);
+    if (hash_mismatch_) {
+        // The image itself does not match its manifest
+        ClearJournal();
+        return kResumableDownloadFailed;
+    }
+    return kResumableDownloadNetworkError;
+}
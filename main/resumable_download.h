@@ -0,0 +1,70 @@
+#ifndef RESUMABLE_DOWNLOAD_H
+#define RESUMABLE_DOWNLOAD_H
+
+#include "download_pipeline.h"
+
+#include <esp_partition.h>
+#include <mbedtls/sha256.h>
+
+#include <array>
+#include <map>
+#include <string>
+#include <vector>
+
+#define RESUMABLE_DOWNLOAD_MAX_ATTEMPTS 8
+#define RESUMABLE_DOWNLOAD_JOURNAL_INTERVAL (64 * 1024)
+
+enum ResumableDownloadResult {
+    kResumableDownloadOk,
+    kResumableDownloadNetworkError, // Connection or server trouble, a later Run() resumes from the journal
+    kResumableDownloadFailed,       // The URL or image is bad, or the sink failed, retrying will not help
+};
+
+/*
+ * Downloads an image into a flash partition, surviving dropped connections and reboots.
+ *
+ * Progress is journaled in NVS under the given namespace after each written span, and a
+ * broken transfer continues with an HTTP Range request from the last journaled offset.
+ * When a per-block SHA-256 manifest is set, every block is checked as it arrives and the
+ * data already in flash is re-hashed before resuming, so only verified bytes are kept.
+ */
+class ResumableDownload {
+public:
+    ResumableDownload(const std::string& url, const std::string& journal_ns, const esp_partition_t* partition);
+
+    void SetHeader(const std::string& key, const std::string& value) { headers_[key] = value; }
+    // Used when the server does not send Content-Length
+    void SetExpectedSize(size_t size) { expected_size_ = size; }
+    // Hex SHA-256 of every block_size bytes of the image, the last block may be shorter
+    bool SetBlockHashes(size_t block_size, const std::vector<std::string>& hashes);
+
+    // The sink sees absolute image offsets; after a retry it may be called again from an
+    // earlier offset, which is always a multiple of the flash sector size
+    ResumableDownloadResult Run(DownloadPipeline::Sink sink, DownloadPipeline::ProgressCallback progress_callback);
+    void ClearJournal();
+
+    size_t content_length() const { return content_length_; }
+
+private:
+    std::string url_;
+    std::string journal_ns_;
+    const esp_partition_t* partition_;
+    std::map<std::string, std::string> headers_;
+    size_t expected_size_ = 0;
+    size_t content_length_ = 0;
+
+    size_t hash_block_size_ = 0;
+    std::vector<std::array<uint8_t, 32>> block_hashes_;
+    mbedtls_sha256_context sha_ctx_;
+    bool hash_mismatch_ = false;
+
+    size_t verified_offset_ = 0;
+    size_t journaled_offset_ = 0;
+
+    size_t LoadJournal();
+    void SaveJournal(size_t offset);
+    size_t VerifyWritten(size_t offset);
+    bool HashData(const uint8_t* data, size_t size, size_t offset);
+};
+
+#endif // RESUMABLE_DOWNLOAD_H
@@ -17,6 +17,7 @@ import shutil
 import sys
 import json
 import struct
+import zlib
 from datetime import datetime
 
 
@@ -344,10 +345,36 @@ def sort_key(filename):
     return extension, basename
 
 
-def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32):
+# Assets format v2: magic, CRC32 of the entry table and of every entry, optional
+# per-entry LZ4 compression (see Assets::InitializePartition)
+ASSETS_V2_MAGIC = b'XZA2'
+COMPRESSION_NONE = 0
+COMPRESSION_LZ4 = 1
+# Models are loaded in place from the mmapped partition and must stay uncompressed
+UNCOMPRESSED_FILES = ['srmodels.bin']
+
+
+def compress_asset(file_name, data, max_size):
+    """Return (compression, stored_bytes), keeping the raw data when compression does not pay off"""
+    if file_name in UNCOMPRESSED_FILES or len(data) > max_size or len(data) < 256:
+        return COMPRESSION_NONE, data
+    import lz4_block
+    packed = lz4_block.compress(data)
+    if len(packed) > len(data) * 9 // 10:
+        return COMPRESSION_NONE, data
+    return COMPRESSION_LZ4, packed
+
+
+def pack_assets_simple(target_path, include_path, out_file, assets_path, max_name_len=32, assets_format=1, compress=False, compress_max_size=0):
     """
     Simplified version of pack_assets that handles basic file packing
+
+    assets_format=2 writes the v2 layout with per-entry CRC32 and a table sorted by name
+    for in-place lookups. With compress=True (v2 only)
+    every file up to compress_max_size bytes that shrinks by at least 10% is stored LZ4
+    compressed.
     """
+    v2 = assets_format >= 2 or compress
     merged_data = bytearray()
     file_info_list = []
     skip_files = ['config.json']
@@ -368,33 +395,56 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
         file_name = os.path.basename(file_path)
         file_size = os.path.getsize(file_path)
 
-        file_info_list.append((file_name, len(merged_data), file_size, 0, 0))
-        # Add 0x5A5A prefix to merged_data
-        merged_data.extend(b'\x5A' * 2)
-
         with open(file_path, 'rb') as bin_file:
             bin_data = bin_file.read()
 
+        compression = COMPRESSION_NONE
+        if compress:
+            compression, bin_data = compress_asset(file_name, bin_data, compress_max_size)
+        file_info_list.append((file_name, len(merged_data), len(bin_data), file_size, compression, zlib.crc32(bin_data)))
+        # Add 0x5A5A prefix to merged_data
+        merged_data.extend(b'\x5A' * 2)
+
         merged_data.extend(bin_data)
 
     total_files = len(file_info_list)
 
+    if v2:
+        # The device binary searches the table in place, keep it sorted by the stored name bytes
+        file_info_list.sort(key=lambda info: info[0][:max_name_len].encode('utf-8'))
+        names = [info[0][:max_name_len] for info in file_info_list]
+        for a, b in zip(names, names[1:]):
+            if a == b:
+                print(f'Warning: duplicate asset name "{a}", only one of them can be looked up.')
+
     mmap_table = bytearray()
-    for file_name, offset, file_size, width, height in file_info_list:
+    for file_name, offset, stored_size, raw_size, compression, crc in file_info_list:
         if len(file_name) > max_name_len:
             print(f'Warning: "{file_name}" exceeds {max_name_len} bytes and will be truncated.')
         fixed_name = file_name.ljust(max_name_len, '\0')[:max_name_len]
         mmap_table.extend(fixed_name.encode('utf-8'))
-        mmap_table.extend(file_size.to_bytes(4, byteorder='little'))
+        mmap_table.extend(stored_size.to_bytes(4, byteorder='little'))
         mmap_table.extend(offset.to_bytes(4, byteorder='little'))
-        mmap_table.extend(width.to_bytes(2, byteorder='little'))
-        mmap_table.extend(height.to_bytes(2, byteorder='little'))
+        if v2:
+            # v2 entry: raw size, CRC32 of the stored bytes, compression, 3 reserved bytes
+            mmap_table.extend(struct.pack('<IIB3x', raw_size, crc, compression))
+        else:
+            # v1 entry: width and height, unused
+            mmap_table.extend(bytes(4))
 
     combined_data = mmap_table + merged_data
-    combined_checksum = compute_checksum(combined_data)
+    # v1 sums every byte, v2 only protects the table and relies on the per-entry CRC32
+    combined_checksum = zlib.crc32(mmap_table) if v2 else compute_checksum(combined_data)
     combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
     header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
     final_data = header_data + combined_data_length + combined_data
+    if v2:
+        final_data = ASSETS_V2_MAGIC + final_data
+    if compress:
+        stored = sum(info[2] for info in file_info_list)
+        raw = sum(info[3] for info in file_info_list)
+        compressed = sum(1 for info in file_info_list if info[4] != COMPRESSION_NONE)
+        print(f'Compressed {compressed}/{total_files} files, {raw} -> {stored} bytes')
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
@@ -419,7 +469,7 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
         output_header.write(f'#define MMAP_{asset_name.upper()}_CHECKSUM        0x{combined_checksum:04X}\n\n')
         output_header.write(f'enum MMAP_{asset_name.upper()}_LISTS {{\n')
 
-        for i, (file_name, _, _, _, _) in enumerate(file_info_list):
+        for i, (file_name, *_) in enumerate(file_info_list):
             enum_name = file_name.replace('.', '_')
             output_header.write(f'    MMAP_{asset_name.upper()}_{enum_name.upper()} = {i},        /*!< {file_name} */\n')
 
@@ -698,7 +748,7 @@ def get_emoji_collection_path(default_emoji_collection, xiaozhi_fonts_path):
         return None
 
 
-def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, extra_files_path, output_path, multinet_model_info=None):
+def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, extra_files_path, output_path, multinet_model_info=None, assets_format=1, compress=False, compress_max_size=0):
     """
     Build assets using integrated functions (no external dependencies)
     """
@@ -734,7 +784,8 @@ def build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font
         # Use simplified packing function
         include_path = config_data['include_path']
         image_file = config_data['image_file']
-        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']))
+        pack_assets_simple(assets_dir, include_path, image_file, "assets", int(config_data['name_length']),
+                           assets_format, compress, compress_max_size)
         
         # Copy final assets.bin to output location
         if os.path.exists(image_file):
@@ -768,6 +819,9 @@ def main():
     parser.add_argument('--esp_sr_model_path', help='Path to ESP-SR model directory')
     parser.add_argument('--xiaozhi_fonts_path', help='Path to xiaozhi-fonts component directory')
     parser.add_argument('--extra_files', help='Path to extra files directory to be included in assets')
+    parser.add_argument('--assets_format', type=int, choices=[1, 2], default=1, help='Assets image format, 2 adds per-entry CRC32 (needs a v2 capable firmware)')
+    parser.add_argument('--compress', action='store_true', help='Store entries LZ4 compressed, implies --assets_format 2')
+    parser.add_argument('--compress_max_kb', type=int, default=512, help='Files larger than this stay uncompressed and are used in place')
     
     args = parser.parse_args()
     
@@ -870,7 +924,8 @@ def main():
     
     # Build the assets
     success = build_assets_integrated(wakenet_model_paths, multinet_model_paths, text_font_path, emoji_collection_path, 
-                                     extra_files_path, args.output, multinet_model_info)
+                                     extra_files_path, args.output, multinet_model_info,
+                                     args.assets_format, args.compress, args.compress_max_kb * 1024)
     
     if not success:
         sys.exit(1)
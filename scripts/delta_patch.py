@@ -0,0 +1,290 @@
+#!/usr/bin/env python3
+"""
+Create and apply delta patches for firmware updates (see main/delta_patch.h)
+
+A patch rebuilds the new image from the image already running on the device. Unchanged
+runs become copy ops that cost 9 bytes each, small edits inside a matched region become
+add ops (bsdiff style, mostly zero bytes) and everything else is sent as literal insert
+ops. Add and insert data is LZ4 block compressed in chunks of up to 8 KB whenever that
+is smaller, the device decodes it with the same decoder as the compressed assets.
+
+Usage:
+    ./delta_patch.py create old.bin new.bin firmware.patch
+    ./delta_patch.py apply old.bin firmware.patch out.bin
+    ./delta_patch.py info firmware.patch
+
+The device checks the running image against "source_sha256" before applying a patch,
+`create` prints the value to put in the OTA response. It is the digest that
+esp_partition_get_sha256() reports for the running app partition: the SHA-256 appended to
+the image by esptool, or the SHA-256 over the image length when no hash is appended.
+"""
+
+import argparse
+import hashlib
+import os
+import struct
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import lz4_block  # noqa: E402
+
+MAGIC = b'XZDP'
+VERSION = 2
+
+OP_COPY = 1
+OP_ADD = 2
+OP_INSERT = 3
+OP_SEEK = 4
+OP_INSERT_LZ4 = 5
+OP_ADD_LZ4 = 6
+
+BLOCK = 32          # Match granularity
+MIN_MATCH = 64      # Shorter matches are cheaper as literals
+MAX_OP_LEN = 0xFFFFFFFF
+LZ4_MAX_RAW = 8192  # DELTA_PATCH_LZ4_MAX_RAW
+
+IMAGE_MAGIC = 0xE9
+IMAGE_HEADER_SIZE = 24
+IMAGE_SEGMENT_HEADER_SIZE = 8
+
+
+def build_index(source):
+    """Map every BLOCK-aligned window of the source to its first offset"""
+    index = {}
+    for pos in range(0, len(source) - BLOCK + 1, BLOCK // 2):
+        index.setdefault(source[pos:pos + BLOCK], pos)
+    return index
+
+
+def match_length(source, s, target, t):
+    """Length of the common run starting at source[s] and target[t]"""
+    length = 0
+    limit = min(len(source) - s, len(target) - t)
+    step = 4096
+    while length < limit:
+        n = min(step, limit - length)
+        if source[s + length:s + length + n] == target[t + length:t + length + n]:
+            length += n
+            continue
+        if n == 1:
+            break
+        step = max(1, n // 2)
+    return length
+
+
+class PatchWriter:
+    def __init__(self, source_size, target_size):
+        self.out = bytearray(MAGIC + struct.pack('<B3xII', VERSION, source_size, target_size))
+        self.source_pos = 0
+        self.stats = {OP_COPY: 0, OP_ADD: 0, OP_INSERT: 0, OP_SEEK: 0, 'packed': 0}
+
+    def seek(self, pos):
+        if pos != self.source_pos:
+            self.out += struct.pack('<Bi', OP_SEEK, pos - self.source_pos)
+            self.source_pos = pos
+            self.stats[OP_SEEK] += 1
+
+    def copy(self, length):
+        self.out += struct.pack('<BI', OP_COPY, length)
+        self.source_pos += length
+        self.stats[OP_COPY] += length
+
+    def data_op(self, op, op_lz4, data):
+        """Write data as compressed chunks, or as one plain op when compression does not pay off"""
+        chunks = []
+        for pos in range(0, len(data), LZ4_MAX_RAW):
+            chunk = data[pos:pos + LZ4_MAX_RAW]
+            chunks.append((chunk, lz4_block.compress(chunk)))
+        packed_size = sum(9 + len(packed) for _, packed in chunks)
+        if packed_size >= 5 + len(data):
+            self.out += struct.pack('<BI', op, len(data)) + data
+            return
+        for chunk, packed in chunks:
+            self.out += struct.pack('<BII', op_lz4, 4 + len(packed), len(chunk)) + packed
+        self.stats['packed'] += len(data) - packed_size
+
+    def add(self, diff):
+        self.data_op(OP_ADD, OP_ADD_LZ4, diff)
+        self.source_pos += len(diff)
+        self.stats[OP_ADD] += len(diff)
+
+    def insert(self, data):
+        if data:
+            self.data_op(OP_INSERT, OP_INSERT_LZ4, data)
+            self.stats[OP_INSERT] += len(data)
+
+
+def emit_literal(writer, source, target, start, end):
+    """Emit target[start:end] as add ops when it lines up with the source cursor, else insert"""
+    data = target[start:end]
+    s = writer.source_pos
+    if s + len(data) <= len(source):
+        diff = bytes((b - a) & 0xFF for a, b in zip(source[s:s + len(data)], data))
+        if diff.count(0) * 2 >= len(diff):
+            writer.add(diff)
+            return
+    writer.insert(data)
+
+
+def create_patch(source, target):
+    index = build_index(source)
+    writer = PatchWriter(len(source), len(target))
+    literal_start = 0
+    t = 0
+    while t + BLOCK <= len(target):
+        # Prefer continuing at the source cursor, then fall back to the index
+        candidates = [writer.source_pos + (t - literal_start)]
+        hit = index.get(target[t:t + BLOCK])
+        if hit is not None:
+            candidates.append(hit)
+        best_pos, best_len = 0, 0
+        for s in candidates:
+            if 0 <= s < len(source):
+                length = match_length(source, s, target, t)
+                if length > best_len:
+                    best_pos, best_len = s, length
+        if best_len < MIN_MATCH:
+            t += 1
+            continue
+        if literal_start < t:
+            emit_literal(writer, source, target, literal_start, t)
+        writer.seek(best_pos)
+        writer.copy(best_len)
+        t += best_len
+        literal_start = t
+    if literal_start < len(target):
+        emit_literal(writer, source, target, literal_start, len(target))
+    return bytes(writer.out), writer.stats
+
+
+def apply_patch(source, patch):
+    if patch[:4] != MAGIC or not 1 <= patch[4] <= VERSION:
+        raise ValueError('invalid patch header')
+    source_size, target_size = struct.unpack_from('<II', patch, 8)
+    if source_size > len(source):
+        raise ValueError(f'patch needs a {source_size} byte source, got {len(source)}')
+    out = bytearray()
+    pos = 16
+    s = 0
+    while pos < len(patch):
+        op = patch[pos]
+        if op == OP_SEEK:
+            s += struct.unpack_from('<i', patch, pos + 1)[0]
+            pos += 5
+            continue
+        length = struct.unpack_from('<I', patch, pos + 1)[0]
+        pos += 5
+        if op == OP_COPY:
+            out += source[s:s + length]
+            s += length
+        elif op == OP_ADD:
+            out += bytes((a + b) & 0xFF for a, b in zip(source[s:s + length], patch[pos:pos + length]))
+            s += length
+            pos += length
+        elif op == OP_INSERT:
+            out += patch[pos:pos + length]
+            pos += length
+        elif op in (OP_INSERT_LZ4, OP_ADD_LZ4):
+            raw_size = struct.unpack_from('<I', patch, pos)[0]
+            if raw_size > LZ4_MAX_RAW:
+                raise ValueError(f'compressed op of {raw_size} bytes at {pos - 5}')
+            data = lz4_block.decompress(patch[pos + 4:pos + length], raw_size)
+            if len(data) != raw_size:
+                raise ValueError(f'bad compressed op at {pos - 5}')
+            if op == OP_INSERT_LZ4:
+                out += data
+            else:
+                out += bytes((a + b) & 0xFF for a, b in zip(source[s:s + raw_size], data))
+                s += raw_size
+            pos += length
+        else:
+            raise ValueError(f'unknown op {op} at {pos - 5}')
+    if len(out) != target_size:
+        raise ValueError(f'patch produced {len(out)} bytes, expected {target_size}')
+    return bytes(out)
+
+
+def app_image_digest(image):
+    """SHA-256 that esp_partition_get_sha256() reports for an app partition holding image
+
+    IDF walks the segment headers to find the image length (checksum byte, padding to 16
+    bytes) and returns the appended hash when the header says there is one. Anything after
+    the image, like the erased rest of the partition, does not change the result. Files that
+    are not app images are hashed whole.
+    """
+    if len(image) < IMAGE_HEADER_SIZE or image[0] != IMAGE_MAGIC:
+        return hashlib.sha256(image).hexdigest()
+    segments = image[1]
+    hash_appended = image[23] == 1
+    pos = IMAGE_HEADER_SIZE
+    for _ in range(segments):
+        if pos + IMAGE_SEGMENT_HEADER_SIZE > len(image):
+            raise ValueError('truncated app image')
+        _, seg_len = struct.unpack_from('<II', image, pos)
+        pos += IMAGE_SEGMENT_HEADER_SIZE + seg_len
+    pos += 1                    # Checksum byte
+    pos = (pos + 15) & ~15      # Padding
+    if hash_appended:
+        if pos + 32 > len(image):
+            raise ValueError('truncated app image hash')
+        digest = image[pos:pos + 32]
+        if hashlib.sha256(image[:pos]).digest() != digest:
+            raise ValueError('appended image hash does not match')
+        return digest.hex()
+    if pos > len(image):
+        raise ValueError('truncated app image')
+    return hashlib.sha256(image[:pos]).hexdigest()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Create or apply firmware delta patches')
+    sub = parser.add_subparsers(dest='command', required=True)
+    create = sub.add_parser('create', help='create a patch from old to new')
+    create.add_argument('old')
+    create.add_argument('new')
+    create.add_argument('patch')
+    apply = sub.add_parser('apply', help='apply a patch to old')
+    apply.add_argument('old')
+    apply.add_argument('patch')
+    apply.add_argument('out')
+    info = sub.add_parser('info', help='print the patch header')
+    info.add_argument('patch')
+    args = parser.parse_args()
+
+    if args.command == 'create':
+        with open(args.old, 'rb') as f:
+            source = f.read()
+        with open(args.new, 'rb') as f:
+            target = f.read()
+        patch, stats = create_patch(source, target)
+        # Verify before shipping, a bad patch would only be caught by esp_ota_end
+        if apply_patch(source, patch) != target:
+            sys.exit('Error: patch does not reproduce the new image')
+        # The device hashes the running partition, which is the image followed by erased flash
+        source_sha256 = app_image_digest(source)
+        if app_image_digest(source + b'\xff' * 4096) != source_sha256:
+            sys.exit('Error: source digest depends on the partition tail, the device would reject the patch')
+        with open(args.patch, 'wb') as f:
+            f.write(patch)
+        print(f'Patch: {len(patch)} bytes for a {len(target)} byte image ({len(patch) * 100 / len(target):.1f}%)')
+        print(f'Copied {stats[OP_COPY]}, added {stats[OP_ADD]}, inserted {stats[OP_INSERT]} bytes, {stats[OP_SEEK]} seeks')
+        print(f'LZ4 saved {stats["packed"]} bytes of add/insert data')
+        print(f'source_sha256: {source_sha256}')
+    elif args.command == 'apply':
+        with open(args.old, 'rb') as f:
+            source = f.read()
+        with open(args.patch, 'rb') as f:
+            patch = f.read()
+        target = apply_patch(source, patch)
+        with open(args.out, 'wb') as f:
+            f.write(target)
+        print(f'Wrote {len(target)} bytes, sha256 {hashlib.sha256(target).hexdigest()}')
+    else:
+        with open(args.patch, 'rb') as f:
+            patch = f.read(16)
+        source_size, target_size = struct.unpack_from('<II', patch, 8)
+        print(f'version {patch[4]}, source {source_size} bytes, target {target_size} bytes')
+
+
+if __name__ == '__main__':
+    main()
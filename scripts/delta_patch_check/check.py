@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+"""
+Check the device's streaming patch applier (main/delta_patch.cc) against scripts/delta_patch.py
+
+Builds patch_feeder on the host with the stub ESP-IDF headers in stub/, makes patches with
+delta_patch.py from generated images that need every op type, and has the C++ DeltaPatch
+apply each one many times while the patch arrives in random-sized pieces, as it does from
+the network. Tiny pieces split op headers and LZ4 compressed ops across Feed() calls.
+
+Usage:
+    ./check.py [--rounds 4] [--runs 30] [--seed 1]
+
+Needs a C++17 compiler, set CXX to choose one (default c++).
+"""
+
+import argparse
+import os
+import random
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(os.path.dirname(HERE))
+sys.path.insert(0, os.path.dirname(HERE))
+import delta_patch  # noqa: E402
+
+OP_NAMES = {
+    delta_patch.OP_COPY: 'copy',
+    delta_patch.OP_ADD: 'add',
+    delta_patch.OP_INSERT: 'insert',
+    delta_patch.OP_SEEK: 'seek',
+    delta_patch.OP_INSERT_LZ4: 'insert_lz4',
+    delta_patch.OP_ADD_LZ4: 'add_lz4',
+}
+
+
+def build_feeder(out_dir):
+    cxx = os.environ.get('CXX', 'c++')
+    feeder = os.path.join(out_dir, 'patch_feeder')
+    command = [cxx, '-std=c++17', '-O1', '-g', '-fsanitize=address,undefined',
+               '-I', os.path.join(HERE, 'stub'), '-I', os.path.join(ROOT, 'main'),
+               os.path.join(HERE, 'patch_feeder.cc'),
+               os.path.join(ROOT, 'main', 'delta_patch.cc'),
+               os.path.join(ROOT, 'main', 'lz4_block.cc'),
+               '-o', feeder]
+    if os.environ.get('NO_SANITIZE'):
+        command.remove('-fsanitize=address,undefined')
+    subprocess.run(command, check=True)
+    return feeder
+
+
+def text_like(rng, size):
+    """Compressible data, like strings and tables in a firmware image"""
+    words = [b'audio', b'display', b'network', b'state', b'%s: %d\n', b'\x00\x00\x00\x00',
+             b'esp_err_t', b'application', b'\xff\xff', b'0123456789abcdef']
+    out = bytearray()
+    while len(out) < size:
+        out += rng.choice(words)
+        if rng.random() < 0.1:
+            out.append(rng.randrange(256))
+    return bytes(out[:size])
+
+
+def random_bytes(rng, size):
+    return bytes(rng.randrange(256) for _ in range(size))
+
+
+def make_images(rng):
+    """A source image and a target that needs every patch op to rebuild"""
+    parts = []
+    for _ in range(12):
+        size = rng.randrange(4000, 16000)
+        parts.append(random_bytes(rng, size) if rng.random() < 0.5 else text_like(rng, size))
+    source = b''.join(parts)
+
+    # Unchanged blocks between the edits become copy ops, so each edit is its own literal
+    target = bytearray()
+    target += parts[0]
+    # Sparse edits over more than one LZ4 chunk: add_lz4
+    edited = bytearray(parts[1] + parts[2])
+    for pos in range(0, len(edited), 37):
+        edited[pos] = (edited[pos] + 1) & 0xFF
+    target += edited
+    target += parts[3]
+    # A short run of incompressible edits on every third byte: add
+    noisy = bytearray(parts[4])
+    for pos in range(1000, 1040, 3):
+        noisy[pos] = (noisy[pos] + rng.randrange(1, 256)) & 0xFF
+    target += noisy
+    target += parts[5]
+    # New compressible data over several chunks: insert_lz4
+    target += text_like(rng, rng.randrange(20000, 40000))
+    # New random data: insert
+    target += random_bytes(rng, rng.randrange(2000, 6000))
+    # Reordered and dropped blocks: seek
+    target += parts[9] + parts[6] + parts[11]
+    target += text_like(rng, rng.randrange(1, 300))
+    return source, bytes(target)
+
+
+def count_ops(patch):
+    counts = {name: 0 for name in OP_NAMES.values()}
+    pos = 16
+    while pos < len(patch):
+        op = patch[pos]
+        counts[OP_NAMES[op]] += 1
+        if op == delta_patch.OP_SEEK or op == delta_patch.OP_COPY:
+            pos += 5
+        else:
+            pos += 5 + struct.unpack_from('<I', patch, pos + 1)[0]
+    return counts
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Check main/delta_patch.cc against delta_patch.py')
+    parser.add_argument('--rounds', type=int, default=4, help='generated image pairs')
+    parser.add_argument('--runs', type=int, default=30, help='random splits of each patch')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    work = tempfile.mkdtemp(prefix='delta_patch_check_')
+    try:
+        feeder = build_feeder(work)
+        rng = random.Random(args.seed)
+        for index in range(args.rounds):
+            source, target = make_images(rng)
+            patch, _ = delta_patch.create_patch(source, target)
+            if delta_patch.apply_patch(source, patch) != target:
+                sys.exit(f'round {index}: delta_patch.py does not reproduce its own target')
+            counts = count_ops(patch)
+            missing = [name for name, count in counts.items() if count == 0]
+            if missing:
+                sys.exit(f'round {index}: generated patch has no {", ".join(missing)} ops, fix make_images()')
+            print(f'round {index}: {len(patch)} byte patch for {len(target)} bytes, ops {counts}')
+
+            paths = [os.path.join(work, name) for name in ('old.bin', 'firmware.patch', 'new.bin')]
+            for path, data in zip(paths, (source, patch, target)):
+                with open(path, 'wb') as f:
+                    f.write(data)
+            result = subprocess.run([feeder, *paths, str(rng.randrange(1 << 31)), str(args.runs)],
+                                    stdout=subprocess.DEVNULL)
+            if result.returncode != 0:
+                sys.exit(f'round {index}: DeltaPatch failed, files kept in {work}')
+    except BaseException:
+        print(f'Work files: {work}')
+        raise
+    shutil.rmtree(work)
+    print('DeltaPatch matches delta_patch.py')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,68 @@
+// Applies a patch with the device's DeltaPatch, feeding it in random-sized pieces
+//
+// Usage: patch_feeder old.bin firmware.patch new.bin seed runs
+
+#include "delta_patch.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+static std::vector<uint8_t> Load(const char* path) {
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 6) {
+        fprintf(stderr, "usage: %s old.bin firmware.patch new.bin seed runs\n", argv[0]);
+        return 2;
+    }
+    auto source = Load(argv[1]);
+    auto patch = Load(argv[2]);
+    auto target = Load(argv[3]);
+    std::mt19937 rng(strtoul(argv[4], nullptr, 10));
+    int runs = atoi(argv[5]);
+
+    // The device reads the running partition, which is longer than the image
+    source.resize(source.size() + 4096, 0xFF);
+    esp_partition_t partition = {(uint32_t)source.size(), "ota_0", source.data()};
+
+    for (int run = 0; run < runs; run++) {
+        // Mostly tiny pieces so op headers, LZ4 sizes and blocks split across Feed calls,
+        // sometimes a piece larger than a whole compressed op
+        size_t max_piece = run % 3 == 0 ? 16 : (run % 3 == 1 ? 700 : 20000);
+        std::uniform_int_distribution<size_t> piece_size(1, max_piece);
+
+        std::vector<uint8_t> output;
+        DeltaPatch delta(&partition, [&output](const uint8_t* data, size_t size) {
+            output.insert(output.end(), data, data + size);
+            return true;
+        });
+        size_t pieces = 0;
+        for (size_t pos = 0; pos < patch.size(); pieces++) {
+            size_t n = std::min(piece_size(rng), patch.size() - pos);
+            if (!delta.Feed(patch.data() + pos, n)) {
+                fprintf(stderr, "run %d: Feed failed at patch offset %zu\n", run, pos);
+                return 1;
+            }
+            pos += n;
+        }
+        if (!delta.Finish()) {
+            fprintf(stderr, "run %d: Finish failed after %zu of %zu bytes\n", run, output.size(), target.size());
+            return 1;
+        }
+        if (output != target) {
+            auto diff = std::mismatch(output.begin(), output.end(), target.begin(), target.end());
+            fprintf(stderr, "run %d: output differs from the target at byte %zu\n", run,
+                (size_t)(diff.first - output.begin()));
+            return 1;
+        }
+        printf("run %d: %zu pieces of up to %zu bytes, %zu bytes match\n", run, pieces, max_piece, output.size());
+    }
+    return 0;
+}
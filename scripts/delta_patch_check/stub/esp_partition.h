@@ -0,0 +1,24 @@
+// Host stand-in for an app partition: the source image followed by erased flash
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_ERR_INVALID_SIZE 0x104
+
+struct esp_partition_t {
+    uint32_t size;
+    const char* label;
+    const uint8_t* data;
+};
+
+inline esp_err_t esp_partition_read(const esp_partition_t* partition, size_t offset, void* dst, size_t size) {
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, partition->data + offset, size);
+    return ESP_OK;
+}
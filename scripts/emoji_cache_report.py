@@ -0,0 +1,182 @@
+#!/usr/bin/env python3
+"""
+Report the cost of pre-rendering GIF emoji (CONFIG_EMOJI_PRERENDER_CACHE_SIZE_KB)
+
+For every GIF emoji in an assets.bin (or a directory of GIF files) this prints the
+number of frames, the pixels the decoder has to produce per loop, the PSRAM an
+RGB565 / RGB565A8 frame atlas needs, and whether the emoji fits in the cache budget
+using the same first-come policy as Assets::Apply. When Pillow is installed, the
+host decode time per frame is measured as well.
+
+Usage:
+    ./emoji_cache_report.py build/generated_assets.bin --budget-kb 1024
+    ./emoji_cache_report.py path/to/emoji_dir --budget-kb 2048
+"""
+
+import argparse
+import io
+import json
+import os
+import struct
+import sys
+import time
+import zlib
+
+
+def read_assets_bin(path):
+    """Return {name: bytes} from an assets.bin built by build_default_assets.py"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    # v2 images start with a magic and carry raw size, CRC32 and compression per entry
+    v2 = data[:4] == b'XZA2'
+    base = 4 if v2 else 0
+    total_files, _checksum, _length = struct.unpack_from('<III', data, base)
+    entry_size = 52 if v2 else 44
+    table_size = entry_size * total_files
+    files = {}
+    for i in range(total_files):
+        entry = base + 12 + i * entry_size
+        name, size, offset = struct.unpack_from('<32sII', data, entry)
+        name = name.split(b'\0', 1)[0].decode('utf-8')
+        start = base + 12 + table_size + offset
+        if data[start:start + 2] != b'ZZ':
+            print(f'Warning: asset {name} has an invalid magic', file=sys.stderr)
+            continue
+        payload = data[start + 2:start + 2 + size]
+        if v2:
+            raw_size, crc, compression = struct.unpack_from('<IIB', data, entry + 40)
+            if zlib.crc32(payload) != crc:
+                print(f'Warning: asset {name} fails its CRC32 check', file=sys.stderr)
+            if compression == 1:
+                import lz4_block
+                payload = lz4_block.decompress(payload, raw_size)
+        files[name] = payload
+    return files
+
+
+def emoji_from_assets(files):
+    index = json.loads(files['index.json'])
+    for emoji in index.get('emoji_collection', []):
+        if 'eaf' in emoji:
+            continue
+        data = files.get(emoji.get('file'))
+        if data is not None:
+            yield emoji['name'], data
+
+
+def emoji_from_directory(path):
+    for file in sorted(os.listdir(path)):
+        if file.lower().endswith('.gif'):
+            with open(os.path.join(path, file), 'rb') as f:
+                yield os.path.splitext(file)[0], f.read()
+
+
+def skip_sub_blocks(data, pos):
+    while True:
+        size = data[pos]
+        pos += 1
+        if size == 0:
+            return pos
+        pos += size
+
+
+def parse_gif(data):
+    """Walk the GIF blocks and collect what the atlas size and decode cost depend on"""
+    if data[:3] != b'GIF':
+        return None
+    width, height, flags = struct.unpack_from('<HHB', data, 6)
+    pos = 13
+    if flags & 0x80:
+        pos += 3 * (1 << ((flags & 0x07) + 1))
+
+    info = {
+        'width': width,
+        'height': height,
+        'frames': 0,
+        'decoded_pixels': 0,
+        'transparent': False,
+        'delay_ms': 0,
+    }
+    transparency = False
+    delay = 0
+    while pos < len(data):
+        sep = data[pos]
+        pos += 1
+        if sep == 0x3B:
+            break
+        if sep == 0x21:
+            label = data[pos]
+            pos += 1
+            if label == 0xF9:
+                packed = data[pos + 1]
+                transparency = bool(packed & 1)
+                delay = struct.unpack_from('<H', data, pos + 2)[0] * 10
+            pos = skip_sub_blocks(data, pos)
+        elif sep == 0x2C:
+            fx, fy, fw, fh, packed = struct.unpack_from('<HHHHB', data, pos)
+            pos += 9
+            if packed & 0x80:
+                pos += 3 * (1 << ((packed & 0x07) + 1))
+            pos += 1  # LZW minimum code size
+            pos = skip_sub_blocks(data, pos)
+            # The canvas starts transparent, so a first frame that does not cover it keeps alpha
+            if info['frames'] == 0 and (fx, fy, fw, fh) != (0, 0, width, height):
+                info['transparent'] = True
+            info['transparent'] = info['transparent'] or transparency
+            info['frames'] += 1
+            info['decoded_pixels'] += fw * fh
+            info['delay_ms'] += delay
+        else:
+            return None
+    return info
+
+
+def measure_decode_ms(data, frames):
+    try:
+        from PIL import Image
+    except ImportError:
+        return None
+    start = time.perf_counter()
+    with Image.open(io.BytesIO(data)) as image:
+        for i in range(frames):
+            image.seek(i)
+            image.convert('RGBA')
+    return (time.perf_counter() - start) * 1000 / max(frames, 1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Report pre-rendered emoji cache cost')
+    parser.add_argument('source', help='assets.bin file or directory of GIF files')
+    parser.add_argument('--budget-kb', type=int, default=1024, help='CONFIG_EMOJI_PRERENDER_CACHE_SIZE_KB')
+    args = parser.parse_args()
+
+    if os.path.isdir(args.source):
+        emoji = list(emoji_from_directory(args.source))
+    else:
+        emoji = list(emoji_from_assets(read_assets_bin(args.source)))
+
+    budget = args.budget_kb * 1024
+    used = 0
+    cached = 0
+    print(f'{"emoji":<16} {"size":>9} {"frames":>6} {"loop ms":>8} {"px/loop":>9} {"format":>8} {"atlas KB":>9} {"host ms/f":>9}  cache')
+    for name, data in emoji:
+        info = parse_gif(data)
+        if info is None:
+            continue
+        bpp = 3 if info['transparent'] else 2
+        atlas = info['width'] * info['height'] * bpp * info['frames']
+        fits = used + atlas <= budget
+        if fits:
+            used += atlas
+            cached += 1
+        host_ms = measure_decode_ms(data, info['frames'])
+        host_ms = f'{host_ms:.3f}' if host_ms is not None else '-'
+        print(f'{name:<16} {info["width"]:>4}x{info["height"]:<4} {info["frames"]:>6} {info["delay_ms"]:>8} '
+              f'{info["decoded_pixels"]:>9} {"RGB565A8" if bpp == 3 else "RGB565":>8} {atlas / 1024:>9.1f} '
+              f'{host_ms:>9}  {"yes" if fits else "live"}')
+
+    print(f'\n{cached}/{len(emoji)} emoji pre-rendered, {used / 1024:.1f} KB of {args.budget_kb} KB budget')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""
+LZ4 block format (no frame header) used by assets format v2
+
+Uses the lz4 package when it is installed and falls back to a small pure Python
+greedy compressor otherwise. Both produce standard LZ4 blocks that the firmware
+decoder in main/lz4_block.cc accepts (assets entries and delta patch ops).
+"""
+
+try:
+    import lz4.block as _lz4
+except ImportError:
+    _lz4 = None
+
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+LAST_LITERALS = 5
+MF_LIMIT = 12
+
+
+def _write_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+
+def _emit(out, literals, match_len, offset):
+    lit_len = len(literals)
+    token = (min(lit_len, 15) << 4)
+    if match_len:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit_len >= 15:
+        _write_length(out, lit_len - 15)
+    out += literals
+    if match_len:
+        out += offset.to_bytes(2, 'little')
+        if match_len - MIN_MATCH >= 15:
+            _write_length(out, match_len - MIN_MATCH - 15)
+
+
+def _compress_py(data):
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    pos = 0
+    limit = n - MF_LIMIT
+    while pos < limit:
+        key = data[pos:pos + MIN_MATCH]
+        ref = table.get(key)
+        table[key] = pos
+        if ref is None or pos - ref > MAX_OFFSET:
+            pos += 1
+            continue
+        # Extend the match, keeping the last bytes as literals
+        length = MIN_MATCH
+        end = n - LAST_LITERALS
+        while pos + length < end and data[ref + length] == data[pos + length]:
+            length += 1
+        _emit(out, data[anchor:pos], length, pos - ref)
+        pos += length
+        anchor = pos
+    _emit(out, data[anchor:], 0, 0)
+    return bytes(out)
+
+
+def compress(data):
+    if _lz4 is not None:
+        return _lz4.compress(data, store_size=False, mode='high_compression')
+    return _compress_py(bytes(data))
+
+
+def decompress(data, raw_size):
+    if _lz4 is not None:
+        return _lz4.decompress(data, uncompressed_size=raw_size)
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        token = data[pos]
+        pos += 1
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                b = data[pos]
+                pos += 1
+                lit_len += b
+                if b != 255:
+                    break
+        out += data[pos:pos + lit_len]
+        pos += lit_len
+        if pos >= len(data):
+            break
+        offset = data[pos] | (data[pos + 1] << 8)
+        pos += 2
+        match_len = token & 15
+        if match_len == 15:
+            while True:
+                b = data[pos]
+                pos += 1
+                match_len += b
+                if b != 255:
+                    break
+        match_len += MIN_MATCH
+        start = len(out) - offset
+        for i in range(match_len):
+            out.append(out[start + i])
+    if len(out) != raw_size:
+        raise ValueError(f'decompressed {len(out)} bytes, expected {raw_size}')
+    return bytes(out)